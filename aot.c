@@ -0,0 +1,632 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  aot.c
+ *
+ *    Description:  chip8-aot, translates a chip8 ROM into C.
+ *
+ *    				Code reachable from CHIP8_INIT_PC is discovered by recursive descent,
+ *    				split into basic blocks and emitted as a single function on struct chip8_t
+ *    				with direct gotos between blocks. Guest registers are kept in locals and
+ *    				cycles and timers are accounted once control leaves a chain of blocks.
+ *    				Computed jumps, returns and anything outside the discovered code go
+ *    				through a dispatch switch that falls back to chip8_tick.
+ *
+ *        Version:  1.0
+ *        Created:  10/17/2026 15:12:09
+ *
+ * =====================================================================================
+ */
+
+#include "chip8.h"
+#include "chip8_aot.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+
+// How an instruction affects control flow
+enum
+{
+	FLOW_STOP,	// Left to the interpreter, ends a block before it
+	FLOW_NEXT,	// Falls through
+	FLOW_JUMP,	// 1NNN
+	FLOW_CALL,	// 2NNN
+	FLOW_RETURN,	// 00EE
+	FLOW_INDIRECT,	// BNNN
+	FLOW_SKIP,	// 3XNN, 4XNN, 5XY0, 9XY0, EX9E, EXA1
+};
+
+// ROM image as loaded at CHIP8_INIT_PC
+static uint8_t g_image[CHIP8_RAM_SIZE];
+static unsigned g_image_size;
+
+// Per image byte flags
+static uint8_t g_reachable[CHIP8_RAM_SIZE];	// Instruction starts at this byte
+static uint8_t g_leader[CHIP8_RAM_SIZE];	// Basic block starts at this byte
+static uint8_t g_code[CHIP8_RAM_SIZE];		// Byte belongs to a translated instruction
+
+// Discovery worklist
+static uint16_t g_worklist[CHIP8_RAM_SIZE];
+static unsigned g_worklist_size;
+
+
+static int in_image(unsigned addr)
+{
+	return addr >= CHIP8_INIT_PC && addr + 1 < CHIP8_INIT_PC + g_image_size;
+}
+
+static uint16_t opcode_at(unsigned addr)
+{
+	return (uint16_t)(g_image[addr - CHIP8_INIT_PC] << 8) | g_image[addr - CHIP8_INIT_PC + 1];
+}
+
+// Mirrors interpreter decoding, anything it rejects is left to it
+static int flow(uint16_t opcode)
+{
+	switch (opcode & 0xF000)
+	{
+	case 0x0000:
+		switch (opcode & 0x00FF)
+		{
+		case 0x00E0: return FLOW_NEXT;
+		case 0x00EE: return FLOW_RETURN;
+		default: return FLOW_STOP;
+		}
+
+	case 0x1000: return FLOW_JUMP;
+	case 0x2000: return FLOW_CALL;
+	case 0x3000:
+	case 0x4000:
+	case 0x5000:
+	case 0x9000: return FLOW_SKIP;
+	case 0xB000: return FLOW_INDIRECT;
+
+	case 0x8000:
+		switch (opcode & 0x000F)
+		{
+		case 0x0: case 0x1: case 0x2: case 0x3: case 0x4:
+		case 0x5: case 0x6: case 0x7: case 0xE:
+			return FLOW_NEXT;
+		default:
+			return FLOW_STOP;
+		}
+
+	case 0xE000:
+		switch (opcode & 0x00FF)
+		{
+		case 0x9E: case 0xA1: return FLOW_SKIP;
+		default: return FLOW_STOP;
+		}
+
+	case 0xF000:
+		switch (opcode & 0x00FF)
+		{
+		case 0x07: case 0x15: case 0x18: case 0x1E:
+		case 0x29: case 0x33: case 0x55: case 0x65:
+			return FLOW_NEXT;
+		default:
+			return FLOW_STOP;	// FX0A is left to the interpreter as well
+		}
+
+	default:
+		return FLOW_NEXT;
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////
+//
+//	Control flow recovery
+//
+////////////////////////////////////////////////////////////////////
+
+
+static void mark_leader(unsigned addr)
+{
+	if (!in_image(addr))
+		return;
+
+	g_leader[addr - CHIP8_INIT_PC] = 1;
+	g_worklist[g_worklist_size++] = addr;
+}
+
+static void discover(void)
+{
+	mark_leader(CHIP8_INIT_PC);
+
+	while (g_worklist_size)
+	{
+		unsigned addr = g_worklist[--g_worklist_size];
+
+		// Walk straight-line code until control flow leaves it
+		while (in_image(addr) && !g_reachable[addr - CHIP8_INIT_PC])
+		{
+			uint16_t opcode = opcode_at(addr);
+			int kind = flow(opcode);
+
+			g_reachable[addr - CHIP8_INIT_PC] = 1;
+
+			if (kind != FLOW_STOP)
+			{
+				g_code[addr - CHIP8_INIT_PC] = g_code[addr - CHIP8_INIT_PC + 1] = 1;
+			}
+
+			switch (kind)
+			{
+			case FLOW_STOP:
+				// Interpreter continues at the next instruction
+				mark_leader(addr + CHIP8_OPCODE_SIZE);
+				addr = 0;
+				break;
+
+			case FLOW_JUMP:
+				mark_leader(opcode & 0x0FFF);
+				addr = 0;
+				break;
+
+			case FLOW_CALL:
+				mark_leader(opcode & 0x0FFF);
+				mark_leader(addr + CHIP8_OPCODE_SIZE);
+				addr = 0;
+				break;
+
+			case FLOW_SKIP:
+				mark_leader(addr + CHIP8_OPCODE_SIZE);
+				mark_leader(addr + 2 * CHIP8_OPCODE_SIZE);
+				addr = 0;
+				break;
+
+			case FLOW_RETURN:
+			case FLOW_INDIRECT:
+				addr = 0;
+				break;
+
+			default:
+				addr += CHIP8_OPCODE_SIZE;
+				break;
+			}
+		}
+	}
+}
+
+
+////////////////////////////////////////////////////////////////////
+//
+//	C emitter
+//
+////////////////////////////////////////////////////////////////////
+
+
+#define X(__opcode__) 	(((__opcode__) & 0x0F00) >> 8)
+#define Y(__opcode__) 	(((__opcode__) & 0x00F0) >> 4)
+#define NN(__opcode__) 	((__opcode__) & 0x00FF)
+#define NNN(__opcode__) ((__opcode__) & 0x0FFF)
+
+// Guest registers live in locals V0 - VF and I inside the generated function, chip8 only sees them
+// around code that reads or writes them there. Masks select V registers by bit.
+#define ALL_V 		0xFFFF
+
+static void emit_spill(FILE* out, const char* indent, unsigned mask, int index)
+{
+	for (unsigned x = 0; x <= CHIP8_VF; ++x)
+	{
+		if (mask & (1u << x))
+			fprintf(out, "%schip8->V[0x%X] = V%X;\n", indent, x, x);
+	}
+
+	if (index)
+		fprintf(out, "%schip8->I = I;\n", indent);
+}
+
+static void emit_reload(FILE* out, const char* indent, unsigned mask, int index)
+{
+	for (unsigned x = 0; x <= CHIP8_VF; ++x)
+	{
+		if (mask & (1u << x))
+			fprintf(out, "%sV%X = chip8->V[0x%X];\n", indent, x, x);
+	}
+
+	if (index)
+		fprintf(out, "%sI = chip8->I;\n", indent);
+}
+
+// Emit transfer to addr, directly if it starts a block
+static void emit_goto(FILE* out, const char* indent, unsigned addr)
+{
+	if (in_image(addr) && g_leader[addr - CHIP8_INIT_PC])
+	{
+		fprintf(out, "%sgoto L_%03X;\n", indent, addr);
+		return;
+	}
+
+	fprintf(out, "%schip8->PC = 0x%03X;\n", indent, addr);
+	fprintf(out, "%sgoto dispatch;\n", indent);
+}
+
+// Bring chip8->cycles and the timers up to date, ahead counts instructions of the block that did not run yet
+static void emit_account(FILE* out, const char* indent, unsigned ahead)
+{
+	if (ahead)
+		fprintf(out, "%schip8_aot_account(chip8, &mark, cycles + %u);\n", indent, ahead);
+	else
+		fprintf(out, "%schip8_aot_account(chip8, &mark, cycles);\n", indent);
+}
+
+// Emit a falling through instruction, copies interpreter semantics statement by statement.
+// Ahead counts the instructions of its block from this one on, all counted down at block entry.
+static void emit_body(FILE* out, unsigned addr, uint16_t opcode, unsigned ahead)
+{
+	unsigned x = X(opcode);
+	unsigned y = Y(opcode);
+
+	switch (opcode & 0xF000)
+	{
+	case 0x6000:
+		fprintf(out, "\tV%X = 0x%02X;\n", x, NN(opcode));
+		return;
+
+	case 0x7000:
+		fprintf(out, "\tV%X += 0x%02X;\n", x, NN(opcode));
+		return;
+
+	case 0x8000:
+		switch (opcode & 0x000F)
+		{
+		case 0x0: fprintf(out, "\tV%X = V%X;\n", x, y); return;
+		case 0x1: fprintf(out, "\tV%X |= V%X;\n", x, y); return;
+		case 0x2: fprintf(out, "\tV%X &= V%X;\n", x, y); return;
+		case 0x3: fprintf(out, "\tV%X ^= V%X;\n", x, y); return;
+
+		case 0x4:
+			fprintf(out, "\tVF = V%X > (0xFF - V%X);\n", x, y);
+			fprintf(out, "\tV%X += V%X;\n", x, y);
+			return;
+
+		case 0x5:
+			fprintf(out, "\tVF = V%X >= V%X;\n", x, y);
+			fprintf(out, "\tV%X -= V%X;\n", x, y);
+			return;
+
+		case 0x6:
+			fprintf(out, "\tVF = V%X & 0x1;\n", x);
+			fprintf(out, "\tV%X >>= 1;\n", x);
+			return;
+
+		case 0x7:
+			fprintf(out, "\tVF = V%X >= V%X;\n", y, x);
+			fprintf(out, "\tV%X = V%X - V%X;\n", x, y, x);
+			return;
+
+		case 0xE:
+			fprintf(out, "\tVF = (0 != (V%X & 0x80));\n", x);
+			fprintf(out, "\tV%X <<= 1;\n", x);
+			return;
+		}
+		break;
+
+	case 0xA000:
+		fprintf(out, "\tI = 0x%03X;\n", NNN(opcode));
+		return;
+
+	case 0xC000:
+		// CXNN draws from the generator in chip8
+		fprintf(out, "\tchip8_exec(chip8, 0x%04X);\n", opcode);
+		emit_reload(out, "\t", 1u << x, 0);
+		return;
+
+	case 0xD000:
+		emit_spill(out, "\t", (1u << x) | (1u << y), 1);
+		fprintf(out, "\tchip8_exec(chip8, 0x%04X);\n", opcode);
+		emit_reload(out, "\t", 1u << CHIP8_VF, 0);
+		return;
+
+	case 0xF000:
+		switch (opcode & 0x00FF)
+		{
+		case 0x07:
+			emit_account(out, "\t", ahead);
+			fprintf(out, "\tV%X = chip8->delay_timer;\n", x);
+			return;
+
+		case 0x15:
+			emit_account(out, "\t", ahead);
+			fprintf(out, "\tchip8->delay_timer = V%X;\n", x);
+			return;
+
+		case 0x18:
+			emit_account(out, "\t", ahead);
+			fprintf(out, "\tchip8->sound_timer = V%X;\n", x);
+			return;
+
+		case 0x1E:
+			fprintf(out, "\tVF = (V%X + I) > 0xFFF;\n", x);
+			fprintf(out, "\tI += V%X;\n", x);
+			return;
+
+		case 0x29:
+			fprintf(out, "\tI = V%X * 5;\n", x);
+			return;
+
+		case 0x33:
+		case 0x55:
+		{
+			unsigned len;
+			if ((opcode & 0x00FF) == 0x33)
+			{
+				len = 3;
+				fprintf(out, "\tCHIP8_MEM_AT(chip8, I + 2) = V%X %% 10;\n", x);
+				fprintf(out, "\tCHIP8_MEM_AT(chip8, I + 1) = V%X / 10 %% 10;\n", x);
+				fprintf(out, "\tCHIP8_MEM_AT(chip8, I) = V%X / 100;\n", x);
+			}
+			else
+			{
+				len = x + 1;
+				for (unsigned i = 0; i <= x; ++i)
+				{
+					fprintf(out, "\tCHIP8_MEM_AT(chip8, I + %u) = V%X;\n", i, i);
+				}
+			}
+
+			// Same bookkeeping as the interpreter store, then check translated code was not overwritten
+			fprintf(out, "\tchip8_invalidate(chip8, I, %u);\n", len);
+			fprintf(out, "\tif (!chip8_aot_intact(chip8, g_aot_image, g_aot_code, sizeof(g_aot_image), I, %u))\n", len);
+			fprintf(out, "\t{\n");
+			emit_account(out, "\t\t", ahead - 1);
+			emit_spill(out, "\t\t", ALL_V, 1);
+			fprintf(out, "\t\tchip8->PC = 0x%03X;\n", (unsigned)(addr + CHIP8_OPCODE_SIZE));
+			fprintf(out, "\t\treturn ESTALE;\n");
+			fprintf(out, "\t}\n");
+			return;
+		}
+
+		case 0x65:
+			for (unsigned i = 0; i <= x; ++i)
+			{
+				fprintf(out, "\tV%X = CHIP8_MEM_AT(chip8, I + %u);\n", i, i);
+			}
+			return;
+		}
+		break;
+	}
+
+	// 00E0 has no control flow and touches no register, run it as is
+	fprintf(out, "\tchip8_exec(chip8, 0x%04X);\n", opcode);
+}
+
+// Emit block terminator
+static void emit_end(FILE* out, unsigned addr, uint16_t opcode, int kind)
+{
+	unsigned next = addr + CHIP8_OPCODE_SIZE;
+	const char* cond = NULL;
+
+	switch (kind)
+	{
+	case FLOW_JUMP:
+		emit_goto(out, "\t", NNN(opcode));
+		return;
+
+	case FLOW_CALL:
+		fprintf(out, "\tchip8->SP = (chip8->SP + 1) & CHIP8_STACK_MASK;\n");
+		fprintf(out, "\tchip8->call_stack[chip8->SP] = 0x%03X;\n", next);
+		emit_goto(out, "\t", NNN(opcode));
+		return;
+
+	case FLOW_RETURN:
+		fprintf(out, "\tchip8->PC = chip8->call_stack[chip8->SP & CHIP8_STACK_MASK];\n");
+		fprintf(out, "\tchip8->SP = (chip8->SP - 1) & CHIP8_STACK_MASK;\n");
+		fprintf(out, "\tgoto dispatch;\n");
+		return;
+
+	case FLOW_INDIRECT:
+		fprintf(out, "\tchip8->PC = 0x%03X + V0;\n", NNN(opcode));
+		fprintf(out, "\tgoto dispatch;\n");
+		return;
+	}
+
+	// Skips
+	char buf[96];
+	switch (opcode & 0xF000)
+	{
+	case 0x3000: snprintf(buf, sizeof(buf), "V%X == 0x%02X", X(opcode), NN(opcode)); break;
+	case 0x4000: snprintf(buf, sizeof(buf), "V%X != 0x%02X", X(opcode), NN(opcode)); break;
+	case 0x5000: snprintf(buf, sizeof(buf), "V%X == V%X", X(opcode), Y(opcode)); break;
+	case 0x9000: snprintf(buf, sizeof(buf), "V%X != V%X", X(opcode), Y(opcode)); break;
+	default:
+		snprintf(buf, sizeof(buf), "%sCHIP8_IS_KEY_MARKED(chip8->input_state, V%X)",
+			(opcode & 0x00FF) == 0xA1 ? "!" : "", X(opcode));
+		break;
+	}
+	cond = buf;
+
+	fprintf(out, "\tif (%s)\n\t{\n", cond);
+	emit_goto(out, "\t\t", next + CHIP8_OPCODE_SIZE);
+	fprintf(out, "\t}\n");
+	emit_goto(out, "\t", next);
+}
+
+static void emit_block(FILE* out, unsigned start)
+{
+	// Find block extent
+	unsigned count = 0;
+	unsigned addr = start;
+	int kind = FLOW_NEXT;
+
+	while (in_image(addr) && (addr == start || !g_leader[addr - CHIP8_INIT_PC]))
+	{
+		kind = flow(opcode_at(addr));
+		if (kind == FLOW_STOP)
+			break;
+
+		++count;
+		addr += CHIP8_OPCODE_SIZE;
+
+		if (kind != FLOW_NEXT)
+			break;
+	}
+
+	fprintf(out, "\nL_%03X: /* 0x%03X - 0x%03X */\n", start, start, addr);
+
+	// Blocks are entered without PC, the interpreter needs it
+	if (count == 0)
+	{
+		fprintf(out, "\tchip8->PC = 0x%03X;\n", start);
+		fprintf(out, "\tgoto interpret;\n");
+		return;
+	}
+
+	// Only the budget is counted down here, chip8->cycles and the timers catch up once a chain of blocks ends
+	fprintf(out, "\tif (cycles < %u)\n\t{\n", count);
+	fprintf(out, "\t\tchip8->PC = 0x%03X;\n", start);
+	fprintf(out, "\t\tgoto interpret;\n\t}\n");
+	fprintf(out, "\tcycles -= %u;\n", count);
+
+	for (unsigned a = start; a < addr; a += CHIP8_OPCODE_SIZE)
+	{
+		uint16_t opcode = opcode_at(a);
+		int insn_kind = flow(opcode);
+
+		fprintf(out, "\t/* %03X: %04X */\n", a, opcode);
+
+		if (insn_kind == FLOW_NEXT)
+			emit_body(out, a, opcode, (addr - a) / CHIP8_OPCODE_SIZE);
+		else
+			emit_end(out, a, opcode, insn_kind);
+	}
+
+	if (kind == FLOW_NEXT || kind == FLOW_STOP)
+	{
+		// Fell into another block or an instruction left to the interpreter
+		emit_goto(out, "\t", addr);
+	}
+}
+
+static void emit_bytes(FILE* out, const char* name, const uint8_t* bytes, unsigned size)
+{
+	fprintf(out, "static const uint8_t %s[%u] =\n{", name, size);
+	for (unsigned i = 0; i < size; ++i)
+	{
+		fprintf(out, "%s0x%02X,", (i % 16) ? " " : "\n\t", bytes[i]);
+	}
+	fprintf(out, "\n};\n\n");
+}
+
+static void emit(FILE* out, const char* rom, const char* name)
+{
+	fprintf(out, "/* Generated by chip8-aot from %s, do not edit */\n\n", rom);
+	fprintf(out, "#include \"chip8_aot.h\"\n\n");
+
+	emit_bytes(out, "g_aot_image", g_image, g_image_size);
+	emit_bytes(out, "g_aot_code", g_code, g_image_size);
+
+	fprintf(out, "int %s(struct chip8_t* chip8, unsigned long cycles)\n{\n", name);
+	fprintf(out, "\tif (!chip8_aot_intact(chip8, g_aot_image, g_aot_code, sizeof(g_aot_image), CHIP8_INIT_PC, sizeof(g_aot_image)))\n");
+	fprintf(out, "\t\treturn ESTALE;\n\n");
+
+	for (unsigned x = 0; x <= CHIP8_VF; ++x)
+	{
+		fprintf(out, "\tuint8_t V%X = chip8->V[0x%X];\n", x, x);
+	}
+	fprintf(out, "\tuint16_t I = chip8->I;\n\n");
+
+	// Blocks count cycles down, mark is what was left when chip8->cycles and the timers were last brought up to date
+	fprintf(out, "\tunsigned long mark = cycles;\n\n");
+
+	fprintf(out, "dispatch:\n");
+	fprintf(out, "\tif (cycles == 0 || chip8->key_wait)\n\t\tgoto interpret;\n\n");
+	fprintf(out, "\tswitch (chip8->PC)\n\t{\n");
+	for (unsigned i = 0; i < g_image_size; ++i)
+	{
+		if (g_leader[i])
+			fprintf(out, "\tcase 0x%03X: goto L_%03X;\n", CHIP8_INIT_PC + i, CHIP8_INIT_PC + i);
+	}
+	fprintf(out, "\tdefault: break;\n\t}\n\n");
+
+	// Blocks without enough cycles left land here, possibly with none left at all
+	fprintf(out, "interpret:\n");
+	emit_account(out, "\t", 0);
+	emit_spill(out, "\t", ALL_V, 1);
+	fprintf(out, "\n\tif (cycles == 0)\n\t\treturn 0;\n\n");
+	fprintf(out, "\tif (chip8->key_wait)\n\t{\n\t\tchip8_idle(chip8, cycles);\n\t\treturn 0;\n\t}\n\n");
+	fprintf(out, "\t{\n");
+	fprintf(out, "\t\tuint16_t opcode = CHIP8_OPCODE_AT(chip8, chip8->PC);\n");
+	fprintf(out, "\t\tint rc = chip8_tick(chip8);\n");
+	fprintf(out, "\t\tif (rc)\n\t\t\treturn rc;\n\n");
+	fprintf(out, "\t\t--cycles;\n");
+	fprintf(out, "\t\tmark = cycles;\n\n");
+	fprintf(out, "\t\tif ((opcode & 0xF0FF) == 0xF033 && !chip8_aot_intact(chip8, g_aot_image, g_aot_code, sizeof(g_aot_image), chip8->I, 3))\n");
+	fprintf(out, "\t\t\treturn ESTALE;\n");
+	fprintf(out, "\t\tif ((opcode & 0xF0FF) == 0xF055 && !chip8_aot_intact(chip8, g_aot_image, g_aot_code, sizeof(g_aot_image), chip8->I, CHIP8_REGX_OPERAND(opcode) + 1))\n");
+	fprintf(out, "\t\t\treturn ESTALE;\n");
+	fprintf(out, "\t}\n\n");
+	emit_reload(out, "\t", ALL_V, 1);
+	fprintf(out, "\tgoto dispatch;\n");
+
+	for (unsigned i = 0; i < g_image_size; ++i)
+	{
+		if (g_leader[i])
+			emit_block(out, CHIP8_INIT_PC + i);
+	}
+
+	fprintf(out, "}\n\n");
+
+	// Hosts load the image the translation was made from through these
+	fprintf(out, "const uint8_t* const %s_image = g_aot_image;\n", name);
+	fprintf(out, "const size_t %s_image_size = sizeof(g_aot_image);\n", name);
+}
+
+
+////////////////////////////////////////////////////////////////////
+//
+//	Utils and entry
+//
+////////////////////////////////////////////////////////////////////
+
+
+static void usage()
+{
+	printf("chip8-aot image [function name] > image.c\n");
+}
+
+static int load_image(const char* path)
+{
+	FILE* file = fopen(path, "rb");
+	if (!file)
+	{
+		return errno;
+	}
+
+	g_image_size = fread(g_image, 1, sizeof(g_image), file);
+	int error = ferror(file) ? EIO : 0;
+
+	if (!error && fgetc(file) != EOF)
+	{
+		error = ENOSPC;
+	}
+
+	fclose(file);
+	return error;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc != 2 && argc != 3)
+	{
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	int error = load_image(argv[1]);
+	if (error)
+	{
+		fprintf(stderr, "Failed loading image %s: %s\n", argv[1], strerror(error));
+		return error;
+	}
+
+	discover();
+	emit(stdout, argv[1], argc == 3 ? argv[2] : CHIP8_AOT_DEFAULT_NAME);
+
+	return 0;
+}
@@ -0,0 +1,792 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  batch.c
+ *
+ *    Description:  chip8-batch, runs a list of ROM jobs headless on all cores and reports them as JSON.
+ *    				Every worker thread owns a queue of jobs and time slices them through chip8_run,
+ *    				or chip8_jit_run with -J, idle workers steal queued jobs from the others.
+ *
+ *        Version:  1.0
+ *        Created:  10/17/2026 18:05:42
+ *
+ * =====================================================================================
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include "chip8.h"
+#include "chip8_rom.h"
+#include "chip8_jit.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+
+// Instructions a job may execute in total unless given with -n
+#define BATCH_DEFAULT_CYCLES 10000000UL
+
+// Instructions a job executes before its worker moves on to the next one, -s
+#define BATCH_DEFAULT_SLICE 100000UL
+
+// Longest job or input script line
+#define BATCH_LINE_MAX 4096
+
+// Scripted key change, applied once the job executed cycle instructions
+struct batch_event_t
+{
+	uint64_t cycle;
+	uint8_t key;
+	uint8_t is_pressed;
+};
+
+// How a job ended
+enum batch_status_t
+{
+	BATCH_PENDING,		// Still queued
+	BATCH_CYCLES,		// Executed its cycle budget
+	BATCH_KEY_WAIT,		// Waits for a key press with no scripted input left
+	BATCH_ERROR,		// Failed loading or executing
+};
+
+struct batch_job_t
+{
+	char* rom;			// ROM image path
+	uint32_t seed;			// CXNN seed, see chip8_set_seed
+	char* input;			// Input script path or NULL
+
+	struct batch_event_t* events;	// Input script, sorted by cycle
+	size_t event_count;
+	size_t next_event;
+
+	struct chip8_t* chip8;		// Allocated on first slice, released when the job ends
+	struct chip8_jit_t* jit;	// Recompiler for chip8 with -J, same lifetime
+
+	enum batch_status_t status;
+	int error;			// errno of a failed job
+	uint16_t error_pc;		// Address following the failed instruction, 0 if loading failed
+	uint64_t instructions;
+	uint64_t frames;		// Times execution stopped on a video update
+	uint64_t framebuffer_hash;	// FNV-1a of the final video memory
+};
+
+struct batch_pool_t;
+
+// Worker thread and its job queue, a ring protected by lock
+struct batch_worker_t
+{
+	pthread_t thread;
+	pthread_mutex_t lock;
+	struct batch_job_t** queue;	// Capacity is the total job count so requeueing never fails
+	size_t head;
+	size_t count;
+	unsigned index;
+	struct batch_pool_t* pool;
+};
+
+struct batch_pool_t
+{
+	struct batch_worker_t* workers;
+	unsigned worker_count;
+	size_t job_count;
+	size_t remaining;		// Jobs not finished yet, updated atomically
+	size_t queued;			// Jobs sitting in any queue, updated atomically under the queue's lock
+
+	// Workers with nothing to run or steal sleep on idle until a job is queued or the last one finished
+	pthread_mutex_t idle_lock;
+	pthread_cond_t idle;
+	unsigned long max_cycles;
+	unsigned long slice;
+	int jit;			// Run jobs through the recompiler, -J
+	struct chip8_rom_cache_t* roms;	// Jobs running the same ROM share its mapping
+};
+
+
+////////////////////////////////////////////////////////////////////
+//
+//	Jobs
+//
+////////////////////////////////////////////////////////////////////
+
+
+// Input script: one "cycle key state" line per key change, key in hex, state 1 for pressed. # starts a comment.
+static int load_input(struct batch_job_t* job)
+{
+	FILE* file = fopen(job->input, "r");
+	if (file == NULL)
+	{
+		return errno;
+	}
+
+	char line[BATCH_LINE_MAX];
+	size_t capacity = 0;
+	int error = 0;
+
+	while (error == 0 && fgets(line, sizeof(line), file))
+	{
+		unsigned long long cycle;
+		unsigned key, is_pressed;
+		char extra;
+
+		line[strcspn(line, "#")] = '\0';
+		int fields = sscanf(line, "%llu %x %u %c", &cycle, &key, &is_pressed, &extra);
+		if (fields <= 0)
+		{
+			continue;
+		}
+
+		if (fields != 3 || key >= CHIP8_TOTAL_KEYS || is_pressed > 1 ||
+			(job->event_count && cycle < job->events[job->event_count - 1].cycle))
+		{
+			error = EINVAL;
+			break;
+		}
+
+		if (job->event_count == capacity)
+		{
+			capacity = capacity ? capacity * 2 : 16;
+			struct batch_event_t* events = realloc(job->events, capacity * sizeof(*events));
+			if (events == NULL)
+			{
+				error = ENOMEM;
+				break;
+			}
+
+			job->events = events;
+		}
+
+		struct batch_event_t* event = &job->events[job->event_count++];
+		event->cycle = cycle;
+		event->key = key;
+		event->is_pressed = is_pressed;
+	}
+
+	if (error == 0 && ferror(file))
+	{
+		error = EIO;
+	}
+
+	fclose(file);
+	return error;
+}
+
+static int start_job(struct batch_pool_t* pool, struct batch_job_t* job)
+{
+	void* chip8;
+	if (posix_memalign(&chip8, CHIP8_CACHE_LINE, sizeof(*job->chip8)))
+	{
+		return ENOMEM;
+	}
+
+	// Initialized before anything can fail, finish_job reports from it either way
+	int error = chip8_init(chip8);
+	if (error)
+	{
+		free(chip8);
+		return error;
+	}
+
+	job->chip8 = chip8;
+
+	const struct chip8_rom_t* rom;
+	error = chip8_rom_cache_load(pool->roms, job->rom, &rom);
+	if (error == 0)
+	{
+		error = chip8_load_image(job->chip8, rom->data, rom->size);
+	}
+
+	if (error == 0)
+	{
+		chip8_set_seed(job->chip8, job->seed);
+	}
+
+	if (error == 0 && job->input)
+	{
+		error = load_input(job);
+	}
+
+	if (error == 0 && pool->jit)
+	{
+		job->jit = chip8_jit_create(job->chip8);
+		if (job->jit == NULL)
+		{
+			error = ENOMEM;
+		}
+	}
+
+	return error;
+}
+
+// Hash rows most significant byte first so results do not depend on host byte order
+static uint64_t hash_framebuffer(const struct chip8_t* chip8)
+{
+	const uint64_t* rows = chip8_get_video_rows(chip8);
+	uint64_t hash = 0xCBF29CE484222325ULL;
+
+	for (int y = 0; y < CHIP8_VIDEO_HEIGHT; ++y)
+	{
+		for (int shift = CHIP8_VIDEO_WIDTH - 8; shift >= 0; shift -= 8)
+		{
+			hash ^= (rows[y] >> shift) & 0xFF;
+			hash *= 0x100000001B3ULL;
+		}
+	}
+
+	return hash;
+}
+
+static void finish_job(struct batch_job_t* job, enum batch_status_t status, int error)
+{
+	job->status = status;
+	job->error = error;
+
+	if (job->chip8)
+	{
+		job->instructions = job->chip8->cycles;
+		job->framebuffer_hash = hash_framebuffer(job->chip8);
+		if (job->jit)
+		{
+			chip8_jit_destroy(job->jit);
+			job->jit = NULL;
+		}
+		free(job->chip8);
+		job->chip8 = NULL;
+	}
+
+	free(job->events);
+	job->events = NULL;
+}
+
+static int run_job(struct batch_job_t* job, unsigned long max_cycles, enum chip8_exit_t* exit_reason)
+{
+	return job->jit ? chip8_jit_run(job->jit, max_cycles, exit_reason) : chip8_run(job->chip8, max_cycles, exit_reason);
+}
+
+// Run job for one slice, return nonzero once it ended
+static int run_slice(struct batch_pool_t* pool, struct batch_job_t* job)
+{
+	if (job->chip8 == NULL)
+	{
+		int error = start_job(pool, job);
+		if (error)
+		{
+			finish_job(job, BATCH_ERROR, error);
+			return 1;
+		}
+	}
+
+	struct chip8_t* chip8 = job->chip8;
+	uint64_t end = chip8->cycles + pool->slice;
+	if (end > pool->max_cycles)
+	{
+		end = pool->max_cycles;
+	}
+
+	while (chip8->cycles < end)
+	{
+		while (job->next_event < job->event_count && job->events[job->next_event].cycle <= chip8->cycles)
+		{
+			const struct batch_event_t* event = &job->events[job->next_event++];
+			chip8_set_key_state(chip8, event->key, event->is_pressed);
+		}
+
+		// Stop at the next scripted key change so it lands on its cycle
+		uint64_t budget = end - chip8->cycles;
+		if (job->next_event < job->event_count && job->events[job->next_event].cycle - chip8->cycles < budget)
+		{
+			budget = job->events[job->next_event].cycle - chip8->cycles;
+		}
+
+		enum chip8_exit_t exit_reason;
+		int error = run_job(job, budget, &exit_reason);
+
+		switch (exit_reason)
+		{
+		case CHIP8_EXIT_ERROR:
+			job->error_pc = chip8->PC;
+			finish_job(job, BATCH_ERROR, error);
+			return 1;
+
+		case CHIP8_EXIT_FRAME:
+			++job->frames;
+			chip8->video_update = 0;
+			break;
+
+		case CHIP8_EXIT_KEY_WAIT:
+			// Nothing left to press, idle out the job so results do not depend on the slice
+			if (job->next_event == job->event_count)
+			{
+				run_job(job, pool->max_cycles - chip8->cycles, &exit_reason);
+				finish_job(job, BATCH_KEY_WAIT, 0);
+				return 1;
+			}
+			break;
+
+		case CHIP8_EXIT_CYCLES:
+			break;
+		}
+	}
+
+	if (chip8->cycles >= pool->max_cycles)
+	{
+		finish_job(job, BATCH_CYCLES, 0);
+		return 1;
+	}
+
+	return 0;
+}
+
+
+////////////////////////////////////////////////////////////////////
+//
+//	Work stealing pool
+//
+////////////////////////////////////////////////////////////////////
+
+
+static void push_job(struct batch_worker_t* worker, struct batch_job_t* job)
+{
+	struct batch_pool_t* pool = worker->pool;
+
+	pthread_mutex_lock(&worker->lock);
+	worker->queue[(worker->head + worker->count++) % pool->job_count] = job;
+	__atomic_add_fetch(&pool->queued, 1, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&worker->lock);
+
+	// Sleepers check queued under idle_lock, taking it here means none misses this job
+	pthread_mutex_lock(&pool->idle_lock);
+	pthread_cond_signal(&pool->idle);
+	pthread_mutex_unlock(&pool->idle_lock);
+}
+
+// Owner takes the oldest job, thieves the most recently queued one
+static struct batch_job_t* pop_job(struct batch_worker_t* worker, int steal)
+{
+	struct batch_job_t* job = NULL;
+
+	pthread_mutex_lock(&worker->lock);
+	if (worker->count)
+	{
+		if (steal)
+		{
+			job = worker->queue[(worker->head + --worker->count) % worker->pool->job_count];
+		}
+		else
+		{
+			job = worker->queue[worker->head];
+			worker->head = (worker->head + 1) % worker->pool->job_count;
+			--worker->count;
+		}
+		__atomic_sub_fetch(&worker->pool->queued, 1, __ATOMIC_RELAXED);
+	}
+	pthread_mutex_unlock(&worker->lock);
+
+	return job;
+}
+
+static struct batch_job_t* steal_job(struct batch_worker_t* worker)
+{
+	struct batch_pool_t* pool = worker->pool;
+
+	for (unsigned i = 1; i < pool->worker_count; ++i)
+	{
+		struct batch_job_t* job = pop_job(&pool->workers[(worker->index + i) % pool->worker_count], 1);
+		if (job)
+		{
+			return job;
+		}
+	}
+
+	return NULL;
+}
+
+static void* worker_main(void* arg)
+{
+	struct batch_worker_t* worker = arg;
+	struct batch_pool_t* pool = worker->pool;
+
+	while (__atomic_load_n(&pool->remaining, __ATOMIC_ACQUIRE))
+	{
+		struct batch_job_t* job = pop_job(worker, 0);
+		if (job == NULL)
+		{
+			job = steal_job(worker);
+		}
+
+		if (job == NULL)
+		{
+			// Everything left is being run by other workers, wait for one to requeue or finish the last job
+			pthread_mutex_lock(&pool->idle_lock);
+			while (__atomic_load_n(&pool->queued, __ATOMIC_ACQUIRE) == 0 && __atomic_load_n(&pool->remaining, __ATOMIC_ACQUIRE))
+			{
+				pthread_cond_wait(&pool->idle, &pool->idle_lock);
+			}
+			pthread_mutex_unlock(&pool->idle_lock);
+			continue;
+		}
+
+		if (run_slice(pool, job))
+		{
+			if (__atomic_sub_fetch(&pool->remaining, 1, __ATOMIC_ACQ_REL) == 0)
+			{
+				pthread_mutex_lock(&pool->idle_lock);
+				pthread_cond_broadcast(&pool->idle);
+				pthread_mutex_unlock(&pool->idle_lock);
+			}
+		}
+		else
+		{
+			// Requeue behind the worker's other jobs so long ROMs do not starve short ones
+			push_job(worker, job);
+		}
+	}
+
+	return NULL;
+}
+
+// Calling thread serves as worker 0
+static int run_pool(struct batch_pool_t* pool, struct batch_job_t* jobs)
+{
+	pool->workers = calloc(pool->worker_count, sizeof(*pool->workers));
+	if (pool->workers == NULL)
+	{
+		return ENOMEM;
+	}
+
+	if (pthread_mutex_init(&pool->idle_lock, NULL))
+	{
+		free(pool->workers);
+		return ENOMEM;
+	}
+
+	if (pthread_cond_init(&pool->idle, NULL))
+	{
+		pthread_mutex_destroy(&pool->idle_lock);
+		free(pool->workers);
+		return ENOMEM;
+	}
+
+	unsigned ready = 0;
+	int error = 0;
+
+	for (; ready < pool->worker_count; ++ready)
+	{
+		struct batch_worker_t* worker = &pool->workers[ready];
+		worker->index = ready;
+		worker->pool = pool;
+		worker->queue = malloc(pool->job_count * sizeof(*worker->queue));
+		if (worker->queue == NULL || pthread_mutex_init(&worker->lock, NULL))
+		{
+			free(worker->queue);
+			error = ENOMEM;
+			break;
+		}
+	}
+
+	if (error == 0)
+	{
+		// Deal jobs round robin, stealing evens out whatever the ROMs do after that
+		for (size_t i = 0; i < pool->job_count; ++i)
+		{
+			push_job(&pool->workers[i % pool->worker_count], &jobs[i]);
+		}
+
+		pool->remaining = pool->job_count;
+
+		// Workers that fail to start leave their queues to be stolen by the others
+		unsigned started = 1;
+		while (started < pool->worker_count &&
+			pthread_create(&pool->workers[started].thread, NULL, worker_main, &pool->workers[started]) == 0)
+		{
+			++started;
+		}
+
+		worker_main(&pool->workers[0]);
+
+		for (unsigned i = 1; i < started; ++i)
+		{
+			pthread_join(pool->workers[i].thread, NULL);
+		}
+	}
+
+	for (unsigned i = 0; i < ready; ++i)
+	{
+		pthread_mutex_destroy(&pool->workers[i].lock);
+		free(pool->workers[i].queue);
+	}
+
+	pthread_cond_destroy(&pool->idle);
+	pthread_mutex_destroy(&pool->idle_lock);
+	free(pool->workers);
+	return error;
+}
+
+
+////////////////////////////////////////////////////////////////////
+//
+//	Job list and report
+//
+////////////////////////////////////////////////////////////////////
+
+
+static char* copy_string(const char* str)
+{
+	char* copy = malloc(strlen(str) + 1);
+	return copy ? strcpy(copy, str) : NULL;
+}
+
+// Job list: one "rom [seed [input]]" line per job, paths without spaces. # starts a comment.
+static int load_jobs(FILE* file, struct batch_job_t** jobs, size_t* count)
+{
+	char line[BATCH_LINE_MAX];
+	size_t capacity = 0;
+
+	*jobs = NULL;
+	*count = 0;
+
+	while (fgets(line, sizeof(line), file))
+	{
+		line[strcspn(line, "#\r\n")] = '\0';
+
+		char* rom = strtok(line, " \t");
+		char* seed = rom ? strtok(NULL, " \t") : NULL;
+		char* input = seed ? strtok(NULL, " \t") : NULL;
+		char* end = NULL;
+
+		if (rom == NULL)
+		{
+			continue;
+		}
+
+		if (input && strtok(NULL, " \t"))
+		{
+			return EINVAL;
+		}
+
+		if (*count == capacity)
+		{
+			capacity = capacity ? capacity * 2 : 64;
+			struct batch_job_t* grown = realloc(*jobs, capacity * sizeof(**jobs));
+			if (grown == NULL)
+			{
+				return ENOMEM;
+			}
+
+			*jobs = grown;
+		}
+
+		struct batch_job_t* job = &(*jobs)[(*count)++];
+		memset(job, 0, sizeof(*job));
+
+		job->seed = seed ? strtoul(seed, &end, 0) : CHIP8_DEFAULT_SEED;
+		job->rom = copy_string(rom);
+		job->input = input ? copy_string(input) : NULL;
+
+		if ((seed && *end != '\0') || job->rom == NULL || (input && job->input == NULL))
+		{
+			return job->rom && (input == NULL || job->input) ? EINVAL : ENOMEM;
+		}
+	}
+
+	return ferror(file) ? EIO : 0;
+}
+
+static void print_string(const char* str)
+{
+	putchar('"');
+
+	for (; *str; ++str)
+	{
+		unsigned char c = *str;
+		if (c == '"' || c == '\\')
+		{
+			printf("\\%c", c);
+		}
+		else if (c < 0x20)
+		{
+			printf("\\u%04x", c);
+		}
+		else
+		{
+			putchar(c);
+		}
+	}
+
+	putchar('"');
+}
+
+static const char* g_status_names[] =
+{
+	[BATCH_PENDING] = "pending",
+	[BATCH_CYCLES] = "cycles",
+	[BATCH_KEY_WAIT] = "key_wait",
+	[BATCH_ERROR] = "error",
+};
+
+static void print_report(const struct batch_pool_t* pool, const struct batch_job_t* jobs, double seconds)
+{
+	printf("{\n");
+	printf("\t\"threads\": %u,\n", pool->worker_count);
+	printf("\t\"max_cycles\": %lu,\n", pool->max_cycles);
+	printf("\t\"slice\": %lu,\n", pool->slice);
+	printf("\t\"seconds\": %.6f,\n", seconds);
+	printf("\t\"jobs\": [");
+
+	for (size_t i = 0; i < pool->job_count; ++i)
+	{
+		const struct batch_job_t* job = &jobs[i];
+
+		printf("%s\n\t\t{\"rom\": ", i ? "," : "");
+		print_string(job->rom);
+		printf(", \"seed\": %lu, \"input\": ", (unsigned long)job->seed);
+		if (job->input)
+		{
+			print_string(job->input);
+		}
+		else
+		{
+			printf("null");
+		}
+
+		printf(", \"status\": \"%s\"", g_status_names[job->status]);
+		if (job->status == BATCH_ERROR)
+		{
+			printf(", \"error\": ");
+			print_string(strerror(job->error));
+			printf(", \"pc\": %u", job->error_pc);
+		}
+
+		printf(", \"instructions\": %llu, \"frames\": %llu, \"framebuffer\": \"%016llx\"}",
+			(unsigned long long)job->instructions, (unsigned long long)job->frames,
+			(unsigned long long)job->framebuffer_hash);
+	}
+
+	printf("\n\t]\n}\n");
+}
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void usage()
+{
+	printf("chip8-batch [-j threads] [-n cycles] [-s slice] [-J] jobs\n");
+	printf("\t-J runs jobs through the x86-64 recompiler, other hosts interpret them either way\n");
+	printf("\tjobs lists one \"rom [seed [input]]\" per line, - reads it from stdin\n");
+	printf("\tinput scripts list one \"cycle key state\" per line, key in hex, state 1 for pressed\n");
+}
+
+int main(int argc, char** argv)
+{
+	struct batch_pool_t pool;
+	memset(&pool, 0, sizeof(pool));
+
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	pool.worker_count = cpus > 0 ? cpus : 1;
+	pool.max_cycles = BATCH_DEFAULT_CYCLES;
+	pool.slice = BATCH_DEFAULT_SLICE;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "j:n:s:J")) != -1)
+	{
+		if (opt == 'J')
+		{
+			pool.jit = 1;
+			continue;
+		}
+
+		unsigned long value = 0;
+		char* end = NULL;
+
+		if (opt != '?')
+		{
+			value = strtoul(optarg, &end, 0);
+		}
+
+		if (opt == '?' || *end != '\0' || value == 0)
+		{
+			usage();
+			return EXIT_FAILURE;
+		}
+
+		switch (opt)
+		{
+		case 'j': pool.worker_count = value; break;
+		case 'n': pool.max_cycles = value; break;
+		case 's': pool.slice = value; break;
+		}
+	}
+
+	if (optind != argc - 1)
+	{
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	const char* path = argv[optind];
+	FILE* file = strcmp(path, "-") ? fopen(path, "r") : stdin;
+	if (file == NULL)
+	{
+		fprintf(stderr, "Failed opening %s: %s\n", path, strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	struct batch_job_t* jobs;
+	int error = load_jobs(file, &jobs, &pool.job_count);
+
+	if (file != stdin)
+	{
+		fclose(file);
+	}
+
+	if (error == 0 && pool.job_count == 0)
+	{
+		error = ENOENT;
+	}
+
+	if (error)
+	{
+		fprintf(stderr, "Failed reading jobs %s: %s\n", path, strerror(error));
+		return EXIT_FAILURE;
+	}
+
+	if (pool.worker_count > pool.job_count)
+	{
+		pool.worker_count = pool.job_count;
+	}
+
+	pool.roms = chip8_rom_cache_create();
+	if (pool.roms == NULL)
+	{
+		fprintf(stderr, "Failed creating ROM cache: %s\n", strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	double start = now();
+	error = run_pool(&pool, jobs);
+	if (error)
+	{
+		fprintf(stderr, "Failed running jobs: %s\n", strerror(error));
+		return EXIT_FAILURE;
+	}
+
+	print_report(&pool, jobs, now() - start);
+
+	for (size_t i = 0; i < pool.job_count; ++i)
+	{
+		free(jobs[i].rom);
+		free(jobs[i].input);
+	}
+
+	free(jobs);
+	chip8_rom_cache_destroy(pool.roms);
+	return 0;
+}
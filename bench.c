@@ -0,0 +1,783 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  bench.c
+ *
+ *    Description:  chip8-bench, measures interpreter throughput per host interface and per
+ *    				opcode class, the recompiler and a ROM translated by chip8-aot against the interpreter, replays
+ *    				of real games, and snapshot restores against copying the whole state. Where Linux perf counters are available, L1 data cache
+ *    				read misses are reported alongside.
+ *
+ *        Version:  1.0
+ *        Created:  10/17/2026 16:02:37
+ *
+ * =====================================================================================
+ */
+
+#define _POSIX_C_SOURCE 200112L
+#define _DEFAULT_SOURCE		// syscall
+
+#include "chip8.h"
+#include "chip8_batch.h"
+#include "chip8_snapshot.h"
+#include "chip8_record.h"
+#include "chip8_aot.h"
+#include "chip8_jit.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+
+// Instructions executed per measurement unless given on the command line
+#define BENCH_DEFAULT_CYCLES 10000000UL
+
+// Times each measurement is repeated unless given with -n
+#define BENCH_DEFAULT_REPEATS 5
+
+// Games given with -g
+#define BENCH_MAX_GAMES 16
+
+// Batch size handed to chip8_run
+#define BENCH_RUN_BATCH 4096
+
+// Instances stepped by the exec and batch measurements, sharing the cycle count
+#define BENCH_INSTANCES 256
+
+// Instructions executed between two restores of the snapshot measurements
+#define BENCH_RESTORE_INTERVAL 64
+
+// Instructions each instance runs per turn in the interleaved measurement
+#define BENCH_INTERLEAVE_SLICE 16
+
+struct bench_t;
+
+// Execute ops units of work on a loaded machine
+typedef int (*bench_func_t)(const struct bench_t* bench, struct chip8_t* chip8, unsigned long ops);
+
+struct bench_t
+{
+	const char* name;
+	const char* unit;		// What one op is
+	bench_func_t func;
+	const uint8_t* image;		// Loaded at CHIP8_INIT_PC before each repeat
+	size_t image_size;
+	unsigned long cycles_per_op;	// Ops per repeat are the instruction count given on the command line divided by this
+	unsigned long min_cycles;	// Smallest instruction count the measurement runs with
+
+	unsigned long ops;		// Fixed work per repeat of games, overrides cycles_per_op when nonzero
+	struct chip8_record_t* record;	// Input replayed by games, may be NULL
+	char* path;			// Game ROM path, owned
+};
+
+// Mean, spread and best of the repeats, in nanoseconds per op
+struct bench_result_t
+{
+	unsigned long ops;
+	unsigned repeats;
+	double seconds;
+	double mean;
+	double stddev;
+	double min;
+	double l1_misses;		// L1 data cache read misses per op, negative without a counter
+};
+
+// perf_event_open counter of L1 data cache read misses in this thread, -1 if there is none
+static int g_l1_counter = -1;
+
+// Counter loop that never draws or waits for input
+static const uint8_t g_alu_loop[] =
+{
+	0x60, 0x00,	// 200: V0 = 0
+	0x70, 0x01,	// 202: V0 += 1
+	0x81, 0x04,	// 204: V1 += V0, carry
+	0x30, 0x00,	// 206: skip if V0 == 0
+	0x12, 0x02,	// 208: jump 202
+	0x12, 0x00,	// 20A: jump 200
+};
+
+// Every 8XYN form, closed by a single jump
+static const uint8_t g_alu_class[] =
+{
+	0x60, 0x05,	// 200: V0 = 5
+	0x61, 0x03,	// 202: V1 = 3
+	0x80, 0x14,	// 204: V0 += V1, carry
+	0x82, 0x00,	// 206: V2 = V0
+	0x82, 0x11,	// 208: V2 |= V1
+	0x82, 0x12,	// 20A: V2 &= V1
+	0x82, 0x13,	// 20C: V2 ^= V1
+	0x80, 0x15,	// 20E: V0 -= V1, borrow
+	0x82, 0x06,	// 210: V2 >>= 1
+	0x82, 0x17,	// 212: V2 = V1 - V2, borrow
+	0x82, 0x0E,	// 214: V2 <<= 1
+	0x12, 0x04,	// 216: jump 204
+};
+
+// Conditional skips, taken and not taken
+static const uint8_t g_branch_class[] =
+{
+	0x60, 0x05,	// 200: V0 = 5
+	0x61, 0x05,	// 202: V1 = 5
+	0x30, 0x05,	// 204: skip if V0 == 5, taken
+	0x12, 0x00,	// 206: jump 200
+	0x40, 0x06,	// 208: skip if V0 != 6, taken
+	0x12, 0x00,	// 20A: jump 200
+	0x50, 0x10,	// 20C: skip if V0 == V1, taken
+	0x12, 0x00,	// 20E: jump 200
+	0x90, 0x10,	// 210: skip if V0 != V1, not taken
+	0x30, 0x06,	// 212: skip if V0 == 6, not taken
+	0x12, 0x04,	// 214: jump 204
+};
+
+// Calls up to two levels deep
+static const uint8_t g_call_class[] =
+{
+	0x22, 0x0A,	// 200: call 20A
+	0x22, 0x0A,	// 202: call 20A
+	0x22, 0x0C,	// 204: call 20C
+	0x12, 0x00,	// 206: jump 200
+	0x00, 0x00,	// 208:
+	0x00, 0xEE,	// 20A: return
+	0x22, 0x0A,	// 20C: call 20A
+	0x00, 0xEE,	// 20E: return
+};
+
+// Register block stores, loads and BCD conversion
+static const uint8_t g_memory_class[] =
+{
+	0xA3, 0x00,	// 200: I = 0x300
+	0xF3, 0x55,	// 202: store V0 to V3 at I
+	0xF3, 0x65,	// 204: load V0 to V3 from I
+	0xF0, 0x33,	// 206: BCD of V0 at I
+	0x70, 0x01,	// 208: V0 += 1
+	0x12, 0x02,	// 20A: jump 202
+};
+
+// Clears and draws the code as sprites over the whole screen
+static const uint8_t g_draw_class[] =
+{
+	0xA2, 0x00,	// 200: I = 0x200
+	0x00, 0xE0,	// 202: clear screen
+	0xD0, 0x1F,	// 204: draw 8x15 sprite at V0:V1
+	0x70, 0x09,	// 206: V0 += 9
+	0xD0, 0x15,	// 208: draw 8x5 sprite at V0:V1
+	0x71, 0x07,	// 20A: V1 += 7
+	0x12, 0x02,	// 20C: jump 202
+};
+
+// Waits for the delay timer over and over, the way games pace their frames
+static const uint8_t g_idle_class[] =
+{
+	0x60, 0x3C,	// 200: V0 = 60
+	0xF0, 0x15,	// 202: delay timer = V0
+	0xF1, 0x07,	// 204: V1 = delay timer
+	0x31, 0x00,	// 206: skip if V1 == 0
+	0x12, 0x04,	// 208: jump 204
+	0x12, 0x02,	// 20A: jump 202
+};
+
+// Stores to memory and draws what it stored, so each restore has pages and rows to undo
+static const uint8_t g_store_loop[] =
+{
+	0xA3, 0x00,	// 200: I = 0x300
+	0xF3, 0x55,	// 202: store V0 to V3 at I
+	0x70, 0x01,	// 204: V0 += 1
+	0xD0, 0x15,	// 206: draw 8x5 sprite at V0:V1
+	0x12, 0x02,	// 208: jump 202
+};
+
+// aot_test.ch8, linked in translated by chip8-aot
+CHIP8_AOT_DECLARE(chip8_aot_run);
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// One host call per instruction
+static int bench_tick(const struct bench_t* bench, struct chip8_t* chip8, unsigned long cycles)
+{
+	while (cycles--)
+	{
+		int error = chip8_tick(chip8);
+		if (error)
+		{
+			return error;
+		}
+	}
+
+	return 0;
+}
+
+// Batches of BENCH_RUN_BATCH instructions per host call, presenting frames like a host would
+static int bench_run(const struct bench_t* bench, struct chip8_t* chip8, unsigned long cycles)
+{
+	while (cycles)
+	{
+		enum chip8_exit_t exit_reason;
+		unsigned long batch = cycles < BENCH_RUN_BATCH ? cycles : BENCH_RUN_BATCH;
+		uint64_t start = chip8->cycles;
+
+		int error = chip8_run(chip8, batch, &exit_reason);
+		if (error)
+		{
+			return error;
+		}
+
+		chip8->video_update = 0;
+		cycles -= (unsigned long)(chip8->cycles - start);
+	}
+
+	return 0;
+}
+
+// Same as bench_run through the recompiler, translation happens inside the timed region
+static int bench_jit(const struct bench_t* bench, struct chip8_t* chip8, unsigned long cycles)
+{
+	struct chip8_jit_t* jit = chip8_jit_create(chip8);
+	if (!jit)
+	{
+		return ENOMEM;
+	}
+
+	int error = 0;
+	while (cycles && !error)
+	{
+		enum chip8_exit_t exit_reason;
+		unsigned long batch = cycles < BENCH_RUN_BATCH ? cycles : BENCH_RUN_BATCH;
+		uint64_t start = chip8->cycles;
+
+		error = chip8_jit_run(jit, batch, &exit_reason);
+
+		chip8->video_update = 0;
+		cycles -= (unsigned long)(chip8->cycles - start);
+	}
+
+	chip8_jit_destroy(jit);
+	return error;
+}
+
+// Batches of BENCH_RUN_BATCH instructions per call into the ROM translated by chip8-aot
+static int bench_aot(const struct bench_t* bench, struct chip8_t* chip8, unsigned long cycles)
+{
+	while (cycles)
+	{
+		unsigned long batch = cycles < BENCH_RUN_BATCH ? cycles : BENCH_RUN_BATCH;
+
+		int error = chip8_aot_run(chip8, batch);
+		if (error)
+		{
+			return error;
+		}
+
+		chip8->video_update = 0;
+		cycles -= batch;
+	}
+
+	return 0;
+}
+
+// Instances one after another, the host fetches and calls chip8_exec for each instruction.
+// Every instance enters the loop with a different V0, so they leave it at different times.
+static int bench_exec(const struct bench_t* bench, struct chip8_t* chip8, unsigned long cycles)
+{
+	static struct chip8_t base;
+	memcpy(&base, chip8, sizeof(base));
+
+	for (unsigned instance = 0; instance < BENCH_INSTANCES; ++instance)
+	{
+		memcpy(chip8, &base, sizeof(*chip8));
+		chip8->PC = CHIP8_INIT_PC + CHIP8_OPCODE_SIZE;
+		chip8->V[0] = instance;
+
+		for (unsigned long cycle = 0; cycle < cycles / BENCH_INSTANCES; ++cycle)
+		{
+			uint16_t opcode = (uint16_t)(chip8->mem[chip8->PC] << 8) | chip8->mem[chip8->PC + 1];
+			chip8->PC += CHIP8_OPCODE_SIZE;
+
+			int error = chip8_exec(chip8, opcode);
+			if (error)
+			{
+				return error;
+			}
+		}
+	}
+
+	return 0;
+}
+
+// Same instances stepped in lockstep by chip8_batch_run
+static int bench_batch(const struct bench_t* bench, struct chip8_t* chip8, unsigned long cycles)
+{
+	struct chip8_batch_t* batch = chip8_batch_create(BENCH_INSTANCES);
+	if (batch == NULL)
+	{
+		return errno;
+	}
+
+	chip8->PC = CHIP8_INIT_PC + CHIP8_OPCODE_SIZE;
+	for (unsigned instance = 0; instance < BENCH_INSTANCES; ++instance)
+	{
+		chip8->V[0] = instance;
+		chip8_batch_set(batch, instance, chip8);
+	}
+
+	enum chip8_exit_t exit_reasons[BENCH_INSTANCES];
+	int errors[BENCH_INSTANCES];
+	int error = chip8_batch_run(batch, cycles / BENCH_INSTANCES, exit_reasons, errors);
+
+	for (unsigned instance = 0; instance < BENCH_INSTANCES && !error; ++instance)
+	{
+		error = errors[instance];
+	}
+
+	chip8_batch_destroy(batch);
+	return error;
+}
+
+// Instances side by side in one array, each running a short slice in turn like a search
+// stepping many candidates, so every slice starts on state the previous ones evicted
+static int bench_interleave(const struct bench_t* bench, struct chip8_t* chip8, unsigned long cycles)
+{
+	void* memory;
+	if (posix_memalign(&memory, CHIP8_CACHE_LINE, BENCH_INSTANCES * sizeof(*chip8)))
+	{
+		return ENOMEM;
+	}
+
+	struct chip8_t* instances = memory;
+	for (unsigned instance = 0; instance < BENCH_INSTANCES; ++instance)
+	{
+		memcpy(&instances[instance], chip8, sizeof(*chip8));
+		instances[instance].PC = CHIP8_INIT_PC + CHIP8_OPCODE_SIZE;
+		instances[instance].V[0] = instance;
+	}
+
+	int error = 0;
+	for (unsigned long left = cycles / BENCH_INSTANCES; left && !error; )
+	{
+		unsigned long slice = left < BENCH_INTERLEAVE_SLICE ? left : BENCH_INTERLEAVE_SLICE;
+
+		for (unsigned instance = 0; instance < BENCH_INSTANCES && !error; ++instance)
+		{
+			enum chip8_exit_t exit_reason;
+			error = chip8_run(&instances[instance], slice, &exit_reason);
+		}
+
+		left -= slice;
+	}
+
+	free(memory);
+	return error;
+}
+
+// Replay a recorded session, the seed is set by measure
+static int bench_replay(const struct bench_t* bench, struct chip8_t* chip8, unsigned long cycles)
+{
+	size_t next = 0;
+
+	while (chip8->cycles < cycles)
+	{
+		enum chip8_exit_t exit_reason;
+		unsigned long batch = cycles - chip8->cycles < BENCH_RUN_BATCH ? cycles - chip8->cycles : BENCH_RUN_BATCH;
+
+		int error = chip8_record_replay(bench->record, &next, chip8, batch, &exit_reason);
+		if (error)
+		{
+			return error;
+		}
+
+		chip8->video_update = 0;
+	}
+
+	return 0;
+}
+
+// Run BENCH_RESTORE_INTERVAL instructions from a checkpoint, then go back to it through chip8_snapshot_restore
+static int bench_snapshot(const struct bench_t* bench, struct chip8_t* chip8, unsigned long restores)
+{
+	static struct chip8_snapshot_t snapshot;
+	chip8_snapshot_capture(&snapshot, chip8);
+
+	for (unsigned long i = 0; i < restores; ++i)
+	{
+		int error = bench_tick(bench, chip8, BENCH_RESTORE_INTERVAL);
+		if (error)
+		{
+			return error;
+		}
+
+		chip8_snapshot_restore(chip8, &snapshot);
+	}
+
+	return 0;
+}
+
+// Same, going back by copying the whole state
+static int bench_copy(const struct bench_t* bench, struct chip8_t* chip8, unsigned long restores)
+{
+	static struct chip8_t base;
+	memcpy(&base, chip8, sizeof(base));
+
+	for (unsigned long i = 0; i < restores; ++i)
+	{
+		int error = bench_tick(bench, chip8, BENCH_RESTORE_INTERVAL);
+		if (error)
+		{
+			return error;
+		}
+
+		memcpy(chip8, &base, sizeof(*chip8));
+	}
+
+	return 0;
+}
+
+// Time repeats of a measurement, each on a freshly loaded machine
+static int measure(const struct bench_t* bench, unsigned long ops, unsigned repeats, struct bench_result_t* result)
+{
+	static struct chip8_t chip8;
+	double sum = 0, sum_squares = 0;
+
+	memset(result, 0, sizeof(*result));
+	result->ops = ops;
+	result->repeats = repeats;
+	result->min = INFINITY;
+
+	for (unsigned repeat = 0; repeat < repeats; ++repeat)
+	{
+		int error = chip8_init(&chip8);
+		if (error)
+		{
+			return error;
+		}
+
+		memcpy(chip8.mem + CHIP8_INIT_PC, bench->image, bench->image_size);
+		if (bench->record)
+		{
+			error = chip8_set_ips(&chip8, bench->record->header.ips);
+			if (error)
+			{
+				fprintf(stderr, "%s: instruction rate %u: %s\n", bench->name, (unsigned)bench->record->header.ips, strerror(error));
+				chip8_release(&chip8);
+				return error;
+			}
+
+			chip8_set_seed(&chip8, bench->record->header.seed);
+		}
+
+		uint64_t misses_start = 0, misses_end = 0;
+		if (g_l1_counter >= 0 && read(g_l1_counter, &misses_start, sizeof(misses_start)) != sizeof(misses_start))
+		{
+			g_l1_counter = -1;
+		}
+
+		double start = now();
+		error = bench->func(bench, &chip8, ops);
+		double elapsed = now() - start;
+
+		if (g_l1_counter >= 0 && read(g_l1_counter, &misses_end, sizeof(misses_end)) != sizeof(misses_end))
+		{
+			g_l1_counter = -1;
+		}
+
+		if (error)
+		{
+			fprintf(stderr, "%s: execution failed at 0x%x: %s\n", bench->name, chip8.PC, strerror(error));
+			chip8_release(&chip8);
+			return error;
+		}
+
+		double ns = elapsed * 1e9 / ops;
+		sum += ns;
+		sum_squares += ns * ns;
+		result->seconds += elapsed;
+		result->l1_misses += (double)(misses_end - misses_start) / ops / repeats;
+		if (ns < result->min)
+		{
+			result->min = ns;
+		}
+
+		chip8_release(&chip8);
+	}
+
+	if (g_l1_counter < 0)
+	{
+		result->l1_misses = -1;
+	}
+
+	result->mean = sum / repeats;
+	result->stddev = repeats > 1 ? sqrt(fmax(0, (sum_squares - sum * result->mean) / (repeats - 1))) : 0;
+	return 0;
+}
+
+static void print_result(const struct bench_t* bench, const struct bench_result_t* result, int json)
+{
+	if (json)
+	{
+		printf("{\"name\": \"%s\", \"unit\": \"%s\", \"ops\": %lu, \"repeats\": %u, \"seconds\": %.6f, "
+			"\"mops\": %.3f, \"mean_ns\": %.3f, \"stddev_ns\": %.3f, \"min_ns\": %.3f",
+			bench->name, bench->unit, result->ops, result->repeats, result->seconds,
+			1e3 / result->mean, result->mean, result->stddev, result->min);
+		result->l1_misses < 0 ? printf(", \"l1_misses\": null}\n") : printf(", \"l1_misses\": %.4f}\n", result->l1_misses);
+		return;
+	}
+
+	printf("%-12s %12lu %-5s %10.2f Mop/s %8.2f ns/op %7.2f%% sd %8.2f ns min",
+		bench->name, result->ops, bench->unit, 1e3 / result->mean, result->mean,
+		100 * result->stddev / result->mean, result->min);
+	result->l1_misses < 0 ? printf("\n") : printf(" %8.4f L1 miss/op\n", result->l1_misses);
+}
+
+static int open_l1_counter(void)
+{
+#ifdef __linux__
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HW_CACHE;
+	attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+	return -1;
+#endif
+}
+
+// Load rom[:recording] given with -g, the ROM stays allocated for the whole run
+static int load_game(const char* arg, struct bench_t* bench)
+{
+	char* path = malloc(strlen(arg) + 1);
+	if (path == NULL)
+	{
+		return ENOMEM;
+	}
+
+	strcpy(path, arg);
+
+	char* record_path = strrchr(path, ':');
+	if (record_path)
+	{
+		*record_path++ = '\0';
+	}
+
+	FILE* file = fopen(path, "rb");
+	if (file == NULL)
+	{
+		int error = errno;
+		fprintf(stderr, "%s: %s\n", path, strerror(error));
+		free(path);
+		return error;
+	}
+
+	uint8_t* image = malloc(CHIP8_MEM_SIZE - CHIP8_INIT_PC);
+	size_t size = image ? fread(image, 1, CHIP8_MEM_SIZE - CHIP8_INIT_PC, file) : 0;
+	int error = image == NULL ? ENOMEM : ferror(file) ? EIO : size == 0 ? EPROTO : 0;
+	fclose(file);
+
+	if (!error && record_path)
+	{
+		struct chip8_record_t* record = NULL;
+
+		file = fopen(record_path, "rb");
+		error = file ? chip8_record_load(file, &record) : errno;
+		if (file)
+		{
+			fclose(file);
+		}
+
+		bench->record = record;
+		bench->ops = record ? record->header.cycles : 0;
+		if (!error && bench->ops == 0)
+		{
+			error = EPROTO;
+		}
+	}
+
+	if (error)
+	{
+		fprintf(stderr, "%s: %s\n", arg, strerror(error));
+		free(image);
+		free(path);
+		return error;
+	}
+
+	const char* name = strrchr(path, '/');
+	bench->name = name ? name + 1 : path;
+	bench->unit = "insn";
+	bench->func = bench->record ? bench_replay : bench_run;
+	bench->image = image;
+	bench->image_size = size;
+	bench->cycles_per_op = 1;
+	bench->min_cycles = 1;
+	bench->path = path;
+	return 0;
+}
+
+static void usage()
+{
+	printf("chip8-bench [-n repeats] [-j] [-g rom[:recording]]... [cycles]\n");
+	printf("\t-n\ttimes each measurement is repeated, %u by default\n", BENCH_DEFAULT_REPEATS);
+	printf("\t-j\tprint one JSON object per measurement\n");
+	printf("\t-g\tmeasure a game, replaying a recording made with soft-chip8 -R or running cycles instructions without input\n");
+	printf("\tcycles\tinstructions per measurement, %lu by default\n", BENCH_DEFAULT_CYCLES);
+}
+
+int main(int argc, char** argv)
+{
+	const struct bench_t benches[] =
+	{
+		{ .name = "tick", .unit = "insn", .func = bench_tick, .image = g_alu_loop, .image_size = sizeof(g_alu_loop),
+			.cycles_per_op = 1, .min_cycles = 1 },
+		{ .name = "run", .unit = "insn", .func = bench_run, .image = g_alu_loop, .image_size = sizeof(g_alu_loop),
+			.cycles_per_op = 1, .min_cycles = 1 },
+		{ .name = "jit", .unit = "insn", .func = bench_jit, .image = g_alu_loop, .image_size = sizeof(g_alu_loop),
+			.cycles_per_op = 1, .min_cycles = 1 },
+		{ .name = "exec", .unit = "insn", .func = bench_exec, .image = g_alu_loop, .image_size = sizeof(g_alu_loop),
+			.cycles_per_op = 1, .min_cycles = BENCH_INSTANCES },
+		{ .name = "batch", .unit = "insn", .func = bench_batch, .image = g_alu_loop, .image_size = sizeof(g_alu_loop),
+			.cycles_per_op = 1, .min_cycles = BENCH_INSTANCES },
+		{ .name = "interleave", .unit = "insn", .func = bench_interleave, .image = g_alu_loop, .image_size = sizeof(g_alu_loop),
+			.cycles_per_op = 1, .min_cycles = BENCH_INSTANCES },
+
+		// Opcode classes, through chip8_run
+		{ .name = "alu", .unit = "insn", .func = bench_run, .image = g_alu_class, .image_size = sizeof(g_alu_class),
+			.cycles_per_op = 1, .min_cycles = 1 },
+		{ .name = "branch", .unit = "insn", .func = bench_run, .image = g_branch_class, .image_size = sizeof(g_branch_class),
+			.cycles_per_op = 1, .min_cycles = 1 },
+		{ .name = "call", .unit = "insn", .func = bench_run, .image = g_call_class, .image_size = sizeof(g_call_class),
+			.cycles_per_op = 1, .min_cycles = 1 },
+		{ .name = "memory", .unit = "insn", .func = bench_run, .image = g_memory_class, .image_size = sizeof(g_memory_class),
+			.cycles_per_op = 1, .min_cycles = 1 },
+		{ .name = "draw", .unit = "insn", .func = bench_run, .image = g_draw_class, .image_size = sizeof(g_draw_class),
+			.cycles_per_op = 1, .min_cycles = 1 },
+		{ .name = "idle", .unit = "insn", .func = bench_run, .image = g_idle_class, .image_size = sizeof(g_idle_class),
+			.cycles_per_op = 1, .min_cycles = 1 },
+
+		// The same ROM through the interpreter, translated by chip8-aot and by the recompiler
+		{ .name = "aot-run", .unit = "insn", .func = bench_run, .image = chip8_aot_run_image, .image_size = chip8_aot_run_image_size,
+			.cycles_per_op = 1, .min_cycles = 1 },
+		{ .name = "aot", .unit = "insn", .func = bench_aot, .image = chip8_aot_run_image, .image_size = chip8_aot_run_image_size,
+			.cycles_per_op = 1, .min_cycles = 1 },
+		{ .name = "aot-jit", .unit = "insn", .func = bench_jit, .image = chip8_aot_run_image, .image_size = chip8_aot_run_image_size,
+			.cycles_per_op = 1, .min_cycles = 1 },
+
+		{ .name = "snapshot", .unit = "rest", .func = bench_snapshot, .image = g_store_loop, .image_size = sizeof(g_store_loop),
+			.cycles_per_op = BENCH_RESTORE_INTERVAL, .min_cycles = BENCH_RESTORE_INTERVAL },
+		{ .name = "copy", .unit = "rest", .func = bench_copy, .image = g_store_loop, .image_size = sizeof(g_store_loop),
+			.cycles_per_op = BENCH_RESTORE_INTERVAL, .min_cycles = BENCH_RESTORE_INTERVAL },
+	};
+	const unsigned bench_count = sizeof(benches) / sizeof(benches[0]);
+
+	struct bench_t games[BENCH_MAX_GAMES];
+	unsigned game_count = 0;
+	unsigned long cycles = BENCH_DEFAULT_CYCLES;
+	unsigned repeats = BENCH_DEFAULT_REPEATS;
+	int json = 0;
+	int error = 0;
+	int opt;
+
+	memset(games, 0, sizeof(games));
+	g_l1_counter = open_l1_counter();
+
+	while ((opt = getopt(argc, argv, "n:jg:h")) != -1)
+	{
+		switch (opt)
+		{
+		case 'n':
+			repeats = strtoul(optarg, NULL, 0);
+			if (repeats == 0)
+			{
+				usage();
+				return EXIT_FAILURE;
+			}
+			break;
+
+		case 'j':
+			json = 1;
+			break;
+
+		case 'g':
+			if (game_count == BENCH_MAX_GAMES)
+			{
+				fprintf(stderr, "at most %u games\n", BENCH_MAX_GAMES);
+				return EXIT_FAILURE;
+			}
+
+			error = load_game(optarg, &games[game_count++]);
+			if (error)
+			{
+				return error;
+			}
+			break;
+
+		default:
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (argc - optind > 1)
+	{
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	if (argc - optind == 1)
+	{
+		cycles = strtoul(argv[optind], NULL, 0);
+		if (cycles == 0)
+		{
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	// Multi-instance measurements split cycles evenly
+	if (cycles >= BENCH_INSTANCES)
+	{
+		cycles -= cycles % BENCH_INSTANCES;
+	}
+
+	for (unsigned i = 0; i < bench_count + game_count && !error; ++i)
+	{
+		const struct bench_t* bench = i < bench_count ? &benches[i] : &games[i - bench_count];
+		if (cycles < bench->min_cycles)
+			continue;
+
+		unsigned long ops = bench->ops ? bench->ops : cycles / bench->cycles_per_op;
+
+		struct bench_result_t result;
+		error = measure(bench, ops, repeats, &result);
+		if (!error)
+		{
+			print_result(bench, &result, json);
+		}
+	}
+
+	for (unsigned i = 0; i < game_count; ++i)
+	{
+		if (games[i].record)
+		{
+			chip8_record_destroy(games[i].record);
+		}
+
+		free((void*)games[i].image);
+		free(games[i].path);
+	}
+
+	return error;
+}
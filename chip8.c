@@ -12,31 +12,25 @@
  */
 
 #include "chip8.h"
+#include "chip8_core.h"
 
 #include <stdlib.h>
 #include <assert.h>
 #include <string.h>
 #include <errno.h>
 #include <stdio.h>
+#include <stddef.h>
 
 
-// Fetch next opcode
-#define CHIP8_FETCH(__chip8__) 			((uint16_t)((__chip8__)->mem[(__chip8__)->PC++] << 8) | (__chip8__)->mem[(__chip8__)->PC++])
+// Layout of struct chip8_t, see chip8.h
+#define CHIP8_FIELD_END(__field__)	(offsetof(struct chip8_t, __field__) + sizeof(((struct chip8_t*)0)->__field__))
 
-// Advace by a number of opcodes
-#define CHIP8_SKIP(__chip8__, __ops__) 		((__chip8__)->PC += CHIP8_OPCODE_SIZE * (__ops__))
-#define CHIP8_NEXT(__chip8__)				CHIP8_SKIP(__chip8__, 1)
-
-// Opcode operand unpacking
-#define CHIP8_REGX_OPERAND(__opcode__) 		(((__opcode__) & 0x0F00) >> 8)
-#define CHIP8_REGY_OPERAND(__opcode__) 		(((__opcode__) & 0x00F0) >> 4)
-#define CHIP8_ADDR_OPERAND(__opcode__) 		((__opcode__) & 0x0FFF)
-#define CHIP8_CONST4_OPERAND(__opcode__)	((__opcode__) & 0x000F)
-#define CHIP8_CONST8_OPERAND(__opcode__)	((__opcode__) & 0x00FF)
-
-// Stack 
-#define CHIP8_PUSH(__chip8__, __value__)	((__chip8__)->mem[(__chip8__)->SP++] = (__value__))
-#define CHIP8_POP(__chip8__)			((__chip8__)->mem[(__chip8__)->SP--])
+_Static_assert(CHIP8_FIELD_END(video_update) <= CHIP8_CACHE_LINE, "hot state must fit the first cache line");
+_Static_assert(offsetof(struct chip8_t, mem) % CHIP8_CACHE_LINE == 0, "mem must start a cache line");
+_Static_assert(sizeof(((struct chip8_t*)0)->mem) == CHIP8_MEM_SIZE && (CHIP8_MEM_SIZE & CHIP8_MEM_MASK) == 0,
+	"mem must be a power of two masked by CHIP8_MEM_MASK");
+_Static_assert((CHIP8_STACK_DEPTH & CHIP8_STACK_MASK) == 0, "call_stack must be a power of two masked by CHIP8_STACK_MASK");
+_Static_assert(sizeof(struct chip8_t) % CHIP8_CACHE_LINE == 0, "instances in arrays must start cache lines");
 
 
 static uint8_t g_chip8_fontset[] =
@@ -62,22 +56,17 @@ static uint8_t g_chip8_fontset[] =
 
 // draw sprite at given location, with a given height (width is always 8 pixels).
 // sprite data is stored at addr.
-static void draw_sprite(struct chip8_t* chip8, unsigned x, unsigned y, unsigned height, uint16_t addr)
+void chip8_draw_sprite(struct chip8_t* chip8, unsigned x, unsigned y, unsigned height, uint16_t addr)
 {
-	uint8_t* src = chip8->mem + addr;
-
-	for (unsigned yline = 0; yline < height; ++yline)
-	{
-		for (unsigned xline = 0; xline < 8; ++xline)
-		{
-			if (*src & (0x80 >> xline))
-			{
-				chip8->V[CHIP8_VF] = (chip8->video_mem[yline + y][xline + x] == 1);
-				chip8->video_mem[yline + y][xline + x] ^= 1;
-			}
-		}
-	}
+	// VF is set if any pixel was turned off
+	chip8->V[CHIP8_VF] = (chip8_blit_sprite(chip8->video_mem, &chip8->video_dirty_rows, chip8->mem, x, y, height, addr) != 0);
+	chip8->video_update = 1;
+}
 
+void chip8_clear_screen(struct chip8_t* chip8)
+{
+	memset(chip8->video_mem, 0, sizeof(chip8->video_mem));
+	chip8->video_dirty_rows = CHIP8_ALL_ROWS;
 	chip8->video_update = 1;
 }
 
@@ -89,6 +78,8 @@ int chip8_init(struct chip8_t* chip8)
 	// Set default register values	
 	chip8->PC = CHIP8_INIT_PC;
 	chip8->SP = 0;//CHIP8_STACK_OFFSET;
+	chip8->ips = CHIP8_DEFAULT_IPS;
+	chip8_set_seed(chip8, CHIP8_DEFAULT_SEED);
 	
 	// Set default key states
 	for (unsigned i = 0; i < CHIP8_TOTAL_KEYS; ++i)
@@ -102,275 +93,92 @@ int chip8_init(struct chip8_t* chip8)
 	return 0;
 }
 
-int chip8_exec(struct chip8_t* chip8, uint16_t opcode)
+int chip8_set_ips(struct chip8_t* chip8, uint32_t ips)
 {
-	switch (opcode & 0xF000)
+	if (ips < CHIP8_TIMER_HZ || ips > CHIP8_MAX_IPS)
+		return EINVAL;
+
+	// Keep the fraction of the current timer period
+	chip8->timer_phase = (uint32_t)((uint64_t)chip8->timer_phase * ips / chip8->ips);
+	chip8->ips = ips;
+	return 0;
+}
+
+void chip8_set_seed(struct chip8_t* chip8, uint32_t seed)
+{
+	chip8->rng_state = chip8_seed_state(seed);
+}
+
+int chip8_load_image(struct chip8_t* chip8, const uint8_t* image, size_t size)
+{
+	if (size > CHIP8_RAM_SIZE)
 	{
+		return ENOSPC;
+	}
 
-	case 0x0000: /* various */
-		switch (opcode & 0x00FF)
-		{
-		case 0x0000: /* Not used in modern interpreters */
-			return ENOTSUP;
-
-		case 0x00E0: /* clear screen */
-			memset(chip8->video_mem, 0, sizeof(chip8->video_mem));
-			break;
-
-		case 0x00EE: /* return */
-			chip8->PC = chip8->call_stack[chip8->SP--];
-			break;
-
-		default:
-			return EINVAL;
-		}
-		break;
-
-	case 0x1000: /* jump to NNN */
-		chip8->PC = CHIP8_ADDR_OPERAND(opcode);
-		break;
-
-	case 0x2000: /* call to NNN */
-		printf("Calling 0x%x, return address 0x%x\n", CHIP8_ADDR_OPERAND(opcode), chip8->PC);
-		chip8->call_stack[++chip8->SP] = chip8->PC;
-		chip8->PC = CHIP8_ADDR_OPERAND(opcode);
-		break;
-
-	case 0x3000: /* skip next insturction if VX == NN */
-		CHIP8_SKIP(chip8, (chip8->V[CHIP8_REGX_OPERAND(opcode)] == CHIP8_CONST8_OPERAND(opcode)));
-		break;
-
-	case 0x4000: /* skip next instruction if VX != NN */
-		CHIP8_SKIP(chip8, (chip8->V[CHIP8_REGX_OPERAND(opcode)] != CHIP8_CONST8_OPERAND(opcode)));
-		break;
-
-	case 0x5000: /* skip next instruction if VX == VY */
-		CHIP8_SKIP(chip8, (chip8->V[CHIP8_REGX_OPERAND(opcode)] == chip8->V[CHIP8_REGY_OPERAND(opcode)]));
-		break;
-
-	case 0x9000: /* skip next instruction if VX != VY */
-		CHIP8_SKIP(chip8, (chip8->V[CHIP8_REGX_OPERAND(opcode)] != chip8->V[CHIP8_REGY_OPERAND(opcode)]));
-		break;
-
-	case 0x6000: /* VX = NN */
-		chip8->V[CHIP8_REGX_OPERAND(opcode)] = CHIP8_CONST8_OPERAND(opcode);
-		break;
-
-	case 0x7000: /* VX += NN, carry?? */
-		chip8->V[CHIP8_REGX_OPERAND(opcode)] += CHIP8_CONST8_OPERAND(opcode);
-		printf("Register %d[0x%x]\n", CHIP8_REGX_OPERAND(opcode), chip8->V[CHIP8_REGX_OPERAND(opcode)]);
-		break;
-
-	case 0x8000: /* various */
-		switch (opcode & 0x000F)
-		{
-		case 0x0000: /* V[X] = V[Y] */
-			chip8->V[CHIP8_REGX_OPERAND(opcode)] = chip8->V[CHIP8_REGY_OPERAND(opcode)];
-			break;
-
-		case 0x0001: /* V[X] |= V[Y] */
-			chip8->V[CHIP8_REGX_OPERAND(opcode)] |= chip8->V[CHIP8_REGY_OPERAND(opcode)];
-			break;
-
-		case 0x0002: /* v[x] &= v[y] */
-			chip8->V[CHIP8_REGX_OPERAND(opcode)] &= chip8->V[CHIP8_REGY_OPERAND(opcode)];
-			break;
-				
-		case 0x0003: /* v[x] ^= v[y] */
-			chip8->V[CHIP8_REGX_OPERAND(opcode)] ^= chip8->V[CHIP8_REGY_OPERAND(opcode)];
-			break;
-
-		case 0x0004: /* v[x] += v[y], carry */
-		{		
-			int vx = CHIP8_REGX_OPERAND(opcode);
-			int vy = CHIP8_REGY_OPERAND(opcode);
-
-			chip8->V[CHIP8_VF] = chip8->V[vx] > (0xFF - (chip8->V[vy]));
-			chip8->V[vx] += chip8->V[vy];
-			break;
-		}
-
-		case 0x0005: /* V[X] -= V[Y], borrow */
-		{
-			int vx = CHIP8_REGX_OPERAND(opcode);
-			int vy = CHIP8_REGY_OPERAND(opcode);
-
-			chip8->V[CHIP8_VF] = chip8->V[vx] >= chip8->V[vy];
-			chip8->V[vx] -= chip8->V[vy];
-			break;
-		}
-
-		case 0x0006: /* V[X] >> 1, shifted bit into VF */
-		{
-			int vx = CHIP8_REGX_OPERAND(opcode);
-
-			chip8->V[CHIP8_VF] = chip8->V[vx] & 0x1;
-			chip8->V[vx] >>= 1;
-			break;
-		}
-
-		case 0x0007: /* V[X] = V[Y] - V[X], borrow */
-		{
-			int vx = (opcode & 0x0F00) >> 8;
-			int vy = (opcode & 0x00F0) >> 4;
-				
-			chip8->V[CHIP8_VF] = chip8->V[vy] >= chip8->V[vx];
-			chip8->V[vx] = chip8->V[vy] - chip8->V[vx];
-			break;
-		}
-
-		case 0x000E: /* V[X] << 1, shifted bit into VF */
-		{
-			int vx = CHIP8_REGX_OPERAND(opcode);
-
-			chip8->V[CHIP8_VF] = (0 != (chip8->V[vx] & 0x80));
-			chip8->V[vx] <<= 1;
-			break;
-		}
-
-		default:
-			return EINVAL;
-		} // switch 0x8XXX
-		break;		
-
-	case 0xA000: /* I = NNN */
-		chip8->I = CHIP8_ADDR_OPERAND(opcode);
-		break;
-
-	case 0xB000: /* jmp NNN + V0 */
-		chip8->PC = CHIP8_ADDR_OPERAND(opcode) + chip8->V[0];
-		break;
-
-	case 0xC000: /* V[X] = rand() % NN */
-		chip8->V[CHIP8_REGX_OPERAND(opcode)] = rand() % (CHIP8_CONST8_OPERAND(opcode) + 1);
-		break;
-
-	case 0xD000: /* draw sprite stored at I as 8 by N pixels at screen coords V[X]:V[Y] */
-		draw_sprite(chip8, chip8->V[CHIP8_REGX_OPERAND(opcode)], chip8->V[CHIP8_REGY_OPERAND(opcode)], CHIP8_CONST4_OPERAND(opcode), chip8->I);
-		break;
-
-	case 0xE000: /* various */
-		switch (opcode & 0x00FF)
-		{
-		case 0x009E: /* next if X is pressed */
-			chip8->PC += 2 * CHIP8_IS_KEY_MARKED(chip8->input_state, chip8->V[(opcode & 0x0F00) >> 8]);
-			break;
-
-		case 0x00A1: /* next if X is NOT pressed */
-			chip8->PC += 2 * !CHIP8_IS_KEY_MARKED(chip8->input_state, chip8->V[(opcode & 0x0F00) >> 8]);
-			break;
-
-		default:
-			return EINVAL;
-		} // switch 0xE000
-		break;
-
-	case 0xF000: /* various */
-		switch (opcode & 0x00FF)
-		{
-		case 0x0007: /* Sets VX to the value of the delay timer. */
-			chip8->V[CHIP8_REGX_OPERAND(opcode)] = chip8->delay_timer;
-			break;
-
-		case 0x000A: /* A key press is awaited, and then stored in VX. */
-		{
-			uint16_t key_state = chip8->input_state;
-			while (key_state == chip8->input_state) 
-				;
-
-			for (int i = 0; i < CHIP8_TOTAL_KEYS; ++i)
-			{
-				if (CHIP8_IS_KEY_MARKED(chip8->input_state, i) && !CHIP8_IS_KEY_MARKED(key_state, i))
-				{
-					chip8->V[CHIP8_REGX_OPERAND(opcode)] = i;
-				}
-			}
-
-			break;
-		}
-
-		case 0x0015: /* Sets the delay timer to VX. */
-			chip8->delay_timer = chip8->V[CHIP8_REGX_OPERAND(opcode)];
-			break;
-
-		case 0x0018: /* Sets the sound timer to VX. */
-			chip8->sound_timer = chip8->V[CHIP8_REGX_OPERAND(opcode)];
-			break;
-				
-		case 0x001E: /* Adds VX to I. VF if range overflow */
-		{
-			int vx = CHIP8_REGX_OPERAND(opcode);
-			chip8->V[CHIP8_VF] = (chip8->V[vx] + chip8->I) > 0xFFF;
-			chip8->I += chip8->V[vx];
-			break;
-		}
-	
-		case 0x0029: /* Sets I to the location of the sprite for the character in VX. 
-						Characters 0-F (in hexadecimal) are represented by a 4x5 font. */
-			chip8->I = chip8->V[CHIP8_REGX_OPERAND(opcode)] * 5;
-			break;
-
-		case 0x0033: /* Stores the Binary-coded decimal representation of VX, 
-						with the most significant of three digits at the address in I, 
-						the middle digit at I plus 1, and the least significant digit at I plus 2. */
-		{
-			uint8_t value = chip8->V[CHIP8_REGX_OPERAND(opcode)];
-			chip8->mem[chip8->I + 2] 	= value % 10; value /= 10;
-			chip8->mem[chip8->I + 1] 	= value % 10; value /= 10;
-			chip8->mem[chip8->I] 		= value % 10;
-			break;
-		}
-			
-		case 0x0055: /* Stores V0 to VX in memory starting at address I. */
-		{
-			int vx = CHIP8_REGX_OPERAND(opcode);
-			memcpy(&chip8->mem[chip8->I], &chip8->V[0], vx + 1);
-			break;
-		}
-
-		case 0x0065: /* Fills V0 to VX with values from memory starting at address I. */
-		{
-			int vx = CHIP8_REGX_OPERAND(opcode);
-			//memcpy(&chip8->V[0], &chip8->mem[chip8->I], vx + 1);
-			for (unsigned i = 0; i <= vx; ++i)
-			{
-				chip8->V[i] = chip8->mem[chip8->I + i];
-			}
-			break;
-		}
-
-		default:
-			return EINVAL;
-		} // switch 0xF000
-		break;
-
-	default:
-		return EINVAL;	
-	} // switch opcode
-
-	return 0;	
+	if (size)
+	{
+		memcpy(chip8->mem + CHIP8_INIT_PC, image, size);
+		chip8_invalidate(chip8, CHIP8_INIT_PC, (uint16_t)size);
+	}
 
+	return 0;
 }
 
-int chip8_tick(struct chip8_t* chip8)
+void chip8_invalidate(struct chip8_t* chip8, uint16_t addr, uint16_t size)
 {
-	uint16_t opcode = (uint16_t) chip8->mem[chip8->PC++] << 8;
-	opcode |= chip8->mem[chip8->PC++];
+	if (size == 0)
+		return;
 
-	printf("Executing 0x%x:0x%x\n", chip8->PC - 2, opcode);
+	// Guest stores wrap around memory, a range running past the end continues at 0
+	addr &= CHIP8_MEM_MASK;
+	if (size >= CHIP8_MEM_SIZE)
+	{
+		addr = 0;
+		size = CHIP8_MEM_SIZE;
+	}
+	else if ((unsigned)addr + size > CHIP8_MEM_SIZE)
+	{
+		chip8_invalidate(chip8, 0, (uint16_t)(addr + size - CHIP8_MEM_SIZE));
+		size = (uint16_t)(CHIP8_MEM_SIZE - addr);
+	}
 
-	int rc = chip8_exec(chip8, opcode);
-	
-	if (rc == 0)
+	unsigned last = (unsigned)addr + size - 1;
+
+	// Pages addr through last
+	uint64_t pages = (~0ull >> (63 - (last >> CHIP8_MEM_PAGE_SHIFT))) & (~0ull << (addr >> CHIP8_MEM_PAGE_SHIFT));
+	chip8->mem_dirty_pages |= pages;
+
+	// Only pages instructions were fetched from hold predecoded slots
+	if ((pages & chip8->code_pages) == 0)
+		return;
+
+	chip8->stale_pages |= pages & chip8->code_pages;
+
+	for (unsigned slot = addr / CHIP8_OPCODE_SIZE; slot <= last / CHIP8_OPCODE_SIZE; ++slot)
 	{
-		if (chip8->delay_timer)
-			--chip8->delay_timer;
+		chip8->decode_cache[slot].handler = 0;
+	}
+}
+
+unsigned chip8_take_stale_code(struct chip8_t* chip8, struct chip8_range_t* ranges, unsigned max_ranges)
+{
+	unsigned count = 0;
+
+	for (; chip8->stale_pages && count < max_ranges; ++count)
+	{
+		// Run of set bits starting at the lowest one
+		unsigned first = __builtin_ctzll(chip8->stale_pages);
+		uint64_t above = ~(chip8->stale_pages >> first);
+		unsigned pages = above ? __builtin_ctzll(above) : 64;
+
+		chip8->stale_pages &= pages == 64 ? 0 : ~(((1ull << pages) - 1) << first);
 
-		if (chip8->sound_timer)
-			--chip8->sound_timer;
+		ranges[count].addr = first << CHIP8_MEM_PAGE_SHIFT;
+		ranges[count].size = pages << CHIP8_MEM_PAGE_SHIFT;
 	}
 
-	return rc;
+	return count;
 }
 
 void chip8_release(struct chip8_t* chip8)
@@ -15,6 +15,7 @@
 #define CHIP8_CPU_H
 
 #include <stdint.h>
+#include <stddef.h>
 #include <assert.h>
 
 // Memory map offsets
@@ -26,8 +27,9 @@
 
 #define CHIP8_RAM_SIZE		(CHIP8_STACK_OFFSET - CHIP8_RAM_OFFSET)
 
-// Depth of call stack
+// Depth of call stack, a power of two so SP wraps around within call_stack
 #define CHIP8_STACK_DEPTH 	16
+#define CHIP8_STACK_MASK	(CHIP8_STACK_DEPTH - 1)
 
 // Index of the VX register that doubles as carry flag
 #define CHIP8_VF 		15
@@ -43,6 +45,16 @@
 #define CHIP8_VIDEO_HEIGHT 	32
 #define CHIP8_VIDEO_MEM_SIZE	(CHIP8_VIDEO_HEIGHT * (CHIP8_VIDEO_WIDTH >> 3)) // Video mem size in bytes
 
+// Delay and sound timers count down at 60hz of emulated time
+#define CHIP8_TIMER_HZ		60
+
+// Emulated instructions per second, see chip8_set_ips
+#define CHIP8_DEFAULT_IPS	500
+#define CHIP8_MAX_IPS		1000000
+
+// Seed of the CXNN random numbers after chip8_init, see chip8_set_seed
+#define CHIP8_DEFAULT_SEED	1
+
 // Font resolution 4 x 5
 #define CHIP8_FONT_WIDTH	4
 #define CHIP8_FONT_HEIGHT	5
@@ -67,13 +79,46 @@
 #define CHIP8_KEY_F F
 #define CHIP8_TOTAL_KEYS 16
 
+// Every bit of chip8->video_dirty_rows
+#define CHIP8_ALL_ROWS		((uint32_t)((1ull << CHIP8_VIDEO_HEIGHT) - 1))
+
+// Check pixel x of a packed video row, pixel 0 is the most significant bit
+#define CHIP8_VIDEO_PIXEL(__row__, __x__)		(((__row__) >> (CHIP8_VIDEO_WIDTH - 1 - (__x__))) & 1)
+
 // Mark/clear/check input key as pressed
 #define CHIP8_MARK_KEY(__state__, __key__) 		((__state__) |= (1 << (__key__)))
 #define CHIP8_CLEAR_KEY(__state__, __key__) 		((__state__) &= ~(1 << (__key__)))
 #define CHIP8_IS_KEY_MARKED(__state__, __key__) 	(((__state__) & (1 << (__key__))) != 0)
 
 
-// Chip8 state
+struct chip8_t;
+
+// Predecoded instruction, 4 bytes so the whole decode cache takes 8 KiB. Handlers recompute operands from the opcode.
+struct chip8_insn_t
+{
+	uint16_t opcode;		// Raw opcode
+	uint8_t handler;		// Opcode handler index private to the core, 0 if this slot was not decoded yet
+};
+
+// Total size of addressable memory, a power of two so guest addresses wrap around by CHIP8_MEM_MASK
+#define CHIP8_MEM_SIZE		0x1000
+#define CHIP8_MEM_MASK		(CHIP8_MEM_SIZE - 1)
+
+// Number of decode cache slots, one per even address
+#define CHIP8_DECODE_CACHE_SIZE	(CHIP8_MEM_SIZE / CHIP8_OPCODE_SIZE)
+
+// Host cache line, hot state is kept within one
+#define CHIP8_CACHE_LINE	64
+#define CHIP8_CACHE_ALIGNED	__attribute__((aligned(CHIP8_CACHE_LINE)))
+
+// Memory writes are tracked in pages, one bit of chip8->mem_dirty_pages each
+#define CHIP8_MEM_PAGE_SHIFT	6
+#define CHIP8_MEM_PAGE_SIZE	(1 << CHIP8_MEM_PAGE_SHIFT)
+#define CHIP8_MEM_PAGES		(CHIP8_MEM_SIZE / CHIP8_MEM_PAGE_SIZE)
+
+
+// Chip8 state. Fields an instruction touches share the first cache line, bulk state follows.
+// Layout is checked at compile time in chip8.c.
 struct chip8_t
 {
 	uint8_t V[16];	// 16 general purpose registers, CHIP8_VF doubles as a carry flag
@@ -87,14 +132,38 @@ struct chip8_t
 
 	uint16_t input_state;	// Set of CHIP8_KEY_XXX flags to represent each of the 16 keys' states
 
-	uint8_t mem[0xFFF]; 	// Raw memory
+	uint8_t key_wait;	// FX0A halted the CPU until chip8_set_key_state delivers a key press
+	uint8_t key_wait_reg;	// VX register receiving the key
 
-	uint8_t video_mem[CHIP8_VIDEO_HEIGHT][CHIP8_VIDEO_WIDTH];	// 
-	uint16_t call_stack[CHIP8_STACK_DEPTH];
+	// Emulated time advances 1 / ips seconds per instruction
+	uint32_t ips;		// Instructions per second, CHIP8_DEFAULT_IPS after chip8_init
+	uint32_t timer_phase;	// Time since the last timer tick in 1 / (ips * CHIP8_TIMER_HZ) seconds, below ips
+
+	uint64_t cycles;	// Instructions executed by chip8_tick and chip8_run, plus cycles spent halted in FX0A
+
+	uint32_t rng_state;	// xorshift32 state CXNN draws from, never 0
 
 	// Below are flags for the client 
+	uint32_t video_dirty_rows;	// Bit y is set once row y changed. Clear the bits of rows you've presented
 	int video_update; 		// Video memory has been updated a number of times. Throw this flag when you've seen it
-};
+
+	uint16_t call_stack[CHIP8_STACK_DEPTH] CHIP8_CACHE_ALIGNED;
+
+	struct chip8_trace_t* trace;	// Execution trace ring, see chip8_trace.h. Left NULL by chip8_init.
+	struct chip8_opstats_t* opstats;	// Operation counters, see chip8_opstats.h. Left NULL by chip8_init.
+
+	uint64_t mem_dirty_pages;	// Bit p is set once page p was written through chip8_invalidate
+	uint64_t snapshot_id;		// Snapshot mem matches outside of mem_dirty_pages, 0 if none. See chip8_snapshot.h
+
+	// Self modifying code, in the pages of mem_dirty_pages. See chip8_take_stale_code.
+	uint64_t code_pages;		// Bit p is set once an instruction was decoded or fetched from page p
+	uint64_t stale_pages;		// Bit p is set once code page p was written, until chip8_take_stale_code
+
+	uint8_t mem[CHIP8_MEM_SIZE] CHIP8_CACHE_ALIGNED; 	// Raw memory, guest addresses are masked with CHIP8_MEM_MASK
+	uint64_t video_mem[CHIP8_VIDEO_HEIGHT];	// One bit per pixel, see chip8_get_video_rows
+
+	struct chip8_insn_t decode_cache[CHIP8_DECODE_CACHE_SIZE];	// Predecoded instructions, indexed by PC / 2
+} CHIP8_CACHE_ALIGNED;
 
 
 /**
@@ -105,23 +174,99 @@ int chip8_init(struct chip8_t* chip8);
 
 
 /**
- * 	Execute next instruction
+ * 	Execute next instruction, or let one cycle pass while FX0A halts the CPU
  */
 int chip8_tick(struct chip8_t* chip8);
 
+// Reasons for chip8_run to return
+enum chip8_exit_t
+{
+	CHIP8_EXIT_CYCLES,	// Cycle budget ran out
+	CHIP8_EXIT_FRAME,	// Video memory was updated, video_update is set
+	CHIP8_EXIT_KEY_WAIT,	// CPU is halted in FX0A until a key is pressed
+	CHIP8_EXIT_ERROR,	// Instruction failed, error is returned
+};
+
+/**
+ * 	Execute instructions until the cycle budget runs out or an event needs host attention.
+ * 	Stops right after an instruction that leaves video_update set, clear it once the frame was presented.
+ * 	Once FX0A halts the CPU, the rest of the budget passes idle with timers running and KEY_WAIT is returned,
+ * 	hosts can sleep until they deliver a key press with chip8_set_key_state.
+ * 	Loops that only wait for the delay timer or poll a key are fast-forwarded the same way, ending in the state
+ * 	running them instruction by instruction would, so an idle game costs the host next to nothing.
+ * 	@param max_cycles		Maximum number of instructions to execute
+ * 	@param exit_reason		Receives the reason execution stopped
+ * 	@return 			0 or the error of the failed instruction
+ */
+int chip8_run(struct chip8_t* chip8, unsigned long max_cycles, enum chip8_exit_t* exit_reason);
+
+/**
+ * 	Set emulated instruction rate. Timers keep ticking at CHIP8_TIMER_HZ of emulated time.
+ * 	@param ips			Instructions per second, CHIP8_TIMER_HZ to CHIP8_MAX_IPS
+ * 	@return 			0 or EINVAL
+ */
+int chip8_set_ips(struct chip8_t* chip8, uint32_t ips);
+
+/**
+ * 	Restart the random numbers CXNN draws. Instances with the same seed draw the same numbers
+ * 	whichever core, thread or batch lane runs them.
+ * 	@param seed			Any value, CHIP8_DEFAULT_SEED after chip8_init
+ */
+void chip8_set_seed(struct chip8_t* chip8, uint32_t seed);
+
+/**
+ * 	Copy a program image to CHIP8_INIT_PC, usually right after chip8_init
+ * 	@param image			Program bytes, may be NULL when size is 0
+ * 	@param size			Image size, at most CHIP8_RAM_SIZE
+ * 	@return 			0 or ENOSPC
+ */
+int chip8_load_image(struct chip8_t* chip8, const uint8_t* image, size_t size);
+
 /**
  * 	Manually decode and execute specific instruction 
  */
 int chip8_exec(struct chip8_t* chip8, uint16_t opcode);
 
 /**
- * 	Mark input key as pressed or released
+ * 	Drop predecoded instructions overlapping a memory range and mark its pages dirty.
+ * 	Core invalidates ranges written by FX33 and FX55 itself, call this when patching mem directly
+ * 	after execution has started or a snapshot was taken.
+ * 	@param addr			First modified byte
+ * 	@param size			Number of modified bytes
+ */
+void chip8_invalidate(struct chip8_t* chip8, uint16_t addr, uint16_t size);
+
+// Guest memory range
+struct chip8_range_t
+{
+	uint16_t addr;
+	uint16_t size;
+};
+
+/**
+ * 	Collect code overwritten since the last call: pages instructions were fetched from that were then written
+ * 	by FX33, FX55 or chip8_invalidate, adjacent pages merged into one range. Reported ranges are forgotten,
+ * 	ranges that did not fit stay for the next call. Stores to pages never executed do not show up here.
+ * 	@param ranges			Receives up to max_ranges ranges, CHIP8_MEM_PAGES / 2 always suffice
+ * 	@return 			Number of ranges
+ */
+unsigned chip8_take_stale_code(struct chip8_t* chip8, struct chip8_range_t* ranges, unsigned max_ranges);
+
+/**
+ * 	Mark input key as pressed or released. Pressing a key that was released resumes a CPU halted in FX0A.
  * 	@param key 			Input key index
  * 	@param is_pressed 	boolean key state value, true if pressed
  */
 static inline void chip8_set_key_state(struct chip8_t* chip8, unsigned key, int is_pressed)
 {
 	assert (key < CHIP8_TOTAL_KEYS);
+
+	if (is_pressed && chip8->key_wait && !CHIP8_IS_KEY_MARKED(chip8->input_state, key))
+	{
+		chip8->V[chip8->key_wait_reg] = key;
+		chip8->key_wait = 0;
+	}
+
 	is_pressed != 0 ? CHIP8_MARK_KEY(chip8->input_state, key) : CHIP8_CLEAR_KEY(chip8->input_state, key);
 }
 
@@ -135,6 +280,15 @@ static inline int chip8_get_key_state(struct chip8_t* chip8, unsigned key)
 	return CHIP8_IS_KEY_MARKED(chip8->input_state, key);
 }
 
+/**
+ * 	Return packed video memory, CHIP8_VIDEO_HEIGHT rows of CHIP8_VIDEO_WIDTH bits.
+ * 	Test individual pixels with CHIP8_VIDEO_PIXEL.
+ */
+static inline const uint64_t* chip8_get_video_rows(const struct chip8_t* chip8)
+{
+	return chip8->video_mem;
+}
+
 /**
  * 	Release chip8 state
  */
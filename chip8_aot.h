@@ -0,0 +1,70 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  chip8_aot.h
+ *
+ *    Description:  runtime support for ROMs translated to C by chip8-aot
+ *
+ *        Version:  1.0
+ *        Created:  10/17/2026 15:12:09
+ *
+ * =====================================================================================
+ */
+
+#ifndef CHIP8_AOT_H
+#define CHIP8_AOT_H
+
+#include "chip8.h"
+#include "chip8_core.h"
+
+#include <errno.h>
+
+
+// Name of the entry point chip8-aot generates unless told otherwise
+#define CHIP8_AOT_DEFAULT_NAME "chip8_aot_run"
+
+/**
+ * 	Entry point of a translated ROM.
+ * 	Executes exactly cycles instructions of the ROM loaded at CHIP8_INIT_PC, starting from PC.
+ * 	Addresses that were not resolved statically are executed with chip8_tick, cycles left once FX0A halts the CPU pass idle.
+ * 	@return 			0, the error returned by chip8_tick, or ESTALE once translated code was overwritten.
+ * 					After ESTALE the state is consistent and execution should continue with the interpreter.
+ */
+typedef int (*chip8_aot_fn)(struct chip8_t* chip8, unsigned long cycles);
+
+/**
+ * 	Declare a translated entry point along with the ROM image it was made from, name_image and name_image_size.
+ * 	The image has to be loaded at CHIP8_INIT_PC before the entry point is called.
+ */
+#define CHIP8_AOT_DECLARE(__name__)							\
+	int __name__(struct chip8_t* chip8, unsigned long cycles);			\
+	extern const uint8_t* const __name__##_image;					\
+	extern const size_t __name__##_image_size
+
+
+// Check that translated bytes in [addr, addr + len) still hold the image the translation was made from
+static inline int chip8_aot_intact(const struct chip8_t* chip8, const uint8_t* image, const uint8_t* code, unsigned size, unsigned addr, unsigned len)
+{
+	for (unsigned a = addr; a < addr + len; ++a)
+	{
+		// Stores wrap around memory, so does the range they are checked over
+		unsigned offset = (a & CHIP8_MEM_MASK) - CHIP8_INIT_PC;
+		if ((a & CHIP8_MEM_MASK) >= CHIP8_INIT_PC && offset < size && code[offset] && CHIP8_MEM_AT(chip8, a) != image[offset])
+			return 0;
+	}
+
+	return 1;
+}
+
+// Bring chip8->cycles and the timers up to date with the instructions run since cycles left was *mark, left is what remains now
+static inline void chip8_aot_account(struct chip8_t* chip8, unsigned long* mark, unsigned long left)
+{
+	unsigned long ran = *mark - left;
+
+	chip8->cycles += ran;
+	chip8_elapse_timers(chip8, ran);
+	*mark = left;
+}
+
+
+#endif
@@ -0,0 +1,868 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  chip8_batch.c
+ *
+ *    Description:  structure of arrays lockstep executor.
+ *    				Each step picks the running lane of a group that executed the fewest instructions,
+ *    				gathers every running lane at the same PC holding the same opcode into a mask, and
+ *    				executes that opcode for all of them at once. Lanes elsewhere wait for their turn,
+ *    				so lanes that took different paths reconverge as soon as their PCs meet again.
+ *    				Requires GCC vector extensions.
+ *
+ *        Version:  1.0
+ *        Created:  10/17/2026 17:20:14
+ *
+ * =====================================================================================
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include "chip8_batch.h"
+#include "chip8_core.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+
+#define W CHIP8_BATCH_WIDTH
+
+// One element per lane
+typedef uint8_t lane8_t __attribute__((vector_size(W)));
+typedef uint16_t lane16_t __attribute__((vector_size(W * 2)));
+typedef int8_t lane8s_t __attribute__((vector_size(W)));
+typedef int16_t lane16s_t __attribute__((vector_size(W * 2)));
+
+// 16 bit lanes viewed as 64 bit words for reductions
+typedef uint64_t lane16w_t __attribute__((vector_size(W * 2)));
+
+// Take __new__ in lanes set in __mask__, __old__ elsewhere
+#define BLEND(__mask__, __new__, __old__)	(((__new__) & (__mask__)) | ((__old__) & ~(__mask__)))
+
+// Lane memory accesses wrap around at 4K so that stray addresses never leave the lane
+#define LANE_ADDR(__addr__)	((__addr__) & CHIP8_MEM_MASK)
+
+// Runs are split into chunks whose budget fits a 16 bit lane
+#define CHIP8_BATCH_CHUNK	0xFFFF
+
+// Test/mark address where lane memory may differ
+#define DIVERGED(__g__, __addr__)	((__g__)->diverged[LANE_ADDR(__addr__) >> 3] & (1 << ((__addr__) & 7)))
+#define DIVERGE(__g__, __addr__)	((__g__)->diverged[LANE_ADDR(__addr__) >> 3] |= (1 << ((__addr__) & 7)))
+
+// Lane memory is paged. Pages hold the bytes chip8_batch_set loaded, shared by every lane and page loaded with
+// the same bytes, until the lane stores to them and gets a private copy.
+#define CHIP8_BATCH_PAGE_SHIFT	8
+#define CHIP8_BATCH_PAGE_SIZE	(1 << CHIP8_BATCH_PAGE_SHIFT)
+#define CHIP8_BATCH_PAGES	(CHIP8_MEM_SIZE >> CHIP8_BATCH_PAGE_SHIFT)
+
+#if CHIP8_BATCH_PAGES > 32
+#error "Private page masks hold 32 pages"
+#endif
+
+// Chains of the shared page table
+#define CHIP8_BATCH_SHARED_BUCKETS	1024
+
+// Lane memory byte, pages are looked up without branching
+#define LANE_MEM(__g__, __lane__, __addr__) \
+	((__g__)->pages[__lane__][LANE_ADDR(__addr__) >> CHIP8_BATCH_PAGE_SHIFT][(__addr__) & (CHIP8_BATCH_PAGE_SIZE - 1)])
+
+// Page of lane memory, page tables point at data
+struct chip8_batch_page_t
+{
+	uint8_t data[CHIP8_BATCH_PAGE_SIZE];
+	struct chip8_batch_page_t* next;	// Chain of shared pages with the same hash bucket
+	uint32_t refs;				// Lane pages mapping a shared page
+	uint32_t hash;				// Bytes of a shared page, FNV-1a
+};
+
+// CHIP8_BATCH_WIDTH instances
+struct chip8_group_t
+{
+	lane8_t V[16];
+	lane16_t I;
+	lane16_t PC;
+	lane16_t SP;
+	lane16_t delay_timer;
+	lane16_t sound_timer;
+
+	// Timer ticks as in chip8_step_timers. Right after a tick chip8->timer_phase is below CHIP8_TIMER_HZ,
+	// so periods are ips / CHIP8_TIMER_HZ instructions plus one while the remainder exceeds that phase.
+	lane16_t timer_left;		// Instructions up to and including the next tick
+	lane16_t timer_next;		// chip8->timer_phase right after the next tick
+	lane16_t ips_quot;		// ips / CHIP8_TIMER_HZ
+	lane16_t ips_rem;		// ips % CHIP8_TIMER_HZ
+	lane16_t input_state;
+
+	lane16_t running;		// Lanes executing in the current chunk
+	lane16_t left;			// Instructions each lane has left in the current chunk
+
+	uint64_t cycles[W];		// Instructions executed since init
+	uint32_t seed[W];		// CXNN xorshift state
+	uint32_t ips[W];		// Emulated instructions per second
+	uint8_t halted[W];		// FX0A halted the lane until a key press, as chip8->key_wait
+	uint8_t halt_reg[W];		// VX register receiving the key
+	uint8_t stopped[W];		// Lane is done with the current run before its budget ran out
+	int error[W];
+	enum chip8_exit_t exit_reason[W];
+	unsigned next;			// Lane the next leader search starts from
+
+	// Addresses that were stored to or loaded with different values, only there opcodes can differ between lanes
+	uint8_t diverged[CHIP8_MEM_SIZE / 8];
+
+	uint16_t call_stack[W][CHIP8_STACK_DEPTH];
+	uint64_t video_mem[W][CHIP8_VIDEO_HEIGHT];
+
+	uint8_t* pages[W][CHIP8_BATCH_PAGES];	// Page data of lane memory, NULL before the lane was loaded
+	uint32_t private_pages[W];		// Bit p is set once page p was copied on write
+};
+
+struct chip8_batch_t
+{
+	unsigned count;			// Instances
+	unsigned ngroups;		// Groups, the last one may be partially used
+	struct chip8_group_t* groups;
+	struct chip8_batch_page_t* shared[CHIP8_BATCH_SHARED_BUCKETS];	// Read only pages by content
+};
+
+
+// Lane width conversions, masks are sign extended
+#define WIDEN(__v__)		__builtin_convertvector((__v__), lane16_t)
+#define NARROW(__v__)		__builtin_convertvector((__v__), lane8_t)
+#define WIDEN_MASK(__m__)	((lane16_t)__builtin_convertvector((lane8s_t)(__m__), lane16s_t))
+
+static inline int lane_any(const lane16_t* v)
+{
+	lane16w_t words = (lane16w_t)*v;
+	uint64_t any = 0;
+
+	for (unsigned i = 0; i < sizeof(words) / sizeof(words[0]); ++i)
+		any |= words[i];
+
+	return any != 0;
+}
+
+static inline uint16_t lane_opcode(const struct chip8_group_t* g, unsigned lane, uint16_t pc)
+{
+	return (uint16_t)(LANE_MEM(g, lane, pc) << 8) | LANE_MEM(g, lane, pc + 1);
+}
+
+// Shared page holding data, NULL when out of memory
+static uint8_t* page_intern(struct chip8_batch_t* batch, const uint8_t* data)
+{
+	uint32_t hash = 0x811C9DC5;
+	for (unsigned i = 0; i < CHIP8_BATCH_PAGE_SIZE; ++i)
+	{
+		hash = (hash ^ data[i]) * 0x01000193;
+	}
+
+	struct chip8_batch_page_t** bucket = &batch->shared[hash % CHIP8_BATCH_SHARED_BUCKETS];
+	struct chip8_batch_page_t* page = *bucket;
+
+	while (page && (page->hash != hash || memcmp(page->data, data, CHIP8_BATCH_PAGE_SIZE)))
+	{
+		page = page->next;
+	}
+
+	if (page == NULL)
+	{
+		page = malloc(sizeof(*page));
+		if (page == NULL)
+		{
+			return NULL;
+		}
+
+		memcpy(page->data, data, CHIP8_BATCH_PAGE_SIZE);
+		page->hash = hash;
+		page->refs = 0;
+		page->next = *bucket;
+		*bucket = page;
+	}
+
+	++page->refs;
+	return page->data;
+}
+
+// Drop a lane page, freeing shared pages no lane maps anymore
+static void page_release(struct chip8_batch_t* batch, uint8_t* data, int is_private)
+{
+	struct chip8_batch_page_t* page = (struct chip8_batch_page_t*)data;
+
+	if (!is_private)
+	{
+		if (--page->refs)
+			return;
+
+		struct chip8_batch_page_t** link = &batch->shared[page->hash % CHIP8_BATCH_SHARED_BUCKETS];
+		while (*link != page)
+		{
+			link = &(*link)->next;
+		}
+
+		*link = page->next;
+	}
+
+	free(page);
+}
+
+static void lane_release(struct chip8_batch_t* batch, struct chip8_group_t* g, unsigned lane)
+{
+	for (unsigned p = 0; p < CHIP8_BATCH_PAGES; ++p)
+	{
+		if (g->pages[lane][p])
+			page_release(batch, g->pages[lane][p], g->private_pages[lane] >> p & 1);
+
+		g->pages[lane][p] = NULL;
+	}
+
+	g->private_pages[lane] = 0;
+}
+
+// Copy the shared pages a store of size bytes at addr touches. Returns 0 or ENOMEM.
+static int lane_own(struct chip8_batch_t* batch, struct chip8_group_t* g, unsigned lane, uint16_t addr, unsigned size)
+{
+	for (unsigned i = 0; i < size; ++i)
+	{
+		unsigned p = LANE_ADDR(addr + i) >> CHIP8_BATCH_PAGE_SHIFT;
+		if (g->private_pages[lane] >> p & 1)
+			continue;
+
+		struct chip8_batch_page_t* copy = malloc(sizeof(*copy));
+		if (copy == NULL)
+		{
+			return ENOMEM;
+		}
+
+		memcpy(copy->data, g->pages[lane][p], CHIP8_BATCH_PAGE_SIZE);
+		page_release(batch, g->pages[lane][p], 0);
+
+		g->pages[lane][p] = copy->data;
+		g->private_pages[lane] |= 1u << p;
+	}
+
+	return 0;
+}
+
+static void lane_stop(struct chip8_group_t* g, unsigned lane, enum chip8_exit_t exit_reason, int error)
+{
+	g->running[lane] = 0;
+	g->stopped[lane] = 1;
+	g->exit_reason[lane] = exit_reason;
+	g->error[lane] = error;
+}
+
+// chip8->timer_phase of a lane
+static inline uint32_t lane_timer_phase(const struct chip8_group_t* g, unsigned lane)
+{
+	return g->timer_next[lane] + g->ips[lane] - g->timer_left[lane] * CHIP8_TIMER_HZ;
+}
+
+// Start counting down to the next timer tick from a chip8->timer_phase
+static inline void lane_set_timer_phase(struct chip8_group_t* g, unsigned lane, uint32_t phase)
+{
+	g->timer_left[lane] = (g->ips[lane] - phase + CHIP8_TIMER_HZ - 1) / CHIP8_TIMER_HZ;
+	g->timer_next[lane] = phase + g->timer_left[lane] * CHIP8_TIMER_HZ - g->ips[lane];
+}
+
+// Let cycles pass in a lane halted by FX0A, as chip8_idle
+static void lane_idle(struct chip8_group_t* g, unsigned lane, uint64_t cycles)
+{
+	uint64_t phase = lane_timer_phase(g, lane) + cycles * CHIP8_TIMER_HZ;
+	uint64_t ticks = phase / g->ips[lane];
+
+	lane_set_timer_phase(g, lane, (uint32_t)(phase - ticks * g->ips[lane]));
+	g->delay_timer[lane] = g->delay_timer[lane] > ticks ? g->delay_timer[lane] - ticks : 0;
+	g->sound_timer[lane] = g->sound_timer[lane] > ticks ? g->sound_timer[lane] - ticks : 0;
+	g->cycles[lane] += cycles;
+}
+
+// Execute opcode in every lane of the mask at once. Returns 0 if the opcode has to run per lane.
+static int vector_exec(struct chip8_group_t* g, uint16_t opcode, const lane8_t* lane_mask8, const lane16_t* lane_mask16)
+{
+	const lane8_t m8 = *lane_mask8;
+	const lane16_t m16 = *lane_mask16;
+	const unsigned x = CHIP8_REGX_OPERAND(opcode);
+	const unsigned y = CHIP8_REGY_OPERAND(opcode);
+	const uint8_t nn = CHIP8_CONST8_OPERAND(opcode);
+	const uint16_t nnn = CHIP8_ADDR_OPERAND(opcode);
+
+	// Statement order follows the scalar cores, VF may alias VX or VY
+	lane8_t* VX = &g->V[x];
+	lane8_t* VY = &g->V[y];
+	lane8_t* VF = &g->V[CHIP8_VF];
+
+	switch (opcode & 0xF000)
+	{
+	case 0x1000: /* jump to NNN */
+		g->PC = BLEND(m16, nnn, g->PC);
+		return 1;
+
+	case 0x3000: /* skip next insturction if VX == NN */
+		g->PC += WIDEN_MASK(m8 & (lane8_t)(*VX == nn)) & CHIP8_OPCODE_SIZE;
+		return 1;
+
+	case 0x4000: /* skip next instruction if VX != NN */
+		g->PC += WIDEN_MASK(m8 & (lane8_t)(*VX != nn)) & CHIP8_OPCODE_SIZE;
+		return 1;
+
+	case 0x5000: /* skip next instruction if VX == VY */
+		g->PC += WIDEN_MASK(m8 & (lane8_t)(*VX == *VY)) & CHIP8_OPCODE_SIZE;
+		return 1;
+
+	case 0x6000: /* VX = NN */
+		*VX = BLEND(m8, nn, *VX);
+		return 1;
+
+	case 0x7000: /* VX += NN */
+		*VX = BLEND(m8, *VX + nn, *VX);
+		return 1;
+
+	case 0x8000: /* various */
+		switch (opcode & 0x000F)
+		{
+		case 0x0000: /* V[X] = V[Y] */
+			*VX = BLEND(m8, *VY, *VX);
+			return 1;
+
+		case 0x0001: /* V[X] |= V[Y] */
+			*VX = BLEND(m8, *VX | *VY, *VX);
+			return 1;
+
+		case 0x0002: /* v[x] &= v[y] */
+			*VX = BLEND(m8, *VX & *VY, *VX);
+			return 1;
+
+		case 0x0003: /* v[x] ^= v[y] */
+			*VX = BLEND(m8, *VX ^ *VY, *VX);
+			return 1;
+
+		case 0x0004: /* v[x] += v[y], carry */
+			*VF = BLEND(m8, (lane8_t)(*VX > (0xFF - *VY)) & 1, *VF);
+			*VX = BLEND(m8, *VX + *VY, *VX);
+			return 1;
+
+		case 0x0005: /* V[X] -= V[Y], borrow */
+			*VF = BLEND(m8, (lane8_t)(*VX >= *VY) & 1, *VF);
+			*VX = BLEND(m8, *VX - *VY, *VX);
+			return 1;
+
+		case 0x0006: /* V[X] >> 1, shifted bit into VF */
+			*VF = BLEND(m8, *VX & 1, *VF);
+			*VX = BLEND(m8, *VX >> 1, *VX);
+			return 1;
+
+		case 0x0007: /* V[X] = V[Y] - V[X], borrow */
+			*VF = BLEND(m8, (lane8_t)(*VY >= *VX) & 1, *VF);
+			*VX = BLEND(m8, *VY - *VX, *VX);
+			return 1;
+
+		case 0x000E: /* V[X] << 1, shifted bit into VF */
+			*VF = BLEND(m8, *VX >> 7, *VF);
+			*VX = BLEND(m8, *VX << 1, *VX);
+			return 1;
+		}
+		return 0;
+
+	case 0x9000: /* skip next instruction if VX != VY */
+		g->PC += WIDEN_MASK(m8 & (lane8_t)(*VX != *VY)) & CHIP8_OPCODE_SIZE;
+		return 1;
+
+	case 0xA000: /* I = NNN */
+		g->I = BLEND(m16, nnn, g->I);
+		return 1;
+
+	case 0xB000: /* jmp NNN + V0 */
+		g->PC = BLEND(m16, WIDEN(g->V[0]) + nnn, g->PC);
+		return 1;
+
+	case 0xE000: /* various */
+	{
+		// Keys past the last one are never pressed
+		lane16_t key = WIDEN(*VX);
+		lane16_t pressed = (lane16_t)(key < CHIP8_TOTAL_KEYS) & ((g->input_state >> (key & (CHIP8_TOTAL_KEYS - 1))) & 1);
+
+		switch (opcode & 0x00FF)
+		{
+		case 0x009E: /* next if X is pressed */
+			g->PC += (m16 & pressed) * CHIP8_OPCODE_SIZE;
+			return 1;
+
+		case 0x00A1: /* next if X is NOT pressed */
+			g->PC += (m16 & (pressed ^ 1)) * CHIP8_OPCODE_SIZE;
+			return 1;
+		}
+		return 0;
+	}
+
+	case 0xF000: /* various */
+		switch (opcode & 0x00FF)
+		{
+		case 0x0007: /* Sets VX to the value of the delay timer. */
+			*VX = BLEND(m8, NARROW(g->delay_timer), *VX);
+			return 1;
+
+		case 0x0015: /* Sets the delay timer to VX. */
+			g->delay_timer = BLEND(m16, WIDEN(*VX), g->delay_timer);
+			return 1;
+
+		case 0x0018: /* Sets the sound timer to VX. */
+			g->sound_timer = BLEND(m16, WIDEN(*VX), g->sound_timer);
+			return 1;
+
+		case 0x001E: /* Adds VX to I. VF if range overflow */
+			*VF = BLEND(m8, NARROW((lane16_t)(g->I > 0xFFF - WIDEN(*VX))) & 1, *VF);
+			g->I = BLEND(m16, g->I + WIDEN(*VX), g->I);
+			return 1;
+
+		case 0x0029: /* Sets I to the location of the sprite for the character in VX. */
+			g->I = BLEND(m16, WIDEN(*VX) * CHIP8_FONT_BYTES, g->I);
+			return 1;
+		}
+		return 0;
+	}
+
+	return 0;
+}
+
+// Execute opcode in a single lane. Returns 1 if the lane stopped instead of completing it.
+static int lane_exec(struct chip8_batch_t* batch, struct chip8_group_t* g, unsigned lane, uint16_t opcode)
+{
+	const unsigned x = CHIP8_REGX_OPERAND(opcode);
+	const unsigned y = CHIP8_REGY_OPERAND(opcode);
+	const uint8_t nn = CHIP8_CONST8_OPERAND(opcode);
+	const uint16_t nnn = CHIP8_ADDR_OPERAND(opcode);
+	const uint16_t I = g->I[lane];
+
+	switch (opcode & 0xF000)
+	{
+	case 0x0000: /* various */
+		switch (opcode & 0x00FF)
+		{
+		case 0x0000: /* Not used in modern interpreters */
+			lane_stop(g, lane, CHIP8_EXIT_ERROR, ENOTSUP);
+			return 1;
+
+		case 0x00E0: /* clear screen */
+			memset(g->video_mem[lane], 0, sizeof(g->video_mem[lane]));
+			return 0;
+
+		case 0x00EE: /* return */
+			g->PC[lane] = g->call_stack[lane][g->SP[lane] & CHIP8_STACK_MASK];
+			g->SP[lane] = (g->SP[lane] - 1) & CHIP8_STACK_MASK;
+			return 0;
+		}
+		break;
+
+	case 0x2000: /* call to NNN */
+		g->SP[lane] = (g->SP[lane] + 1) & CHIP8_STACK_MASK;
+		g->call_stack[lane][g->SP[lane]] = g->PC[lane];
+		g->PC[lane] = nnn;
+		return 0;
+
+	case 0xC000: /* V[X] = rand() & NN */
+		g->V[x][lane] = chip8_xorshift32(&g->seed[lane]) & nn;
+		return 0;
+
+	case 0xD000: /* draw sprite stored at I as 8 by N pixels at screen coords V[X]:V[Y] */
+	{
+		// Gather sprite lines, which may straddle pages and wrap around memory like chip8_draw_sprite
+		uint8_t sprite[CHIP8_FONT_BYTES * 3];
+		unsigned height = CHIP8_CONST4_OPERAND(opcode);
+
+		for (unsigned line = 0; line < height; ++line)
+		{
+			sprite[line] = LANE_MEM(g, lane, I + line);
+		}
+
+		g->V[CHIP8_VF][lane] = (chip8_blit_sprite(g->video_mem[lane], NULL, sprite, g->V[x][lane], g->V[y][lane], height, 0) != 0);
+		return 0;
+	}
+
+	case 0xF000: /* various */
+		switch (opcode & 0x00FF)
+		{
+		case 0x000A: /* A key press is awaited, and then stored in VX. chip8_batch_set_key_state delivers it. */
+			// Completes like any instruction, chip8_batch_run idles the rest of the budget
+			g->halted[lane] = 1;
+			g->halt_reg[lane] = x;
+			lane_stop(g, lane, CHIP8_EXIT_KEY_WAIT, 0);
+			return 0;
+
+		case 0x0033: /* Stores the Binary-coded decimal representation of VX at I, I + 1 and I + 2 */
+		{
+			int error = lane_own(batch, g, lane, I, 3);
+			if (error)
+			{
+				lane_stop(g, lane, CHIP8_EXIT_ERROR, error);
+				return 1;
+			}
+
+			uint8_t value = g->V[x][lane];
+			LANE_MEM(g, lane, I + 2) 	= value % 10; value /= 10;
+			LANE_MEM(g, lane, I + 1) 	= value % 10; value /= 10;
+			LANE_MEM(g, lane, I) 		= value % 10;
+
+			DIVERGE(g, I);
+			DIVERGE(g, I + 1);
+			DIVERGE(g, I + 2);
+			return 0;
+		}
+
+		case 0x0055: /* Stores V0 to VX in memory starting at address I. */
+		{
+			int error = lane_own(batch, g, lane, I, x + 1);
+			if (error)
+			{
+				lane_stop(g, lane, CHIP8_EXIT_ERROR, error);
+				return 1;
+			}
+
+			for (unsigned i = 0; i <= x; ++i)
+			{
+				LANE_MEM(g, lane, I + i) = g->V[i][lane];
+				DIVERGE(g, I + i);
+			}
+			return 0;
+		}
+
+		case 0x0065: /* Fills V0 to VX with values from memory starting at address I. */
+			for (unsigned i = 0; i <= x; ++i)
+			{
+				g->V[i][lane] = LANE_MEM(g, lane, I + i);
+			}
+			return 0;
+		}
+		break;
+	}
+
+	lane_stop(g, lane, CHIP8_EXIT_ERROR, EINVAL);
+	return 1;
+}
+
+// Execute one instruction for the lanes gathered behind the next running lane.
+// Returns 0 once no lane of the group is running.
+static int group_step(struct chip8_batch_t* batch, struct chip8_group_t* g)
+{
+	// Round robin over running lanes. Whichever lane leads, the others it catches up with join it for good.
+	unsigned leader = g->next;
+	for (unsigned scanned = 0; !g->running[leader]; leader = (leader + 1) % W)
+	{
+		if (++scanned > W)
+			return 0;
+	}
+
+	g->next = (leader + 1) % W;
+
+	const uint16_t pc = g->PC[leader];
+	const uint16_t opcode = lane_opcode(g, leader, pc);
+
+	lane16_t m16 = g->running & (lane16_t)(g->PC == pc);
+
+	if (DIVERGED(g, pc) || DIVERGED(g, pc + 1))
+	{
+		for (unsigned lane = 0; lane < W; ++lane)
+		{
+			if (m16[lane] && lane_opcode(g, lane, pc) != opcode)
+				m16[lane] = 0;
+		}
+	}
+
+	lane8_t m8 = NARROW(m16);
+	g->PC += m16 & CHIP8_OPCODE_SIZE;
+
+	if (!vector_exec(g, opcode, &m8, &m16))
+	{
+		for (unsigned lane = 0; lane < W; ++lane)
+		{
+			if (m16[lane] && lane_exec(batch, g, lane, opcode))
+				m16[lane] = 0;
+		}
+	}
+
+	// Advance emulated time and budgets of lanes that completed the instruction
+	g->timer_left -= m16 & 1;
+
+	lane16_t due = m16 & (lane16_t)(g->timer_left == 0);
+	if (lane_any(&due))
+	{
+		g->delay_timer -= (lane16_t)(g->delay_timer != 0) & due & 1;
+		g->sound_timer -= (lane16_t)(g->sound_timer != 0) & due & 1;
+
+		lane16_t longer = (lane16_t)(g->ips_rem > g->timer_next);
+		g->timer_left = BLEND(due, g->ips_quot + (longer & 1), g->timer_left);
+		g->timer_next = BLEND(due, g->timer_next - g->ips_rem + (longer & CHIP8_TIMER_HZ), g->timer_next);
+	}
+
+	g->left -= m16 & 1;
+	g->running &= (lane16_t)(g->left != 0);
+
+	return 1;
+}
+
+// Load lane state without updating diverged addresses. Returns 0 or ENOMEM, leaving the lane as it was.
+static int lane_load(struct chip8_batch_t* batch, struct chip8_group_t* g, unsigned lane, const struct chip8_t* chip8)
+{
+	// Map the new pages before releasing the old ones, lanes reloaded with what they hold keep sharing it
+	uint8_t* pages[CHIP8_BATCH_PAGES];
+	for (unsigned p = 0; p < CHIP8_BATCH_PAGES; ++p)
+	{
+		pages[p] = page_intern(batch, chip8->mem + (p << CHIP8_BATCH_PAGE_SHIFT));
+		if (pages[p] == NULL)
+		{
+			while (p--)
+				page_release(batch, pages[p], 0);
+
+			return ENOMEM;
+		}
+	}
+
+	for (unsigned i = 0; i < 16; ++i)
+	{
+		g->V[i][lane] = chip8->V[i];
+	}
+
+	g->I[lane] = chip8->I;
+	g->PC[lane] = chip8->PC;
+	g->SP[lane] = chip8->SP;
+	g->delay_timer[lane] = chip8->delay_timer;
+	g->sound_timer[lane] = chip8->sound_timer;
+	g->ips[lane] = chip8->ips;
+	g->ips_quot[lane] = chip8->ips / CHIP8_TIMER_HZ;
+	g->ips_rem[lane] = chip8->ips % CHIP8_TIMER_HZ;
+	lane_set_timer_phase(g, lane, chip8->timer_phase);
+	g->input_state[lane] = chip8->input_state;
+	g->cycles[lane] = chip8->cycles;
+	g->halted[lane] = chip8->key_wait;
+	g->halt_reg[lane] = chip8->key_wait_reg;
+	g->seed[lane] = chip8->rng_state;
+
+	memcpy(g->call_stack[lane], chip8->call_stack, sizeof(g->call_stack[lane]));
+	memcpy(g->video_mem[lane], chip8->video_mem, sizeof(g->video_mem[lane]));
+
+	lane_release(batch, g, lane);
+	memcpy(g->pages[lane], pages, sizeof(pages));
+	return 0;
+}
+
+
+struct chip8_batch_t* chip8_batch_create(unsigned count)
+{
+	if (count == 0)
+	{
+		errno = EINVAL;
+		return NULL;
+	}
+
+	struct chip8_batch_t* batch = malloc(sizeof(*batch));
+	if (batch == NULL)
+	{
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	batch->count = count;
+	batch->ngroups = (count + W - 1) / W;
+
+	void* groups;
+	int error = posix_memalign(&groups, 64, batch->ngroups * sizeof(struct chip8_group_t));
+	if (error)
+	{
+		free(batch);
+		errno = error;
+		return NULL;
+	}
+
+	batch->groups = groups;
+	memset(batch->groups, 0, batch->ngroups * sizeof(struct chip8_group_t));
+	memset(batch->shared, 0, sizeof(batch->shared));
+
+	struct chip8_t chip8;
+	chip8_init(&chip8);
+
+	for (unsigned lane = 0; lane < batch->ngroups * W && error == 0; ++lane)
+	{
+		error = lane_load(batch, &batch->groups[lane / W], lane % W, &chip8);
+	}
+
+	chip8_release(&chip8);
+
+	if (error)
+	{
+		chip8_batch_destroy(batch);
+		errno = error;
+		return NULL;
+	}
+
+	return batch;
+}
+
+void chip8_batch_destroy(struct chip8_batch_t* batch)
+{
+	for (unsigned lane = 0; lane < batch->ngroups * W; ++lane)
+	{
+		lane_release(batch, &batch->groups[lane / W], lane % W);
+	}
+
+	free(batch->groups);
+	free(batch);
+}
+
+unsigned chip8_batch_count(const struct chip8_batch_t* batch)
+{
+	return batch->count;
+}
+
+int chip8_batch_set(struct chip8_batch_t* batch, unsigned lane, const struct chip8_t* chip8)
+{
+	assert(lane < batch->count);
+	struct chip8_group_t* g = &batch->groups[lane / W];
+	lane %= W;
+
+	int error = lane_load(batch, g, lane, chip8);
+	if (error)
+	{
+		return error;
+	}
+
+	for (unsigned other = 0; other < W; ++other)
+	{
+		for (unsigned p = 0; p < CHIP8_BATCH_PAGES; ++p)
+		{
+			const uint8_t* mine = g->pages[lane][p];
+			const uint8_t* theirs = g->pages[other][p];
+			if (mine == theirs || theirs == NULL)
+				continue;
+
+			for (unsigned offset = 0; offset < CHIP8_BATCH_PAGE_SIZE; ++offset)
+			{
+				if (mine[offset] != theirs[offset])
+					DIVERGE(g, (p << CHIP8_BATCH_PAGE_SHIFT) + offset);
+			}
+		}
+	}
+
+	return 0;
+}
+
+void chip8_batch_get(const struct chip8_batch_t* batch, unsigned lane, struct chip8_t* chip8)
+{
+	assert(lane < batch->count);
+	const struct chip8_group_t* g = &batch->groups[lane / W];
+	lane %= W;
+
+	chip8_init(chip8);
+
+	for (unsigned i = 0; i < 16; ++i)
+	{
+		chip8->V[i] = g->V[i][lane];
+	}
+
+	chip8->I = g->I[lane];
+	chip8->PC = g->PC[lane];
+	chip8->SP = g->SP[lane];
+	chip8->delay_timer = g->delay_timer[lane];
+	chip8->sound_timer = g->sound_timer[lane];
+	chip8->ips = g->ips[lane];
+	chip8->timer_phase = lane_timer_phase(g, lane);
+	chip8->input_state = g->input_state[lane];
+	chip8->cycles = g->cycles[lane];
+	chip8->key_wait = g->halted[lane];
+	chip8->key_wait_reg = g->halt_reg[lane];
+	chip8->rng_state = g->seed[lane];
+
+	memcpy(chip8->call_stack, g->call_stack[lane], sizeof(chip8->call_stack));
+	memcpy(chip8->video_mem, g->video_mem[lane], sizeof(chip8->video_mem));
+	chip8->video_dirty_rows = CHIP8_ALL_ROWS;	// Lanes do not track rows
+
+	for (unsigned p = 0; p < CHIP8_BATCH_PAGES; ++p)
+	{
+		memcpy(chip8->mem + (p << CHIP8_BATCH_PAGE_SHIFT), g->pages[lane][p], CHIP8_BATCH_PAGE_SIZE);
+	}
+}
+
+unsigned chip8_batch_private_pages(const struct chip8_batch_t* batch, unsigned lane)
+{
+	assert(lane < batch->count);
+	return __builtin_popcount(batch->groups[lane / W].private_pages[lane % W]);
+}
+
+void chip8_batch_seed(struct chip8_batch_t* batch, unsigned lane, uint32_t seed)
+{
+	assert(lane < batch->count);
+	batch->groups[lane / W].seed[lane % W] = chip8_seed_state(seed);
+}
+
+void chip8_batch_set_key_state(struct chip8_batch_t* batch, unsigned lane, unsigned key, int is_pressed)
+{
+	assert(lane < batch->count && key < CHIP8_TOTAL_KEYS);
+	struct chip8_group_t* g = &batch->groups[lane / W];
+	lane %= W;
+	uint16_t input_state = g->input_state[lane];
+
+	if (is_pressed && g->halted[lane] && !CHIP8_IS_KEY_MARKED(input_state, key))
+	{
+		g->V[g->halt_reg[lane]][lane] = key;
+		g->halted[lane] = 0;
+	}
+
+	is_pressed != 0 ? CHIP8_MARK_KEY(input_state, key) : CHIP8_CLEAR_KEY(input_state, key);
+	g->input_state[lane] = input_state;
+}
+
+int chip8_batch_run(struct chip8_batch_t* batch, unsigned long max_cycles, enum chip8_exit_t* exit_reasons, int* errors)
+{
+	for (unsigned group = 0; group < batch->ngroups; ++group)
+	{
+		struct chip8_group_t* g = &batch->groups[group];
+		unsigned lanes = batch->count - group * W < W ? batch->count - group * W : W;
+
+		uint64_t start_cycles[W];
+
+		for (unsigned lane = 0; lane < W; ++lane)
+		{
+			g->stopped[lane] = (lane >= lanes) || g->halted[lane];
+			g->exit_reason[lane] = g->halted[lane] ? CHIP8_EXIT_KEY_WAIT : CHIP8_EXIT_CYCLES;
+			g->error[lane] = 0;
+			start_cycles[lane] = g->cycles[lane];
+		}
+
+		for (unsigned long remaining = max_cycles; remaining; )
+		{
+			uint16_t chunk = remaining < CHIP8_BATCH_CHUNK ? remaining : CHIP8_BATCH_CHUNK;
+			int alive = 0;
+
+			for (unsigned lane = 0; lane < W; ++lane)
+			{
+				g->running[lane] = g->stopped[lane] ? 0 : 0xFFFF;
+				g->left[lane] = chunk;
+				alive |= !g->stopped[lane];
+			}
+
+			if (!alive)
+				break;
+
+			while (group_step(batch, g))
+				;
+
+			for (unsigned lane = 0; lane < W; ++lane)
+			{
+				g->cycles[lane] += chunk - g->left[lane];
+			}
+
+			remaining -= chunk;
+		}
+
+		for (unsigned lane = 0; lane < lanes; ++lane)
+		{
+			// Halted lanes wait out the rest of the budget with timers running
+			if (g->halted[lane])
+				lane_idle(g, lane, max_cycles - (g->cycles[lane] - start_cycles[lane]));
+
+			exit_reasons[group * W + lane] = g->exit_reason[lane];
+			if (errors)
+				errors[group * W + lane] = g->error[lane];
+		}
+	}
+
+	return 0;
+}
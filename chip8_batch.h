@@ -0,0 +1,96 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  chip8_batch.h
+ *
+ *    Description:  lockstep execution of many chip8 instances.
+ *    				Instances are laid out as structure of arrays in groups of CHIP8_BATCH_WIDTH lanes.
+ *    				Lanes of a group sitting on the same instruction execute it together with vector
+ *    				operations, memory bound instructions run per lane.
+ *    				Lane memory is paged copy on write: lanes loaded with the same ROM share its pages,
+ *    				font and empty pages, and own only the pages they store to.
+ *
+ *        Version:  1.0
+ *        Created:  10/17/2026 17:20:14
+ *
+ * =====================================================================================
+ */
+
+#ifndef CHIP8_BATCH_H
+#define CHIP8_BATCH_H
+
+#include "chip8.h"
+
+
+// Lanes per group (make BATCH_WIDTH=...). 16 suits SSE and AVX2, 32 wants AVX-512BW for its 16 bit registers
+#ifndef CHIP8_BATCH_WIDTH
+#define CHIP8_BATCH_WIDTH	16
+#endif
+
+#if CHIP8_BATCH_WIDTH != 8 && CHIP8_BATCH_WIDTH != 16 && CHIP8_BATCH_WIDTH != 32
+#error "CHIP8_BATCH_WIDTH must be 8, 16 or 32"
+#endif
+
+struct chip8_batch_t;
+
+
+/**
+ * 	Create a batch of instances, all in chip8_init state.
+ * 	@param count			Number of instances
+ * 	@return 			New batch or NULL with errno set
+ */
+struct chip8_batch_t* chip8_batch_create(unsigned count);
+
+/**
+ * 	Release batch
+ */
+void chip8_batch_destroy(struct chip8_batch_t* batch);
+
+/**
+ * 	Return number of instances in batch
+ */
+unsigned chip8_batch_count(const struct chip8_batch_t* batch);
+
+/**
+ * 	Load instance state: registers, timers, input, cycles, memory, video and call stack.
+ * 	Loading the same state into every lane is the usual way to start a batch on a ROM.
+ * 	Memory is mapped to read only pages shared with every lane holding the same bytes.
+ * 	@return 			0 or ENOMEM, the lane is left as it was
+ */
+int chip8_batch_set(struct chip8_batch_t* batch, unsigned lane, const struct chip8_t* chip8);
+
+/**
+ * 	Copy instance state out into a regular chip8 state, which is initialized first.
+ */
+void chip8_batch_get(const struct chip8_batch_t* batch, unsigned lane, struct chip8_t* chip8);
+
+/**
+ * 	Return number of memory pages an instance copied on write since it was last set
+ */
+unsigned chip8_batch_private_pages(const struct chip8_batch_t* batch, unsigned lane);
+
+/**
+ * 	Restart the random numbers CXNN draws in this lane, see chip8_set_seed.
+ * 	chip8_batch_set carries over the generator state of the instance it copies.
+ */
+void chip8_batch_seed(struct chip8_batch_t* batch, unsigned lane, uint32_t seed);
+
+/**
+ * 	Set instance key state, see chip8_set_key_state
+ */
+void chip8_batch_set_key_state(struct chip8_batch_t* batch, unsigned lane, unsigned key, int is_pressed);
+
+/**
+ * 	Execute up to max_cycles instructions in every instance.
+ * 	Lanes stop on their own when the budget runs out, an instruction fails or FX0A halts them.
+ * 	Halted lanes idle out the budget with timers running until chip8_batch_set_key_state resumes them.
+ * 	Draws do not stop lanes. CXNN draws the same numbers as in chip8_tick.
+ * 	Lanes failing to copy a page on write stop with ENOMEM.
+ * 	@param exit_reasons		Receives the reason each instance stopped, chip8_batch_count entries
+ * 	@param errors			Receives the error of each instance or 0, may be NULL
+ * 	@return 			0
+ */
+int chip8_batch_run(struct chip8_batch_t* batch, unsigned long max_cycles, enum chip8_exit_t* exit_reasons, int* errors);
+
+
+#endif
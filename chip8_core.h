@@ -0,0 +1,298 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  chip8_core.h
+ *
+ *    Description:  internals shared by chip8 interpreter cores
+ *
+ *        Version:  1.0
+ *        Created:  10/17/2026 11:02:14
+ *
+ * =====================================================================================
+ */
+
+#ifndef CHIP8_CORE_H
+#define CHIP8_CORE_H
+
+#include "chip8.h"
+
+
+// Advace by a number of opcodes
+#define CHIP8_SKIP(__chip8__, __ops__) 		((__chip8__)->PC += CHIP8_OPCODE_SIZE * (__ops__))
+#define CHIP8_NEXT(__chip8__)				CHIP8_SKIP(__chip8__, 1)
+
+// Guest memory byte at addr, addresses wrap around at CHIP8_MEM_SIZE so no guest value reaches past mem
+#define CHIP8_MEM_AT(__chip8__, __addr__)	((__chip8__)->mem[(__addr__) & CHIP8_MEM_MASK])
+
+// Read opcode stored at addr
+#define CHIP8_OPCODE_AT(__chip8__, __addr__)	((uint16_t)(CHIP8_MEM_AT(__chip8__, __addr__) << 8) | CHIP8_MEM_AT(__chip8__, (__addr__) + 1))
+
+// Mark the pages of an opcode fetched from addr as code, see chip8->code_pages
+#define CHIP8_PAGE_BIT(__addr__)		(1ull << (((__addr__) & CHIP8_MEM_MASK) >> CHIP8_MEM_PAGE_SHIFT))
+#define CHIP8_MARK_CODE(__chip8__, __addr__)	((__chip8__)->code_pages |= CHIP8_PAGE_BIT(__addr__) | CHIP8_PAGE_BIT((__addr__) + 1))
+
+// Opcode operand unpacking
+#define CHIP8_REGX_OPERAND(__opcode__) 		(((__opcode__) & 0x0F00) >> 8)
+#define CHIP8_REGY_OPERAND(__opcode__) 		(((__opcode__) & 0x00F0) >> 4)
+#define CHIP8_ADDR_OPERAND(__opcode__) 		((__opcode__) & 0x0FFF)
+#define CHIP8_CONST4_OPERAND(__opcode__)	((__opcode__) & 0x000F)
+#define CHIP8_CONST8_OPERAND(__opcode__)	((__opcode__) & 0x00FF)
+
+// Stack 
+#define CHIP8_PUSH(__chip8__, __value__)	((__chip8__)->mem[(__chip8__)->SP++] = (__value__))
+#define CHIP8_POP(__chip8__)			((__chip8__)->mem[(__chip8__)->SP--])
+
+
+// Execution tracing, compiled out unless CHIP8_TRACE is defined
+#ifdef CHIP8_TRACE
+#include "chip8_trace.h"
+
+// Record instruction at pc before it executes
+static inline void chip8_trace_insn(struct chip8_t* chip8, uint16_t pc, uint16_t opcode)
+{
+	struct chip8_trace_t* trace = chip8->trace;
+	if (trace == NULL)
+		return;
+
+	struct chip8_trace_record_t* record = &trace->records[trace->head++ & trace->mask];
+	record->cycle = chip8->cycles;
+	record->pc = pc;
+	record->opcode = opcode;
+	record->I = chip8->I;
+	record->sp = (uint8_t)chip8->SP;
+	record->vf = chip8->V[CHIP8_VF];
+}
+
+#define CHIP8_TRACE_INSN(__chip8__, __pc__, __opcode__)	chip8_trace_insn((__chip8__), (__pc__), (__opcode__))
+#define CHIP8_TRACE_CANCEL(__chip8__)			do { if ((__chip8__)->trace) --(__chip8__)->trace->head; } while (0)
+#else
+#define CHIP8_TRACE_INSN(__chip8__, __pc__, __opcode__)	((void)0)
+#define CHIP8_TRACE_CANCEL(__chip8__)			((void)0)
+#endif
+
+
+// Operation counters, compiled out unless CHIP8_OPSTATS is defined.
+// DECLARE holds the timestamp of a timed instruction, BEGIN counts the opcode and END records its time.
+#ifdef CHIP8_OPSTATS
+#include "chip8_opstats.h"
+
+// Count opcode, return timestamp when it is timed and 0 otherwise
+static inline uint64_t chip8_opstats_begin(struct chip8_t* chip8, uint16_t opcode)
+{
+	struct chip8_opstats_t* stats = chip8->opstats;
+	if (stats == NULL)
+		return 0;
+
+	++stats->counts[chip8_op_classify(opcode)];
+
+	if (stats->sample_interval == 0 || --stats->countdown)
+		return 0;
+
+	stats->countdown = stats->sample_interval;
+	return chip8_opstats_clock();
+}
+
+static inline void chip8_opstats_end(struct chip8_t* chip8, uint16_t opcode, uint64_t start)
+{
+	if (start)
+	{
+		chip8_opstats_sample(chip8->opstats, chip8_op_classify(opcode), chip8_opstats_clock() - start);
+	}
+}
+
+#define CHIP8_OPSTATS_DECLARE(__start__)				uint64_t __start__ = 0
+#define CHIP8_OPSTATS_BEGIN(__chip8__, __opcode__, __start__)	((__start__) = chip8_opstats_begin((__chip8__), (__opcode__)))
+#define CHIP8_OPSTATS_END(__chip8__, __opcode__, __start__)	chip8_opstats_end((__chip8__), (__opcode__), (__start__))
+#else
+#define CHIP8_OPSTATS_DECLARE(__start__)
+#define CHIP8_OPSTATS_BEGIN(__chip8__, __opcode__, __start__)	((void)0)
+#define CHIP8_OPSTATS_END(__chip8__, __opcode__, __start__)	((void)0)
+#endif
+
+
+// Scramble a seed into a xorshift32 state, close seeds start far apart and none maps to 0
+static inline uint32_t chip8_seed_state(uint32_t seed)
+{
+	uint32_t x = seed + 0x9E3779B9u;
+	x ^= x >> 16;
+	x *= 0x85EBCA6Bu;
+	x ^= x >> 13;
+	x *= 0xC2B2AE35u;
+	x ^= x >> 16;
+	return x ? x : 0x9E3779B9u;
+}
+
+static inline uint32_t chip8_xorshift32(uint32_t* state)
+{
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return *state = x;
+}
+
+// Fetch next opcode
+static inline uint16_t chip8_fetch(struct chip8_t* chip8)
+{
+	uint16_t opcode = CHIP8_OPCODE_AT(chip8, chip8->PC);
+	CHIP8_MARK_CODE(chip8, chip8->PC);
+	CHIP8_NEXT(chip8);
+	return opcode;
+}
+
+// Advance emulated time by one instruction, timers count down every ips / CHIP8_TIMER_HZ instructions
+static inline void chip8_step_timers(struct chip8_t* chip8)
+{
+	chip8->timer_phase += CHIP8_TIMER_HZ;
+	if (chip8->timer_phase < chip8->ips)
+		return;
+
+	chip8->timer_phase -= chip8->ips;
+
+	if (chip8->delay_timer)
+		--chip8->delay_timer;
+
+	if (chip8->sound_timer)
+		--chip8->sound_timer;
+}
+
+// Advance emulated time by a number of instructions that did not access the timers
+static inline void chip8_elapse_timers(struct chip8_t* chip8, unsigned long cycles)
+{
+	uint64_t phase = chip8->timer_phase + (uint64_t)cycles * CHIP8_TIMER_HZ;
+	uint64_t ticks = phase / chip8->ips;
+
+	chip8->timer_phase = (uint32_t)(phase - ticks * chip8->ips);
+	chip8->delay_timer = chip8->delay_timer > ticks ? chip8->delay_timer - ticks : 0;
+	chip8->sound_timer = chip8->sound_timer > ticks ? chip8->sound_timer - ticks : 0;
+}
+
+// Let cycles pass while FX0A halts the CPU, timers keep running
+static inline void chip8_idle(struct chip8_t* chip8, unsigned long cycles)
+{
+	chip8_elapse_timers(chip8, cycles);
+	chip8->cycles += cycles;
+}
+
+// Longest loop chip8_skip_idle recognises, in bytes
+#define CHIP8_IDLE_MAX_LOOP			(3 * CHIP8_OPCODE_SIZE)
+
+// Jump to target from the instruction before next goes back at most CHIP8_IDLE_MAX_LOOP bytes
+#define CHIP8_IS_IDLE_JUMP(__next__, __target__)	((uint16_t)((__next__) - (__target__) - 1) < CHIP8_IDLE_MAX_LOOP)
+
+// Iterations of a delay timer wait loop taking loop_cycles each, found at head with timers as they are
+// once the jump that led there completes. Sets vx to the timer value the last skipped FX07 read.
+static inline unsigned long chip8_idle_timer_wait(const struct chip8_t* chip8, unsigned loop_cycles,
+	unsigned long max_iterations, uint8_t* vx)
+{
+	uint64_t phase = chip8->timer_phase + CHIP8_TIMER_HZ;
+	uint64_t delay = chip8->delay_timer;
+	if (phase >= chip8->ips)
+	{
+		phase -= chip8->ips;
+		delay -= delay != 0;
+	}
+
+	// FX07 of iteration j reads delay - (phase + j * loop_cycles * CHIP8_TIMER_HZ) / ips, the first zero ends the loop
+	uint64_t step = (uint64_t)loop_cycles * CHIP8_TIMER_HZ;
+	uint64_t iterations = delay ? (delay * chip8->ips - phase + step - 1) / step : 0;
+	if (iterations > max_iterations)
+	{
+		iterations = max_iterations;
+	}
+
+	if (iterations)
+	{
+		*vx = (uint8_t)(delay - (phase + (iterations - 1) * step) / chip8->ips);
+	}
+
+	return (unsigned long)iterations;
+}
+
+// Called right after a jump to PC, before the jump's own cycle is accounted. When PC heads a loop that can only
+// spin until a timer expires or the host changes input, whole iterations are skipped with time passing exactly
+// as if they ran, up to max_cycles. Recognised loops, in which X is any register:
+//	1NNN to itself				spins forever
+//	EX9E or EXA1, then 1NNN back		polls a key, the host changes input between runs only
+//	FX07, 3X00, then 1NNN back		waits for the delay timer to run out
+// Traced and counted machines see every instruction, nothing is skipped for them.
+// Returns cycles skipped.
+static inline unsigned long chip8_skip_idle(struct chip8_t* chip8, unsigned long max_cycles)
+{
+	uint16_t head = chip8->PC;
+	uint16_t jump_back = 0x1000 | head;
+	uint16_t opcode = CHIP8_OPCODE_AT(chip8, head);
+	unsigned loop_cycles = 0;
+	unsigned long iterations = 0;
+
+	if (chip8->trace || chip8->opstats)
+	{
+		return 0;
+	}
+
+	if (opcode == jump_back)
+	{
+		loop_cycles = 1;
+		iterations = max_cycles;
+	}
+	else if (head + CHIP8_IDLE_MAX_LOOP > CHIP8_MEM_SIZE)
+	{
+		// Longer loops would run past the end of memory
+	}
+	else if ((opcode & 0xF0FF) == 0xE09E || (opcode & 0xF0FF) == 0xE0A1)
+	{
+		// EX9E spins while the key is up, EXA1 while it is down
+		int pressed = CHIP8_IS_KEY_MARKED(chip8->input_state, chip8->V[CHIP8_REGX_OPERAND(opcode)]);
+		if (CHIP8_OPCODE_AT(chip8, head + 2) == jump_back && pressed == ((opcode & 0xFF) == 0xA1))
+		{
+			loop_cycles = 2;
+			iterations = max_cycles / loop_cycles;
+		}
+	}
+	else if ((opcode & 0xF0FF) == 0xF007 && CHIP8_OPCODE_AT(chip8, head + 2) == (0x3000 | (opcode & 0x0F00)) &&
+		CHIP8_OPCODE_AT(chip8, head + 4) == jump_back)
+	{
+		loop_cycles = 3;
+		iterations = chip8_idle_timer_wait(chip8, loop_cycles, max_cycles / loop_cycles,
+			&chip8->V[CHIP8_REGX_OPERAND(opcode)]);
+	}
+
+	chip8_idle(chip8, iterations * loop_cycles);
+	return iterations * loop_cycles;
+}
+
+// XOR sprite into packed video rows, returns pixels that were turned off. Changed rows are added to dirty_rows unless NULL.
+static inline uint64_t chip8_blit_sprite(uint64_t* video_mem, uint32_t* dirty_rows, const uint8_t* mem, unsigned x, unsigned y, unsigned height, uint16_t addr)
+{
+	uint64_t collision = 0;
+	x %= CHIP8_VIDEO_WIDTH;
+
+	for (unsigned line = 0; line < height; ++line)
+	{
+		// Sprite byte starts at pixel 0 and is rotated right by x, so pixels past the right edge wrap to the left
+		uint64_t bits = (uint64_t)mem[(addr + line) & CHIP8_MEM_MASK] << (CHIP8_VIDEO_WIDTH - 8);
+		uint64_t sprite = (bits >> x) | (bits << ((CHIP8_VIDEO_WIDTH - x) & (CHIP8_VIDEO_WIDTH - 1)));
+
+		// Sprites wrap around bottom edge as well
+		unsigned y_line = (y + line) % CHIP8_VIDEO_HEIGHT;
+		uint64_t* row = &video_mem[y_line];
+
+		collision |= *row & sprite;
+		*row ^= sprite;
+
+		if (dirty_rows && sprite)
+			*dirty_rows |= 1u << y_line;
+	}
+
+	return collision;
+}
+
+// draw sprite at given location, with a given height (width is always 8 pixels).
+// sprite data is stored at addr.
+void chip8_draw_sprite(struct chip8_t* chip8, unsigned x, unsigned y, unsigned height, uint16_t addr);
+
+// clear the screen, marks every row dirty
+void chip8_clear_screen(struct chip8_t* chip8);
+
+
+#endif
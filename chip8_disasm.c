@@ -0,0 +1,93 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  chip8_disasm.c
+ *
+ *    Description:  chip8 opcode disassembler
+ *
+ *        Version:  1.0
+ *        Created:  10/17/2026 16:41:05
+ *
+ * =====================================================================================
+ */
+
+#include "chip8_disasm.h"
+#include "chip8_core.h"
+
+#include <stdio.h>
+
+
+int chip8_disasm(uint16_t opcode, char* buffer, size_t size)
+{
+	unsigned x = CHIP8_REGX_OPERAND(opcode);
+	unsigned y = CHIP8_REGY_OPERAND(opcode);
+	unsigned n = CHIP8_CONST4_OPERAND(opcode);
+	unsigned nn = CHIP8_CONST8_OPERAND(opcode);
+	unsigned nnn = CHIP8_ADDR_OPERAND(opcode);
+
+	switch (opcode & 0xF000)
+	{
+	case 0x0000:
+		switch (nn)
+		{
+		case 0x00: return snprintf(buffer, size, "SYS 0x%03X", nnn);
+		case 0xE0: return snprintf(buffer, size, "CLS");
+		case 0xEE: return snprintf(buffer, size, "RET");
+		}
+		break;
+
+	case 0x1000: return snprintf(buffer, size, "JP 0x%03X", nnn);
+	case 0x2000: return snprintf(buffer, size, "CALL 0x%03X", nnn);
+	case 0x3000: return snprintf(buffer, size, "SE V%X, 0x%02X", x, nn);
+	case 0x4000: return snprintf(buffer, size, "SNE V%X, 0x%02X", x, nn);
+	case 0x5000: return snprintf(buffer, size, "SE V%X, V%X", x, y);
+	case 0x6000: return snprintf(buffer, size, "LD V%X, 0x%02X", x, nn);
+	case 0x7000: return snprintf(buffer, size, "ADD V%X, 0x%02X", x, nn);
+
+	case 0x8000:
+		switch (n)
+		{
+		case 0x0: return snprintf(buffer, size, "LD V%X, V%X", x, y);
+		case 0x1: return snprintf(buffer, size, "OR V%X, V%X", x, y);
+		case 0x2: return snprintf(buffer, size, "AND V%X, V%X", x, y);
+		case 0x3: return snprintf(buffer, size, "XOR V%X, V%X", x, y);
+		case 0x4: return snprintf(buffer, size, "ADD V%X, V%X", x, y);
+		case 0x5: return snprintf(buffer, size, "SUB V%X, V%X", x, y);
+		case 0x6: return snprintf(buffer, size, "SHR V%X", x);
+		case 0x7: return snprintf(buffer, size, "SUBN V%X, V%X", x, y);
+		case 0xE: return snprintf(buffer, size, "SHL V%X", x);
+		}
+		break;
+
+	case 0x9000: return snprintf(buffer, size, "SNE V%X, V%X", x, y);
+	case 0xA000: return snprintf(buffer, size, "LD I, 0x%03X", nnn);
+	case 0xB000: return snprintf(buffer, size, "JP V0, 0x%03X", nnn);
+	case 0xC000: return snprintf(buffer, size, "RND V%X, 0x%02X", x, nn);
+	case 0xD000: return snprintf(buffer, size, "DRW V%X, V%X, %u", x, y, n);
+
+	case 0xE000:
+		switch (nn)
+		{
+		case 0x9E: return snprintf(buffer, size, "SKP V%X", x);
+		case 0xA1: return snprintf(buffer, size, "SKNP V%X", x);
+		}
+		break;
+
+	case 0xF000:
+		switch (nn)
+		{
+		case 0x07: return snprintf(buffer, size, "LD V%X, DT", x);
+		case 0x0A: return snprintf(buffer, size, "LD V%X, K", x);
+		case 0x15: return snprintf(buffer, size, "LD DT, V%X", x);
+		case 0x18: return snprintf(buffer, size, "LD ST, V%X", x);
+		case 0x1E: return snprintf(buffer, size, "ADD I, V%X", x);
+		case 0x29: return snprintf(buffer, size, "LD F, V%X", x);
+		case 0x33: return snprintf(buffer, size, "LD B, V%X", x);
+		case 0x55: return snprintf(buffer, size, "LD [I], V%X", x);
+		case 0x65: return snprintf(buffer, size, "LD V%X, [I]", x);
+		}
+		break;
+	}
+
+	return snprintf(buffer, size, "DW 0x%04X", opcode);
+}
@@ -0,0 +1,32 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  chip8_disasm.h
+ *
+ *    Description:  chip8 opcode disassembler
+ *
+ *        Version:  1.0
+ *        Created:  10/17/2026 16:41:05
+ *
+ * =====================================================================================
+ */
+
+#ifndef CHIP8_DISASM_H
+#define CHIP8_DISASM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+
+// Buffer size large enough for any disassembled opcode
+#define CHIP8_DISASM_MAX	24
+
+/**
+ * 	Format opcode as a mnemonic, e.g. "ADD V1, 0x05".
+ * 	Opcodes the interpreter rejects come out as "DW 0xXXXX".
+ * 	@return 			Number of characters that the full text takes, as snprintf
+ */
+int chip8_disasm(uint16_t opcode, char* buffer, size_t size);
+
+
+#endif
@@ -0,0 +1,919 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  chip8_jit.c
+ *
+ *    Description:  x86-64 dynamic recompiler for chip8 basic blocks.
+ *
+ *    				A block is a straight-line run of ALU, I register and skip instructions,
+ *    				optionally ended by a jump, call, return or computed jump. Taken skips
+ *    				leave the block early, it carries on along the not taken path.
+ *    				V registers and I used by a block live in host registers for its duration,
+ *    				PC is a translation time constant.
+ *    				Everything else is executed by the interpreter between blocks.
+ *
+ *        Version:  1.0
+ *        Created:  10/17/2026 13:21:40
+ *
+ * =====================================================================================
+ */
+
+#define _DEFAULT_SOURCE
+
+#include "chip8_jit.h"
+#include "chip8_core.h"
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/mman.h>
+
+
+// Executable code arena size
+#define CHIP8_JIT_ARENA_SIZE 		(1024 * 1024)
+
+// Longest block in guest instructions
+#define CHIP8_JIT_MAX_BLOCK 		64
+
+// Worst case host code size of one guest instruction, FX65 loading all 16 registers is the largest
+#define CHIP8_JIT_MAX_INSN_CODE 	(16 * 32)
+
+// Worst case host code size of block entry or exit, saving or restoring all registers
+#define CHIP8_JIT_MAX_FRAME_CODE 	256
+
+
+// Returns the number of guest instructions executed, fewer than ninsns when a taken skip left early
+typedef unsigned (*chip8_block_fn)(struct chip8_t* chip8);
+
+struct chip8_jit_block_t
+{
+	chip8_block_fn code;	// Translated code, NULL if the block starts with an instruction left to the interpreter
+	uint16_t size;		// Guest bytes covered
+	uint16_t ninsns;	// Guest instructions executed by the block when no skip is taken
+	int translated;		// Slot holds a translation attempt
+};
+
+struct chip8_jit_t
+{
+	struct chip8_t* chip8;
+
+	uint8_t* arena;		// RWX code arena
+	size_t arena_used;
+
+	struct chip8_jit_block_t blocks[CHIP8_DECODE_CACHE_SIZE];	// Indexed by guest PC / 2
+};
+
+
+////////////////////////////////////////////////////////////////////
+//
+//	Driver
+//
+////////////////////////////////////////////////////////////////////
+
+
+static void translate(struct chip8_jit_t* jit, struct chip8_jit_block_t* block, uint16_t pc);
+
+struct chip8_jit_t* chip8_jit_create(struct chip8_t* chip8)
+{
+	struct chip8_jit_t* jit = calloc(1, sizeof(*jit));
+	if (!jit)
+	{
+		errno = ENOMEM;
+		return NULL;
+	}
+
+#if defined(__x86_64__)
+	jit->arena = mmap(NULL, CHIP8_JIT_ARENA_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (jit->arena == MAP_FAILED)
+	{
+		int error = errno;
+		free(jit);
+		errno = error;
+		return NULL;
+	}
+#endif
+
+	jit->chip8 = chip8;
+	return jit;
+}
+
+void chip8_jit_destroy(struct chip8_jit_t* jit)
+{
+	if (!jit)
+		return;
+
+	if (jit->arena)
+	{
+		munmap(jit->arena, CHIP8_JIT_ARENA_SIZE);
+	}
+
+	free(jit);
+}
+
+void chip8_jit_flush(struct chip8_jit_t* jit)
+{
+	memset(jit->blocks, 0, sizeof(jit->blocks));
+	jit->arena_used = 0;
+}
+
+void chip8_jit_invalidate(struct chip8_jit_t* jit, uint16_t addr, uint16_t size)
+{
+	if (size == 0)
+		return;
+
+	// Guest stores wrap around memory, a range running past the end continues at 0
+	addr &= CHIP8_MEM_MASK;
+	if ((unsigned)addr + size > CHIP8_MEM_SIZE)
+		chip8_jit_invalidate(jit, 0, (uint16_t)((unsigned)addr + size - CHIP8_MEM_SIZE));
+
+	// Blocks starting up to a maximum block length before addr may reach into the range
+	unsigned first = addr > CHIP8_JIT_MAX_BLOCK * CHIP8_OPCODE_SIZE ? addr - CHIP8_JIT_MAX_BLOCK * CHIP8_OPCODE_SIZE : 0;
+	unsigned end = (unsigned)addr + size;
+
+	for (unsigned slot = first / CHIP8_OPCODE_SIZE; slot < CHIP8_DECODE_CACHE_SIZE && slot * CHIP8_OPCODE_SIZE < end; ++slot)
+	{
+		struct chip8_jit_block_t* block = &jit->blocks[slot];
+		unsigned start = slot * CHIP8_OPCODE_SIZE;
+		unsigned block_end = start + (block->size ? block->size : CHIP8_OPCODE_SIZE);
+
+		if (block->translated && block_end > addr)
+		{
+			memset(block, 0, sizeof(*block));
+		}
+	}
+}
+
+int chip8_jit_run(struct chip8_jit_t* jit, unsigned long max_cycles, enum chip8_exit_t* exit_reason)
+{
+	struct chip8_t* chip8 = jit->chip8;
+	unsigned long cycles = max_cycles;
+
+	while (cycles)
+	{
+		if (chip8->key_wait)
+		{
+			chip8_idle(chip8, cycles);
+			*exit_reason = CHIP8_EXIT_KEY_WAIT;
+			return 0;
+		}
+
+		uint16_t pc = chip8->PC;
+
+		if (!(pc & 1) && pc < CHIP8_MEM_SIZE - 1)
+		{
+			struct chip8_jit_block_t* block = &jit->blocks[pc / CHIP8_OPCODE_SIZE];
+			if (!block->translated)
+			{
+				translate(jit, block, pc);
+			}
+
+			// Blocks never touch timers, so they can be caught up in one go
+			if (block->code && block->ninsns <= cycles)
+			{
+				unsigned executed = block->code(chip8);
+				chip8_elapse_timers(chip8, executed);
+				chip8->cycles += executed;
+				cycles -= executed;
+
+				// Blocks never draw either, only a frame the host left pending stops here
+				if (chip8->video_update)
+				{
+					*exit_reason = CHIP8_EXIT_FRAME;
+					return 0;
+				}
+				continue;
+			}
+		}
+
+		uint16_t opcode = CHIP8_OPCODE_AT(chip8, pc);
+
+		int rc = chip8_tick(chip8);
+		if (rc)
+		{
+			*exit_reason = CHIP8_EXIT_ERROR;
+			return rc;
+		}
+
+		--cycles;
+
+		// Guest stores are only ever executed by the interpreter
+		if ((opcode & 0xF0FF) == 0xF033)
+		{
+			chip8_jit_invalidate(jit, chip8->I, 3);
+		}
+		else if ((opcode & 0xF0FF) == 0xF055)
+		{
+			chip8_jit_invalidate(jit, chip8->I, CHIP8_REGX_OPERAND(opcode) + 1);
+		}
+
+		if (chip8->video_update)
+		{
+			*exit_reason = CHIP8_EXIT_FRAME;
+			return 0;
+		}
+	}
+
+	*exit_reason = chip8->key_wait ? CHIP8_EXIT_KEY_WAIT : CHIP8_EXIT_CYCLES;
+	return 0;
+}
+
+
+////////////////////////////////////////////////////////////////////
+//
+//	Translator
+//
+////////////////////////////////////////////////////////////////////
+
+
+#if defined(__x86_64__)
+
+// Host registers
+enum
+{
+	RAX = 0, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+	R8, R9, R10, R11, R12, R13, R14, R15,
+};
+
+// Condition codes
+#define CC_AE 	0x3
+#define CC_E 	0x4
+#define CC_NE 	0x5
+#define CC_A 	0x7
+
+// Group 1 ALU opcodes (op r/m32, r32) and their 0x81 extensions
+#define ALU_ADD 0x01
+#define ALU_OR 	0x09
+#define ALU_AND 0x21
+#define ALU_SUB 0x29
+#define ALU_XOR 0x31
+#define ALU_CMP 0x39
+#define ALU_EXT(__op__) ((__op__) >> 3)
+
+// Shift extensions
+#define SHIFT_SHL 4
+#define SHIFT_SHR 5
+
+// RDI holds the chip8 state, RAX and RCX are scratch, RDX holds I
+#define REG_STATE 	RDI
+#define REG_I 		RDX
+
+// Host registers V registers are allocated from, callee saved ones last
+static const uint8_t g_vreg_pool[] = { RSI, R8, R9, R10, R11, RBX, RBP, R12, R13, R14, R15 };
+#define CHIP8_JIT_VREGS (sizeof(g_vreg_pool) / sizeof(g_vreg_pool[0]))
+
+#define IS_CALLEE_SAVED(__reg__) ((__reg__) == RBX || (__reg__) == RBP || (__reg__) >= R12)
+
+#define STATE_OFFSET(__field__) ((int32_t)offsetof(struct chip8_t, __field__))
+
+
+struct emit_t
+{
+	uint8_t* p;
+	uint8_t* exits[CHIP8_JIT_MAX_BLOCK];	// rel32 of jumps to the block exit, patched once it is emitted
+	unsigned exit_count;
+	unsigned executed;			// Guest instructions executed up to and including the one being emitted
+};
+
+static void emit8(struct emit_t* e, uint8_t value)
+{
+	*e->p++ = value;
+}
+
+static void emit16(struct emit_t* e, uint16_t value)
+{
+	memcpy(e->p, &value, sizeof(value));
+	e->p += sizeof(value);
+}
+
+static void emit32(struct emit_t* e, uint32_t value)
+{
+	memcpy(e->p, &value, sizeof(value));
+	e->p += sizeof(value);
+}
+
+// REX prefix, omitted when empty unless byte registers need it
+static void emit_rex(struct emit_t* e, unsigned reg, unsigned index, unsigned rm, int force)
+{
+	uint8_t rex = 0x40 | ((reg >> 3) << 2) | ((index >> 3) << 1) | (rm >> 3);
+	if (rex != 0x40 || force)
+		emit8(e, rex);
+}
+
+static void emit_modrm(struct emit_t* e, unsigned mod, unsigned reg, unsigned rm)
+{
+	emit8(e, (mod << 6) | ((reg & 7) << 3) | (rm & 7));
+}
+
+// [state + disp32]
+static void emit_state_operand(struct emit_t* e, unsigned reg, int32_t disp)
+{
+	emit_modrm(e, 2, reg, REG_STATE);
+	emit32(e, disp);
+}
+
+// [state + index * (1 << scale) + disp32]
+static void emit_indexed_operand(struct emit_t* e, unsigned reg, unsigned index, unsigned scale, int32_t disp)
+{
+	emit_modrm(e, 2, reg, RSP);
+	emit8(e, (scale << 6) | ((index & 7) << 3) | (REG_STATE & 7));
+	emit32(e, disp);
+}
+
+// op dst32, src32
+static void emit_alu_rr(struct emit_t* e, uint8_t op, unsigned dst, unsigned src)
+{
+	emit_rex(e, src, 0, dst, 0);
+	emit8(e, op);
+	emit_modrm(e, 3, src, dst);
+}
+
+// op dst32, imm32
+static void emit_alu_ri(struct emit_t* e, uint8_t op, unsigned dst, uint32_t imm)
+{
+	emit_rex(e, 0, 0, dst, 0);
+	emit8(e, 0x81);
+	emit_modrm(e, 3, ALU_EXT(op), dst);
+	emit32(e, imm);
+}
+
+// mov dst32, src32
+static void emit_mov_rr(struct emit_t* e, unsigned dst, unsigned src)
+{
+	emit_rex(e, src, 0, dst, 0);
+	emit8(e, 0x89);
+	emit_modrm(e, 3, src, dst);
+}
+
+// mov dst32, imm32
+static void emit_mov_ri(struct emit_t* e, unsigned dst, uint32_t imm)
+{
+	emit_rex(e, 0, 0, dst, 0);
+	emit8(e, 0xB8 + (dst & 7));
+	emit32(e, imm);
+}
+
+// shl/shr dst32, imm8
+static void emit_shift(struct emit_t* e, unsigned ext, unsigned dst, uint8_t imm)
+{
+	emit_rex(e, 0, 0, dst, 0);
+	emit8(e, 0xC1);
+	emit_modrm(e, 3, ext, dst);
+	emit8(e, imm);
+}
+
+// movzx dst32, src8
+static void emit_zext8(struct emit_t* e, unsigned dst, unsigned src)
+{
+	emit_rex(e, dst, 0, src, 1);
+	emit8(e, 0x0F);
+	emit8(e, 0xB6);
+	emit_modrm(e, 3, dst, src);
+}
+
+// movzx dst32, src16
+static void emit_zext16(struct emit_t* e, unsigned dst, unsigned src)
+{
+	emit_rex(e, dst, 0, src, 0);
+	emit8(e, 0x0F);
+	emit8(e, 0xB7);
+	emit_modrm(e, 3, dst, src);
+}
+
+// setcc dst8
+static void emit_setcc(struct emit_t* e, uint8_t cc, unsigned dst)
+{
+	emit_rex(e, 0, 0, dst, 1);
+	emit8(e, 0x0F);
+	emit8(e, 0x90 + cc);
+	emit_modrm(e, 3, 0, dst);
+}
+
+// movzx dst32, byte [state + disp]
+static void emit_load8(struct emit_t* e, unsigned dst, int32_t disp)
+{
+	emit_rex(e, dst, 0, REG_STATE, 0);
+	emit8(e, 0x0F);
+	emit8(e, 0xB6);
+	emit_state_operand(e, dst, disp);
+}
+
+// movzx dst32, word [state + disp]
+static void emit_load16(struct emit_t* e, unsigned dst, int32_t disp)
+{
+	emit_rex(e, dst, 0, REG_STATE, 0);
+	emit8(e, 0x0F);
+	emit8(e, 0xB7);
+	emit_state_operand(e, dst, disp);
+}
+
+// mov byte [state + disp], src8
+static void emit_store8(struct emit_t* e, int32_t disp, unsigned src)
+{
+	emit_rex(e, src, 0, REG_STATE, 1);
+	emit8(e, 0x88);
+	emit_state_operand(e, src, disp);
+}
+
+// mov word [state + disp], src16
+static void emit_store16(struct emit_t* e, int32_t disp, unsigned src)
+{
+	emit8(e, 0x66);
+	emit_rex(e, src, 0, REG_STATE, 0);
+	emit8(e, 0x89);
+	emit_state_operand(e, src, disp);
+}
+
+// mov word [state + disp], imm16
+static void emit_store16_imm(struct emit_t* e, int32_t disp, uint16_t imm)
+{
+	emit8(e, 0x66);
+	emit8(e, 0xC7);
+	emit_state_operand(e, 0, disp);
+	emit16(e, imm);
+}
+
+// movzx dst32, byte [state + index + disp]
+static void emit_load8_indexed(struct emit_t* e, unsigned dst, unsigned index, int32_t disp)
+{
+	emit_rex(e, dst, index, REG_STATE, 0);
+	emit8(e, 0x0F);
+	emit8(e, 0xB6);
+	emit_indexed_operand(e, dst, index, 0, disp);
+}
+
+// movzx dst32, word [state + index * 2 + disp]
+static void emit_load16_indexed(struct emit_t* e, unsigned dst, unsigned index, int32_t disp)
+{
+	emit_rex(e, dst, index, REG_STATE, 0);
+	emit8(e, 0x0F);
+	emit8(e, 0xB7);
+	emit_indexed_operand(e, dst, index, 1, disp);
+}
+
+// mov word [state + index * 2 + disp], imm16
+static void emit_store16_imm_indexed(struct emit_t* e, unsigned index, int32_t disp, uint16_t imm)
+{
+	emit8(e, 0x66);
+	emit_rex(e, 0, index, REG_STATE, 0);
+	emit8(e, 0xC7);
+	emit_indexed_operand(e, 0, index, 1, disp);
+	emit16(e, imm);
+}
+
+static void emit_push(struct emit_t* e, unsigned reg)
+{
+	emit_rex(e, 0, 0, reg, 0);
+	emit8(e, 0x50 + (reg & 7));
+}
+
+static void emit_pop(struct emit_t* e, unsigned reg)
+{
+	emit_rex(e, 0, 0, reg, 0);
+	emit8(e, 0x58 + (reg & 7));
+}
+
+
+// How an instruction takes part in a block
+enum
+{
+	INSN_STOP,	// Left to the interpreter, block ends before it
+	INSN_BODY,	// Translated, block continues
+	INSN_END,	// Translated, block ends after it
+};
+
+// Classify opcode and collect V registers it touches
+static int classify(uint16_t opcode, uint16_t* vregs, int* uses_i)
+{
+	unsigned x = CHIP8_REGX_OPERAND(opcode);
+	unsigned y = CHIP8_REGY_OPERAND(opcode);
+
+	*vregs = 0;
+	*uses_i = 0;
+
+	switch (opcode & 0xF000)
+	{
+	case 0x0000:
+		return (opcode == 0x00EE) ? INSN_END : INSN_STOP;
+
+	case 0x1000:
+	case 0x2000:
+		return INSN_END;
+
+	case 0x3000:
+	case 0x4000:
+		*vregs = 1 << x;
+		return INSN_BODY;
+
+	case 0x5000:
+	case 0x9000:
+		if (opcode & 0x000F)
+			return INSN_STOP;
+		*vregs = (1 << x) | (1 << y);
+		return INSN_BODY;
+
+	case 0x6000:
+	case 0x7000:
+		*vregs = 1 << x;
+		return INSN_BODY;
+
+	case 0x8000:
+		switch (opcode & 0x000F)
+		{
+		case 0x0: case 0x1: case 0x2: case 0x3:
+			*vregs = (1 << x) | (1 << y);
+			return INSN_BODY;
+
+		case 0x4: case 0x5: case 0x6: case 0x7: case 0xE:
+			*vregs = (1 << x) | (1 << y) | (1 << CHIP8_VF);
+			return INSN_BODY;
+
+		default:
+			return INSN_STOP;
+		}
+
+	case 0xA000:
+		*uses_i = 1;
+		return INSN_BODY;
+
+	case 0xB000:
+		*vregs = 1;
+		return INSN_END;
+
+	case 0xF000:
+		switch (opcode & 0x00FF)
+		{
+		case 0x1E:
+			*vregs = (1 << x) | (1 << CHIP8_VF);
+			*uses_i = 1;
+			return INSN_BODY;
+
+		case 0x29:
+			*vregs = 1 << x;
+			*uses_i = 1;
+			return INSN_BODY;
+
+		case 0x65:
+			*vregs = (uint16_t)((2 << x) - 1);
+			*uses_i = 1;
+			return INSN_BODY;
+
+		default:
+			return INSN_STOP;
+		}
+
+	default:
+		return INSN_STOP;
+	}
+}
+
+static unsigned popcount16(uint16_t value)
+{
+	unsigned count = 0;
+	for (; value; value &= value - 1)
+		++count;
+	return count;
+}
+
+// Jump to the block exit, returning the instructions executed so far
+static void emit_exit(struct emit_t* e)
+{
+	emit_mov_ri(e, RAX, e->executed);
+	emit8(e, 0xE9);
+	e->exits[e->exit_count++] = e->p;
+	emit32(e, 0);
+}
+
+// Leave the block at the instruction after next when cond holds, otherwise go on with next
+static void emit_skip(struct emit_t* e, uint8_t cc, uint16_t next)
+{
+	// Condition codes come in pairs, cc ^ 1 is the opposite one
+	emit8(e, 0x70 + (cc ^ 1));
+	uint8_t* over = e->p;
+	emit8(e, 0);
+
+	emit_store16_imm(e, STATE_OFFSET(PC), next + CHIP8_OPCODE_SIZE);
+	emit_exit(e);
+	*over = (uint8_t)(e->p - over - 1);
+}
+
+// Emit single instruction, returns bit set of V registers written
+static uint16_t emit_insn(struct emit_t* e, const uint8_t* vreg, uint16_t opcode, uint16_t next)
+{
+	unsigned x = CHIP8_REGX_OPERAND(opcode);
+	unsigned y = CHIP8_REGY_OPERAND(opcode);
+	unsigned vx = vreg[x];
+	unsigned vy = vreg[y];
+	unsigned vf = vreg[CHIP8_VF];
+
+	switch (opcode & 0xF000)
+	{
+	case 0x0000: /* return */
+		emit_load16(e, RAX, STATE_OFFSET(SP));
+		emit_alu_ri(e, ALU_AND, RAX, CHIP8_STACK_MASK);
+		emit_load16_indexed(e, RCX, RAX, STATE_OFFSET(call_stack));
+		emit_alu_ri(e, ALU_SUB, RAX, 1);
+		emit_alu_ri(e, ALU_AND, RAX, CHIP8_STACK_MASK);
+		emit_store16(e, STATE_OFFSET(SP), RAX);
+		emit_store16(e, STATE_OFFSET(PC), RCX);
+		return 0;
+
+	case 0x1000: /* jump to NNN */
+		emit_store16_imm(e, STATE_OFFSET(PC), CHIP8_ADDR_OPERAND(opcode));
+		return 0;
+
+	case 0x2000: /* call to NNN */
+		emit_load16(e, RAX, STATE_OFFSET(SP));
+		emit_alu_ri(e, ALU_ADD, RAX, 1);
+		emit_alu_ri(e, ALU_AND, RAX, CHIP8_STACK_MASK);
+		emit_store16(e, STATE_OFFSET(SP), RAX);
+		emit_store16_imm_indexed(e, RAX, STATE_OFFSET(call_stack), next);
+		emit_store16_imm(e, STATE_OFFSET(PC), CHIP8_ADDR_OPERAND(opcode));
+		return 0;
+
+	case 0x3000: /* skip next insturction if VX == NN */
+		emit_alu_ri(e, ALU_CMP, vx, CHIP8_CONST8_OPERAND(opcode));
+		emit_skip(e, CC_E, next);
+		return 0;
+
+	case 0x4000: /* skip next instruction if VX != NN */
+		emit_alu_ri(e, ALU_CMP, vx, CHIP8_CONST8_OPERAND(opcode));
+		emit_skip(e, CC_NE, next);
+		return 0;
+
+	case 0x5000: /* skip next instruction if VX == VY */
+		emit_alu_rr(e, ALU_CMP, vx, vy);
+		emit_skip(e, CC_E, next);
+		return 0;
+
+	case 0x9000: /* skip next instruction if VX != VY */
+		emit_alu_rr(e, ALU_CMP, vx, vy);
+		emit_skip(e, CC_NE, next);
+		return 0;
+
+	case 0x6000: /* VX = NN */
+		emit_mov_ri(e, vx, CHIP8_CONST8_OPERAND(opcode));
+		return 1 << x;
+
+	case 0x7000: /* VX += NN */
+		emit_alu_ri(e, ALU_ADD, vx, CHIP8_CONST8_OPERAND(opcode));
+		emit_zext8(e, vx, vx);
+		return 1 << x;
+
+	case 0x8000:
+		// Flag is always written before the result, exactly as the interpreter does
+		switch (opcode & 0x000F)
+		{
+		case 0x0: /* V[X] = V[Y] */
+			emit_mov_rr(e, vx, vy);
+			return 1 << x;
+
+		case 0x1: /* V[X] |= V[Y] */
+			emit_alu_rr(e, ALU_OR, vx, vy);
+			return 1 << x;
+
+		case 0x2: /* v[x] &= v[y] */
+			emit_alu_rr(e, ALU_AND, vx, vy);
+			return 1 << x;
+
+		case 0x3: /* v[x] ^= v[y] */
+			emit_alu_rr(e, ALU_XOR, vx, vy);
+			return 1 << x;
+
+		case 0x4: /* v[x] += v[y], carry */
+			emit_mov_rr(e, RAX, vx);
+			emit_alu_rr(e, ALU_ADD, RAX, vy);
+			emit_shift(e, SHIFT_SHR, RAX, 8);
+			emit_mov_rr(e, vf, RAX);
+			emit_alu_rr(e, ALU_ADD, vx, vy);
+			emit_zext8(e, vx, vx);
+			break;
+
+		case 0x5: /* V[X] -= V[Y], borrow */
+			emit_alu_rr(e, ALU_XOR, RAX, RAX);
+			emit_alu_rr(e, ALU_CMP, vx, vy);
+			emit_setcc(e, CC_AE, RAX);
+			emit_mov_rr(e, vf, RAX);
+			emit_alu_rr(e, ALU_SUB, vx, vy);
+			emit_zext8(e, vx, vx);
+			break;
+
+		case 0x6: /* V[X] >> 1, shifted bit into VF */
+			emit_mov_rr(e, RAX, vx);
+			emit_alu_ri(e, ALU_AND, RAX, 1);
+			emit_mov_rr(e, vf, RAX);
+			emit_shift(e, SHIFT_SHR, vx, 1);
+			break;
+
+		case 0x7: /* V[X] = V[Y] - V[X], borrow */
+			emit_alu_rr(e, ALU_XOR, RAX, RAX);
+			emit_alu_rr(e, ALU_CMP, vy, vx);
+			emit_setcc(e, CC_AE, RAX);
+			emit_mov_rr(e, vf, RAX);
+			emit_mov_rr(e, RAX, vy);
+			emit_alu_rr(e, ALU_SUB, RAX, vx);
+			emit_zext8(e, vx, RAX);
+			break;
+
+		case 0xE: /* V[X] << 1, shifted bit into VF */
+			emit_mov_rr(e, RAX, vx);
+			emit_shift(e, SHIFT_SHR, RAX, 7);
+			emit_mov_rr(e, vf, RAX);
+			emit_shift(e, SHIFT_SHL, vx, 1);
+			emit_zext8(e, vx, vx);
+			break;
+		}
+		return (1 << x) | (1 << CHIP8_VF);
+
+	case 0xA000: /* I = NNN */
+		emit_mov_ri(e, REG_I, CHIP8_ADDR_OPERAND(opcode));
+		return 0;
+
+	case 0xB000: /* jmp NNN + V0 */
+		emit_mov_rr(e, RAX, vreg[0]);
+		emit_alu_ri(e, ALU_ADD, RAX, CHIP8_ADDR_OPERAND(opcode));
+		emit_store16(e, STATE_OFFSET(PC), RAX);
+		return 0;
+
+	case 0xF000:
+		switch (opcode & 0x00FF)
+		{
+		case 0x1E: /* Adds VX to I. VF if range overflow */
+			emit_mov_rr(e, RAX, vx);
+			emit_alu_rr(e, ALU_ADD, RAX, REG_I);
+			emit_alu_rr(e, ALU_XOR, RCX, RCX);
+			emit_alu_ri(e, ALU_CMP, RAX, 0xFFF);
+			emit_setcc(e, CC_A, RCX);
+			emit_mov_rr(e, vf, RCX);
+			emit_alu_rr(e, ALU_ADD, REG_I, vreg[x]);
+			emit_zext16(e, REG_I, REG_I);
+			return 1 << CHIP8_VF;
+
+		case 0x29: /* I = VX * 5 */
+			emit_mov_rr(e, RAX, vx);
+			emit_shift(e, SHIFT_SHL, RAX, 2);
+			emit_alu_rr(e, ALU_ADD, RAX, vx);
+			emit_mov_rr(e, REG_I, RAX);
+			return 0;
+
+		case 0x65: /* Fills V0 to VX with values from memory starting at address I. */
+			for (unsigned i = 0; i <= x; ++i)
+			{
+				// I may point anywhere in 16 bits, wrap each address into mem
+				emit_mov_rr(e, RAX, REG_I);
+				emit_alu_ri(e, ALU_ADD, RAX, i);
+				emit_alu_ri(e, ALU_AND, RAX, CHIP8_MEM_MASK);
+				emit_load8_indexed(e, vreg[i], RAX, STATE_OFFSET(mem));
+			}
+			return (uint16_t)((2 << x) - 1);
+		}
+		break;
+	}
+
+	return 0;
+}
+
+static void translate(struct chip8_jit_t* jit, struct chip8_jit_block_t* block, uint16_t pc)
+{
+	struct chip8_t* chip8 = jit->chip8;
+
+	block->translated = 1;
+	block->code = NULL;
+	block->size = CHIP8_OPCODE_SIZE;
+	block->ninsns = 0;
+
+	// Find block extent and V registers it needs
+	uint16_t vregs = 0;
+	int uses_i = 0;
+	int ends_native = 0;
+	uint16_t addr = pc;
+
+	while (block->ninsns < CHIP8_JIT_MAX_BLOCK && addr < CHIP8_MEM_SIZE - 1)
+	{
+		uint16_t insn_vregs;
+		int insn_uses_i;
+		int kind = classify(CHIP8_OPCODE_AT(chip8, addr), &insn_vregs, &insn_uses_i);
+
+		if (kind == INSN_STOP || popcount16(vregs | insn_vregs) > CHIP8_JIT_VREGS)
+			break;
+
+		vregs |= insn_vregs;
+		uses_i |= insn_uses_i;
+		addr += CHIP8_OPCODE_SIZE;
+		++block->ninsns;
+
+		if (kind == INSN_END)
+		{
+			ends_native = 1;
+			break;
+		}
+	}
+
+	if (block->ninsns == 0)
+		return;
+
+	block->size = addr - pc;
+
+	// Arena is flushed when not even a one instruction block fits
+	if (CHIP8_JIT_ARENA_SIZE - jit->arena_used < 2 * CHIP8_JIT_MAX_FRAME_CODE + CHIP8_JIT_MAX_INSN_CODE)
+	{
+		// Out of code space, start over keeping only this slot's bookkeeping
+		struct chip8_jit_block_t current = *block;
+		chip8_jit_flush(jit);
+		*block = current;
+	}
+
+	struct emit_t e = { jit->arena + jit->arena_used };
+	block->code = (chip8_block_fn) e.p;
+
+	// Allocate and load V registers
+	uint8_t vreg[16];
+	unsigned next_reg = 0;
+	for (unsigned i = 0; i < 16; ++i)
+	{
+		vreg[i] = (vregs & (1 << i)) ? g_vreg_pool[next_reg++] : RAX;
+	}
+
+	for (unsigned i = 0; i < next_reg; ++i)
+	{
+		if (IS_CALLEE_SAVED(g_vreg_pool[i]))
+			emit_push(&e, g_vreg_pool[i]);
+	}
+
+	for (unsigned i = 0; i < 16; ++i)
+	{
+		if (vregs & (1 << i))
+			emit_load8(&e, vreg[i], STATE_OFFSET(V) + i);
+	}
+
+	if (uses_i)
+	{
+		emit_load16(&e, REG_I, STATE_OFFSET(I));
+	}
+
+	// Body, ended early when the arena runs short so the exit always fits
+	const uint8_t* limit = jit->arena + CHIP8_JIT_ARENA_SIZE - CHIP8_JIT_MAX_FRAME_CODE;
+	uint16_t dirty = 0;
+	for (addr = pc; addr < pc + block->size; addr += CHIP8_OPCODE_SIZE)
+	{
+		if (e.p + CHIP8_JIT_MAX_INSN_CODE > limit)
+		{
+			block->size = addr - pc;
+			block->ninsns = block->size / CHIP8_OPCODE_SIZE;
+			ends_native = 0;
+			break;
+		}
+
+		e.executed = (addr - pc) / CHIP8_OPCODE_SIZE + 1;
+		dirty |= emit_insn(&e, vreg, CHIP8_OPCODE_AT(chip8, addr), addr + CHIP8_OPCODE_SIZE);
+		CHIP8_MARK_CODE(chip8, addr);
+	}
+
+	if (!ends_native)
+	{
+		emit_store16_imm(&e, STATE_OFFSET(PC), addr);
+	}
+
+	emit_mov_ri(&e, RAX, block->ninsns);
+
+	// Write back and return, taken skips join here. V registers written only past a skip still hold what was loaded.
+	for (unsigned i = 0; i < e.exit_count; ++i)
+	{
+		uint32_t rel = (uint32_t)(e.p - (e.exits[i] + 4));
+		memcpy(e.exits[i], &rel, sizeof(rel));
+	}
+
+	for (unsigned i = 0; i < 16; ++i)
+	{
+		if (dirty & (1 << i))
+			emit_store8(&e, STATE_OFFSET(V) + i, vreg[i]);
+	}
+
+	if (uses_i)
+	{
+		emit_store16(&e, STATE_OFFSET(I), REG_I);
+	}
+
+	for (unsigned i = next_reg; i-- > 0; )
+	{
+		if (IS_CALLEE_SAVED(g_vreg_pool[i]))
+			emit_pop(&e, g_vreg_pool[i]);
+	}
+
+	emit8(&e, 0xC3);
+
+	jit->arena_used = e.p - jit->arena;
+}
+
+#else
+
+static void translate(struct chip8_jit_t* jit, struct chip8_jit_block_t* block, uint16_t pc)
+{
+	// No native backend, everything is interpreted
+	block->translated = 1;
+	block->code = NULL;
+	block->size = CHIP8_OPCODE_SIZE;
+	block->ninsns = 0;
+}
+
+#endif
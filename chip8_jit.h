@@ -0,0 +1,58 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  chip8_jit.h
+ *
+ *    Description:  x86-64 dynamic recompiler for chip8 basic blocks
+ *
+ *        Version:  1.0
+ *        Created:  10/17/2026 13:21:40
+ *
+ * =====================================================================================
+ */
+
+#ifndef CHIP8_JIT_H
+#define CHIP8_JIT_H
+
+#include "chip8.h"
+
+struct chip8_jit_t;
+
+
+/**
+ * 	Create recompiler bound to a chip8 state.
+ * 	Translated code is cached by guest address, so a recompiler must not be shared between states.
+ * 	On hosts other than x86-64 every instruction falls back to chip8_tick.
+ * 	@return 			New recompiler or NULL with errno set
+ */
+struct chip8_jit_t* chip8_jit_create(struct chip8_t* chip8);
+
+/**
+ * 	Execute up to max_cycles instructions like chip8_run, translating blocks as they are reached.
+ * 	Anything the recompiler does not handle is executed with chip8_tick. Cycles left once FX0A halts the CPU pass idle.
+ * 	Stops right after an instruction that leaves video_update set, clear it once the frame was presented.
+ * 	@param exit_reason		Why execution stopped
+ * 	@return 			0 or the error returned by chip8_tick, execution stops at the failed instruction
+ */
+int chip8_jit_run(struct chip8_jit_t* jit, unsigned long max_cycles, enum chip8_exit_t* exit_reason);
+
+/**
+ * 	Drop translated blocks overlapping a memory range.
+ * 	Guest stores are tracked by the recompiler, call this when patching mem directly.
+ * 	@param addr			First modified byte
+ * 	@param size			Number of modified bytes
+ */
+void chip8_jit_invalidate(struct chip8_jit_t* jit, uint16_t addr, uint16_t size);
+
+/**
+ * 	Drop all translated blocks
+ */
+void chip8_jit_flush(struct chip8_jit_t* jit);
+
+/**
+ * 	Release recompiler and its code cache
+ */
+void chip8_jit_destroy(struct chip8_jit_t* jit);
+
+
+#endif
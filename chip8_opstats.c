@@ -0,0 +1,176 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  chip8_opstats.c
+ *
+ *    Description:  operation counter allocation, histogram bucketing and reports
+ *
+ *        Version:  1.0
+ *        Created:  10/17/2026 20:52:06
+ *
+ * =====================================================================================
+ */
+
+#include "chip8_opstats.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+
+// Back to back clock reads taken to estimate the cost of timing, the smallest difference is kept
+#define CHIP8_OPSTATS_CALIBRATION_READS	64
+
+static const char* g_op_names[CHIP8_OP_COUNT] =
+{
+	[CHIP8_OP_0NNN] = "0NNN", [CHIP8_OP_00E0] = "00E0", [CHIP8_OP_00EE] = "00EE",
+	[CHIP8_OP_1NNN] = "1NNN", [CHIP8_OP_2NNN] = "2NNN", [CHIP8_OP_3XNN] = "3XNN", [CHIP8_OP_4XNN] = "4XNN",
+	[CHIP8_OP_5XY0] = "5XY0", [CHIP8_OP_6XNN] = "6XNN", [CHIP8_OP_7XNN] = "7XNN",
+	[CHIP8_OP_8XY0] = "8XY0", [CHIP8_OP_8XY1] = "8XY1", [CHIP8_OP_8XY2] = "8XY2", [CHIP8_OP_8XY3] = "8XY3",
+	[CHIP8_OP_8XY4] = "8XY4", [CHIP8_OP_8XY5] = "8XY5", [CHIP8_OP_8XY6] = "8XY6", [CHIP8_OP_8XY7] = "8XY7",
+	[CHIP8_OP_8XYE] = "8XYE",
+	[CHIP8_OP_9XY0] = "9XY0", [CHIP8_OP_ANNN] = "ANNN", [CHIP8_OP_BNNN] = "BNNN", [CHIP8_OP_CXNN] = "CXNN",
+	[CHIP8_OP_DXYN] = "DXYN",
+	[CHIP8_OP_EX9E] = "EX9E", [CHIP8_OP_EXA1] = "EXA1",
+	[CHIP8_OP_FX07] = "FX07", [CHIP8_OP_FX0A] = "FX0A", [CHIP8_OP_FX15] = "FX15", [CHIP8_OP_FX18] = "FX18",
+	[CHIP8_OP_FX1E] = "FX1E", [CHIP8_OP_FX29] = "FX29", [CHIP8_OP_FX33] = "FX33", [CHIP8_OP_FX55] = "FX55",
+	[CHIP8_OP_FX65] = "FX65",
+	[CHIP8_OP_INVALID] = "invalid",
+};
+
+const char* chip8_op_name(enum chip8_op_t op)
+{
+	return op < CHIP8_OP_COUNT ? g_op_names[op] : g_op_names[CHIP8_OP_INVALID];
+}
+
+struct chip8_opstats_t* chip8_opstats_create(uint32_t sample_interval)
+{
+	if (sample_interval && !CHIP8_OPSTATS_HAVE_CLOCK)
+	{
+		errno = ENOTSUP;
+		return NULL;
+	}
+
+	struct chip8_opstats_t* stats = calloc(1, sizeof(*stats));
+	if (stats == NULL)
+	{
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	stats->sample_interval = sample_interval;
+	stats->countdown = sample_interval;
+	stats->clock_overhead = ~0ull;
+
+	for (unsigned i = 0; i < CHIP8_OPSTATS_CALIBRATION_READS; ++i)
+	{
+		uint64_t start = chip8_opstats_clock();
+		uint64_t ticks = chip8_opstats_clock() - start;
+		if (ticks < stats->clock_overhead)
+		{
+			stats->clock_overhead = ticks;
+		}
+	}
+
+	return stats;
+}
+
+void chip8_opstats_destroy(struct chip8_opstats_t* stats)
+{
+	free(stats);
+}
+
+void chip8_opstats_reset(struct chip8_opstats_t* stats)
+{
+	stats->countdown = stats->sample_interval;
+	memset(stats->counts, 0, sizeof(stats->counts));
+	memset(stats->samples, 0, sizeof(stats->samples));
+	memset(stats->ticks, 0, sizeof(stats->ticks));
+	memset(stats->histogram, 0, sizeof(stats->histogram));
+}
+
+void chip8_opstats_sample(struct chip8_opstats_t* stats, enum chip8_op_t op, uint64_t ticks)
+{
+	ticks = ticks > stats->clock_overhead ? ticks - stats->clock_overhead : 0;
+
+	unsigned bucket = 63 - __builtin_clzll(ticks + 1);
+	if (bucket >= CHIP8_OPSTATS_BUCKETS)
+	{
+		bucket = CHIP8_OPSTATS_BUCKETS - 1;
+	}
+
+	++stats->samples[op];
+	stats->ticks[op] += ticks;
+	++stats->histogram[op][bucket];
+}
+
+// Largest tick count falling into the bucket holding the given share of an operation's samples
+static uint64_t percentile(const struct chip8_opstats_t* stats, enum chip8_op_t op, double share)
+{
+	uint64_t seen = 0;
+	unsigned bucket = 0;
+
+	for (; bucket < CHIP8_OPSTATS_BUCKETS - 1; ++bucket)
+	{
+		seen += stats->histogram[op][bucket];
+		if (seen >= share * stats->samples[op])
+			break;
+	}
+
+	return (2ull << bucket) - 2;
+}
+
+int chip8_opstats_dump(const struct chip8_opstats_t* stats, FILE* file)
+{
+	enum chip8_op_t order[CHIP8_OP_COUNT];
+	uint64_t total = 0;
+
+	// Most frequent first
+	for (unsigned i = 0; i < CHIP8_OP_COUNT; ++i)
+	{
+		unsigned j = i;
+		for (; j > 0 && stats->counts[order[j - 1]] < stats->counts[i]; --j)
+		{
+			order[j] = order[j - 1];
+		}
+
+		order[j] = i;
+		total += stats->counts[i];
+	}
+
+	fprintf(file, "# %llu instructions, every %u timed, %llu ticks clock overhead\n",
+		(unsigned long long)total, stats->sample_interval, (unsigned long long)stats->clock_overhead);
+	fprintf(file, "# op          count   share    samples    mean    p50<=    p99<=  histogram by log2(ticks + 1)\n");
+
+	for (unsigned i = 0; i < CHIP8_OP_COUNT && stats->counts[order[i]]; ++i)
+	{
+		enum chip8_op_t op = order[i];
+
+		fprintf(file, "%-7s %12llu %6.2f%% %10llu", chip8_op_name(op), (unsigned long long)stats->counts[op],
+			100.0 * stats->counts[op] / total, (unsigned long long)stats->samples[op]);
+
+		if (stats->samples[op] == 0)
+		{
+			fprintf(file, "\n");
+			continue;
+		}
+
+		fprintf(file, " %7.1f %8llu %8llu ", (double)stats->ticks[op] / stats->samples[op],
+			(unsigned long long)percentile(stats, op, 0.5), (unsigned long long)percentile(stats, op, 0.99));
+
+		unsigned last = CHIP8_OPSTATS_BUCKETS - 1;
+		while (stats->histogram[op][last] == 0)
+		{
+			--last;
+		}
+
+		for (unsigned bucket = 0; bucket <= last; ++bucket)
+		{
+			fprintf(file, " %llu", (unsigned long long)stats->histogram[op][bucket]);
+		}
+
+		fprintf(file, "\n");
+	}
+
+	return fflush(file) ? errno : 0;
+}
@@ -0,0 +1,174 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  chip8_opstats.h
+ *
+ *    Description:  per operation execution counters and latency histograms.
+ *    				Counting is compiled in only when building with CHIP8_OPSTATS defined (make OPSTATS=1),
+ *    				otherwise attached counters stay zero and the cores carry no instrumentation.
+ *    				Covers the interpreter cores, code run by chip8_jit_t, chip8_batch_t or AOT
+ *    				translation is not counted.
+ *
+ *        Version:  1.0
+ *        Created:  10/17/2026 20:52:06
+ *
+ * =====================================================================================
+ */
+
+#ifndef CHIP8_OPSTATS_H
+#define CHIP8_OPSTATS_H
+
+#include "chip8.h"
+
+#include <stdio.h>
+
+
+// Histogram buckets, bucket b counts samples with 2^b <= ticks + 1 < 2^(b + 1), the last one everything above
+#define CHIP8_OPSTATS_BUCKETS	32
+
+// Operations told apart by the counters
+enum chip8_op_t
+{
+	CHIP8_OP_0NNN, CHIP8_OP_00E0, CHIP8_OP_00EE,
+	CHIP8_OP_1NNN, CHIP8_OP_2NNN, CHIP8_OP_3XNN, CHIP8_OP_4XNN, CHIP8_OP_5XY0, CHIP8_OP_6XNN, CHIP8_OP_7XNN,
+	CHIP8_OP_8XY0, CHIP8_OP_8XY1, CHIP8_OP_8XY2, CHIP8_OP_8XY3, CHIP8_OP_8XY4, CHIP8_OP_8XY5, CHIP8_OP_8XY6,
+	CHIP8_OP_8XY7, CHIP8_OP_8XYE,
+	CHIP8_OP_9XY0, CHIP8_OP_ANNN, CHIP8_OP_BNNN, CHIP8_OP_CXNN, CHIP8_OP_DXYN,
+	CHIP8_OP_EX9E, CHIP8_OP_EXA1,
+	CHIP8_OP_FX07, CHIP8_OP_FX0A, CHIP8_OP_FX15, CHIP8_OP_FX18, CHIP8_OP_FX1E, CHIP8_OP_FX29, CHIP8_OP_FX33,
+	CHIP8_OP_FX55, CHIP8_OP_FX65,
+	CHIP8_OP_INVALID,	// Opcodes the interpreter rejects
+
+	CHIP8_OP_COUNT
+};
+
+// Counters attached to a chip8 state through chip8->opstats
+struct chip8_opstats_t
+{
+	uint32_t sample_interval;	// Every sample_interval-th instruction is timed, 0 only counts
+	uint32_t countdown;		// Instructions left until the next timed one
+	uint64_t clock_overhead;	// Ticks between two back to back clock reads, taken off every sample
+
+	uint64_t counts[CHIP8_OP_COUNT];	// Executions per operation
+	uint64_t samples[CHIP8_OP_COUNT];	// Timed executions per operation
+	uint64_t ticks[CHIP8_OP_COUNT];		// Sum of timed ticks per operation
+	uint64_t histogram[CHIP8_OP_COUNT][CHIP8_OPSTATS_BUCKETS];
+};
+
+// CPU timestamp counter read around timed instructions
+#if defined(__x86_64__) || defined(__i386__)
+#define CHIP8_OPSTATS_HAVE_CLOCK	1
+static inline uint64_t chip8_opstats_clock(void)
+{
+	return __builtin_ia32_rdtsc();
+}
+#else
+#define CHIP8_OPSTATS_HAVE_CLOCK	0
+static inline uint64_t chip8_opstats_clock(void)
+{
+	return 0;
+}
+#endif
+
+
+/**
+ * 	Return operation an opcode executes as
+ */
+static inline enum chip8_op_t chip8_op_classify(uint16_t opcode)
+{
+	switch (opcode >> 12)
+	{
+	case 0x0:
+		switch (opcode & 0x00FF)
+		{
+		case 0x00: return CHIP8_OP_0NNN;
+		case 0xE0: return CHIP8_OP_00E0;
+		case 0xEE: return CHIP8_OP_00EE;
+		default: return CHIP8_OP_INVALID;
+		}
+
+	case 0x8:
+		switch (opcode & 0x000F)
+		{
+		case 0x0: case 0x1: case 0x2: case 0x3: case 0x4: case 0x5: case 0x6: case 0x7:
+			return CHIP8_OP_8XY0 + (opcode & 0x000F);
+		case 0xE: return CHIP8_OP_8XYE;
+		default: return CHIP8_OP_INVALID;
+		}
+
+	case 0xE:
+		switch (opcode & 0x00FF)
+		{
+		case 0x9E: return CHIP8_OP_EX9E;
+		case 0xA1: return CHIP8_OP_EXA1;
+		default: return CHIP8_OP_INVALID;
+		}
+
+	case 0xF:
+		switch (opcode & 0x00FF)
+		{
+		case 0x07: return CHIP8_OP_FX07;
+		case 0x0A: return CHIP8_OP_FX0A;
+		case 0x15: return CHIP8_OP_FX15;
+		case 0x18: return CHIP8_OP_FX18;
+		case 0x1E: return CHIP8_OP_FX1E;
+		case 0x29: return CHIP8_OP_FX29;
+		case 0x33: return CHIP8_OP_FX33;
+		case 0x55: return CHIP8_OP_FX55;
+		case 0x65: return CHIP8_OP_FX65;
+		default: return CHIP8_OP_INVALID;
+		}
+
+	case 0x1: return CHIP8_OP_1NNN;
+	case 0x2: return CHIP8_OP_2NNN;
+	case 0x3: return CHIP8_OP_3XNN;
+	case 0x4: return CHIP8_OP_4XNN;
+	case 0x5: return CHIP8_OP_5XY0;
+	case 0x6: return CHIP8_OP_6XNN;
+	case 0x7: return CHIP8_OP_7XNN;
+	case 0x9: return CHIP8_OP_9XY0;
+	case 0xA: return CHIP8_OP_ANNN;
+	case 0xB: return CHIP8_OP_BNNN;
+	case 0xC: return CHIP8_OP_CXNN;
+	default: return CHIP8_OP_DXYN;
+	}
+}
+
+/**
+ * 	Return operation pattern, e.g. "8XY4" or "invalid"
+ */
+const char* chip8_op_name(enum chip8_op_t op);
+
+/**
+ * 	Allocate zeroed counters.
+ * 	@param sample_interval		Time every sample_interval-th instruction with the CPU timestamp counter,
+ * 					0 only counts. Timing every instruction roughly doubles the cost of cheap ones.
+ * 	@return 			New counters or NULL with errno set, ENOTSUP when timing is asked for on a
+ * 					host without a timestamp counter
+ */
+struct chip8_opstats_t* chip8_opstats_create(uint32_t sample_interval);
+
+/**
+ * 	Release counters. Detach them from chip8 states first.
+ */
+void chip8_opstats_destroy(struct chip8_opstats_t* stats);
+
+/**
+ * 	Zero counts and histograms, keeping the sample interval
+ */
+void chip8_opstats_reset(struct chip8_opstats_t* stats);
+
+/**
+ * 	Record a timed execution, called by the cores
+ */
+void chip8_opstats_sample(struct chip8_opstats_t* stats, enum chip8_op_t op, uint64_t ticks);
+
+/**
+ * 	Write a table of executed operations, most frequent first: count, share, timed samples, mean ticks,
+ * 	median and 99th percentile bucket bounds and the histogram up to the highest bucket used.
+ * 	@return 			0 or errno
+ */
+int chip8_opstats_dump(const struct chip8_opstats_t* stats, FILE* file);
+
+
+#endif
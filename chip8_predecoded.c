@@ -0,0 +1,574 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  chip8_predecoded.c
+ *
+ *    Description:  chip8 interpreter core dispatching through a per-address cache
+ *    				of predecoded instructions
+ *
+ *        Version:  1.0
+ *        Created:  10/17/2026 11:02:14
+ *
+ * =====================================================================================
+ */
+
+#include "chip8.h"
+#include "chip8_core.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+
+////////////////////////////////////////////////////////////////////
+//
+//	Opcode handlers
+//
+//	PC already points to the next instruction when a handler runs
+//
+////////////////////////////////////////////////////////////////////
+
+
+// Predecoded instruction handler
+typedef int (*chip8_handler_t)(struct chip8_t* chip8, const struct chip8_insn_t* insn);
+
+#define CHIP8_HANDLER(__name__) static int __name__(struct chip8_t* chip8, const struct chip8_insn_t* insn)
+
+// Operands are recomputed from the opcode, decode cache slots only keep it and a handler index
+#define INSN_X(__insn__) 	CHIP8_REGX_OPERAND((__insn__)->opcode)
+#define INSN_Y(__insn__) 	CHIP8_REGY_OPERAND((__insn__)->opcode)
+#define INSN_N(__insn__) 	CHIP8_CONST4_OPERAND((__insn__)->opcode)
+#define INSN_NN(__insn__) 	CHIP8_CONST8_OPERAND((__insn__)->opcode)
+#define INSN_NNN(__insn__) 	CHIP8_ADDR_OPERAND((__insn__)->opcode)
+
+// Result of a jump that may close an idle loop, chip8_run looks for one to skip and other callers take it as 0
+#define CHIP8_IDLE_JUMP		(-1)
+
+
+CHIP8_HANDLER(op_0NNN) /* Not used in modern interpreters */
+{
+	return ENOTSUP;
+}
+
+CHIP8_HANDLER(op_00E0) /* clear screen */
+{
+	chip8_clear_screen(chip8);
+	return 0;
+}
+
+CHIP8_HANDLER(op_00EE) /* return */
+{
+	chip8->PC = chip8->call_stack[chip8->SP & CHIP8_STACK_MASK];
+	chip8->SP = (chip8->SP - 1) & CHIP8_STACK_MASK;
+	return 0;
+}
+
+CHIP8_HANDLER(op_1NNN) /* jump to NNN */
+{
+	int rc = CHIP8_IS_IDLE_JUMP(chip8->PC, INSN_NNN(insn)) ? CHIP8_IDLE_JUMP : 0;
+	chip8->PC = INSN_NNN(insn);
+	return rc;
+}
+
+CHIP8_HANDLER(op_2NNN) /* call to NNN */
+{
+	chip8->SP = (chip8->SP + 1) & CHIP8_STACK_MASK;
+	chip8->call_stack[chip8->SP] = chip8->PC;
+	chip8->PC = INSN_NNN(insn);
+	return 0;
+}
+
+CHIP8_HANDLER(op_3XNN) /* skip next insturction if VX == NN */
+{
+	CHIP8_SKIP(chip8, (chip8->V[INSN_X(insn)] == INSN_NN(insn)));
+	return 0;
+}
+
+CHIP8_HANDLER(op_4XNN) /* skip next instruction if VX != NN */
+{
+	CHIP8_SKIP(chip8, (chip8->V[INSN_X(insn)] != INSN_NN(insn)));
+	return 0;
+}
+
+CHIP8_HANDLER(op_5XY0) /* skip next instruction if VX == VY */
+{
+	CHIP8_SKIP(chip8, (chip8->V[INSN_X(insn)] == chip8->V[INSN_Y(insn)]));
+	return 0;
+}
+
+CHIP8_HANDLER(op_9XY0) /* skip next instruction if VX != VY */
+{
+	CHIP8_SKIP(chip8, (chip8->V[INSN_X(insn)] != chip8->V[INSN_Y(insn)]));
+	return 0;
+}
+
+CHIP8_HANDLER(op_6XNN) /* VX = NN */
+{
+	chip8->V[INSN_X(insn)] = INSN_NN(insn);
+	return 0;
+}
+
+CHIP8_HANDLER(op_7XNN) /* VX += NN, carry?? */
+{
+	chip8->V[INSN_X(insn)] += INSN_NN(insn);
+	return 0;
+}
+
+CHIP8_HANDLER(op_8XY0) /* V[X] = V[Y] */
+{
+	chip8->V[INSN_X(insn)] = chip8->V[INSN_Y(insn)];
+	return 0;
+}
+
+CHIP8_HANDLER(op_8XY1) /* V[X] |= V[Y] */
+{
+	chip8->V[INSN_X(insn)] |= chip8->V[INSN_Y(insn)];
+	return 0;
+}
+
+CHIP8_HANDLER(op_8XY2) /* v[x] &= v[y] */
+{
+	chip8->V[INSN_X(insn)] &= chip8->V[INSN_Y(insn)];
+	return 0;
+}
+
+CHIP8_HANDLER(op_8XY3) /* v[x] ^= v[y] */
+{
+	chip8->V[INSN_X(insn)] ^= chip8->V[INSN_Y(insn)];
+	return 0;
+}
+
+CHIP8_HANDLER(op_8XY4) /* v[x] += v[y], carry */
+{
+	chip8->V[CHIP8_VF] = chip8->V[INSN_X(insn)] > (0xFF - (chip8->V[INSN_Y(insn)]));
+	chip8->V[INSN_X(insn)] += chip8->V[INSN_Y(insn)];
+	return 0;
+}
+
+CHIP8_HANDLER(op_8XY5) /* V[X] -= V[Y], borrow */
+{
+	chip8->V[CHIP8_VF] = chip8->V[INSN_X(insn)] >= chip8->V[INSN_Y(insn)];
+	chip8->V[INSN_X(insn)] -= chip8->V[INSN_Y(insn)];
+	return 0;
+}
+
+CHIP8_HANDLER(op_8XY6) /* V[X] >> 1, shifted bit into VF */
+{
+	chip8->V[CHIP8_VF] = chip8->V[INSN_X(insn)] & 0x1;
+	chip8->V[INSN_X(insn)] >>= 1;
+	return 0;
+}
+
+CHIP8_HANDLER(op_8XY7) /* V[X] = V[Y] - V[X], borrow */
+{
+	chip8->V[CHIP8_VF] = chip8->V[INSN_Y(insn)] >= chip8->V[INSN_X(insn)];
+	chip8->V[INSN_X(insn)] = chip8->V[INSN_Y(insn)] - chip8->V[INSN_X(insn)];
+	return 0;
+}
+
+CHIP8_HANDLER(op_8XYE) /* V[X] << 1, shifted bit into VF */
+{
+	chip8->V[CHIP8_VF] = (0 != (chip8->V[INSN_X(insn)] & 0x80));
+	chip8->V[INSN_X(insn)] <<= 1;
+	return 0;
+}
+
+CHIP8_HANDLER(op_ANNN) /* I = NNN */
+{
+	chip8->I = INSN_NNN(insn);
+	return 0;
+}
+
+CHIP8_HANDLER(op_BNNN) /* jmp NNN + V0 */
+{
+	chip8->PC = INSN_NNN(insn) + chip8->V[0];
+	return 0;
+}
+
+CHIP8_HANDLER(op_CXNN) /* V[X] = rand() & NN */
+{
+	chip8->V[INSN_X(insn)] = chip8_xorshift32(&chip8->rng_state) & INSN_NN(insn);
+	return 0;
+}
+
+CHIP8_HANDLER(op_DXYN) /* draw sprite stored at I as 8 by N pixels at screen coords V[X]:V[Y] */
+{
+	chip8_draw_sprite(chip8, chip8->V[INSN_X(insn)], chip8->V[INSN_Y(insn)], INSN_N(insn), chip8->I);
+	return 0;
+}
+
+CHIP8_HANDLER(op_EX9E) /* next if X is pressed */
+{
+	chip8->PC += 2 * CHIP8_IS_KEY_MARKED(chip8->input_state, chip8->V[INSN_X(insn)]);
+	return 0;
+}
+
+CHIP8_HANDLER(op_EXA1) /* next if X is NOT pressed */
+{
+	chip8->PC += 2 * !CHIP8_IS_KEY_MARKED(chip8->input_state, chip8->V[INSN_X(insn)]);
+	return 0;
+}
+
+CHIP8_HANDLER(op_FX07) /* Sets VX to the value of the delay timer. */
+{
+	chip8->V[INSN_X(insn)] = chip8->delay_timer;
+	return 0;
+}
+
+CHIP8_HANDLER(op_FX0A) /* A key press is awaited, and then stored in VX. chip8_set_key_state delivers it. */
+{
+	chip8->key_wait = 1;
+	chip8->key_wait_reg = INSN_X(insn);
+	return 0;
+}
+
+CHIP8_HANDLER(op_FX15) /* Sets the delay timer to VX. */
+{
+	chip8->delay_timer = chip8->V[INSN_X(insn)];
+	return 0;
+}
+
+CHIP8_HANDLER(op_FX18) /* Sets the sound timer to VX. */
+{
+	chip8->sound_timer = chip8->V[INSN_X(insn)];
+	return 0;
+}
+
+CHIP8_HANDLER(op_FX1E) /* Adds VX to I. VF if range overflow */
+{
+	chip8->V[CHIP8_VF] = (chip8->V[INSN_X(insn)] + chip8->I) > 0xFFF;
+	chip8->I += chip8->V[INSN_X(insn)];
+	return 0;
+}
+
+CHIP8_HANDLER(op_FX29) /* Sets I to the location of the sprite for the character in VX. 
+			  Characters 0-F (in hexadecimal) are represented by a 4x5 font. */
+{
+	chip8->I = chip8->V[INSN_X(insn)] * 5;
+	return 0;
+}
+
+CHIP8_HANDLER(op_FX33) /* Stores the Binary-coded decimal representation of VX, 
+			  with the most significant of three digits at the address in I, 
+			  the middle digit at I plus 1, and the least significant digit at I plus 2. */
+{
+	uint8_t value = chip8->V[INSN_X(insn)];
+	CHIP8_MEM_AT(chip8, chip8->I + 2) 	= value % 10; value /= 10;
+	CHIP8_MEM_AT(chip8, chip8->I + 1) 	= value % 10; value /= 10;
+	CHIP8_MEM_AT(chip8, chip8->I) 		= value % 10;
+
+	chip8_invalidate(chip8, chip8->I, 3);
+	return 0;
+}
+
+CHIP8_HANDLER(op_FX55) /* Stores V0 to VX in memory starting at address I. */
+{
+	for (unsigned i = 0; i <= INSN_X(insn); ++i)
+	{
+		CHIP8_MEM_AT(chip8, chip8->I + i) = chip8->V[i];
+	}
+
+	chip8_invalidate(chip8, chip8->I, INSN_X(insn) + 1);
+	return 0;
+}
+
+CHIP8_HANDLER(op_FX65) /* Fills V0 to VX with values from memory starting at address I. */
+{
+	for (unsigned i = 0; i <= INSN_X(insn); ++i)
+	{
+		chip8->V[i] = CHIP8_MEM_AT(chip8, chip8->I + i);
+	}
+	return 0;
+}
+
+CHIP8_HANDLER(op_invalid)
+{
+	return EINVAL;
+}
+
+
+////////////////////////////////////////////////////////////////////
+//
+//	Decoder
+//
+////////////////////////////////////////////////////////////////////
+
+
+// Handler indices kept in decode cache slots, 0 marks a slot that was not decoded yet
+enum
+{
+	INSN_UNDECODED,
+	INSN_0NNN,
+	INSN_00E0,
+	INSN_00EE,
+	INSN_1NNN,
+	INSN_2NNN,
+	INSN_3XNN,
+	INSN_4XNN,
+	INSN_5XY0,
+	INSN_6XNN,
+	INSN_7XNN,
+	INSN_8XY0,
+	INSN_8XY1,
+	INSN_8XY2,
+	INSN_8XY3,
+	INSN_8XY4,
+	INSN_8XY5,
+	INSN_8XY6,
+	INSN_8XY7,
+	INSN_8XYE,
+	INSN_9XY0,
+	INSN_ANNN,
+	INSN_BNNN,
+	INSN_CXNN,
+	INSN_DXYN,
+	INSN_EX9E,
+	INSN_EXA1,
+	INSN_FX07,
+	INSN_FX0A,
+	INSN_FX15,
+	INSN_FX18,
+	INSN_FX1E,
+	INSN_FX29,
+	INSN_FX33,
+	INSN_FX55,
+	INSN_FX65,
+	INSN_INVALID,
+};
+
+static const chip8_handler_t g_handlers[] =
+{
+	[INSN_0NNN] = op_0NNN,
+	[INSN_00E0] = op_00E0,
+	[INSN_00EE] = op_00EE,
+	[INSN_1NNN] = op_1NNN,
+	[INSN_2NNN] = op_2NNN,
+	[INSN_3XNN] = op_3XNN,
+	[INSN_4XNN] = op_4XNN,
+	[INSN_5XY0] = op_5XY0,
+	[INSN_6XNN] = op_6XNN,
+	[INSN_7XNN] = op_7XNN,
+	[INSN_8XY0] = op_8XY0,
+	[INSN_8XY1] = op_8XY1,
+	[INSN_8XY2] = op_8XY2,
+	[INSN_8XY3] = op_8XY3,
+	[INSN_8XY4] = op_8XY4,
+	[INSN_8XY5] = op_8XY5,
+	[INSN_8XY6] = op_8XY6,
+	[INSN_8XY7] = op_8XY7,
+	[INSN_8XYE] = op_8XYE,
+	[INSN_9XY0] = op_9XY0,
+	[INSN_ANNN] = op_ANNN,
+	[INSN_BNNN] = op_BNNN,
+	[INSN_CXNN] = op_CXNN,
+	[INSN_DXYN] = op_DXYN,
+	[INSN_EX9E] = op_EX9E,
+	[INSN_EXA1] = op_EXA1,
+	[INSN_FX07] = op_FX07,
+	[INSN_FX0A] = op_FX0A,
+	[INSN_FX15] = op_FX15,
+	[INSN_FX18] = op_FX18,
+	[INSN_FX1E] = op_FX1E,
+	[INSN_FX29] = op_FX29,
+	[INSN_FX33] = op_FX33,
+	[INSN_FX55] = op_FX55,
+	[INSN_FX65] = op_FX65,
+	[INSN_INVALID] = op_invalid,
+};
+
+static uint8_t decode_handler(uint16_t opcode)
+{
+	switch (opcode & 0xF000)
+	{
+	case 0x0000: /* various */
+		switch (opcode & 0x00FF)
+		{
+		case 0x0000: return INSN_0NNN;
+		case 0x00E0: return INSN_00E0;
+		case 0x00EE: return INSN_00EE;
+		default: return INSN_INVALID;
+		}
+
+	case 0x1000: return INSN_1NNN;
+	case 0x2000: return INSN_2NNN;
+	case 0x3000: return INSN_3XNN;
+	case 0x4000: return INSN_4XNN;
+	case 0x5000: return INSN_5XY0;
+	case 0x6000: return INSN_6XNN;
+	case 0x7000: return INSN_7XNN;
+
+	case 0x8000: /* various */
+		switch (opcode & 0x000F)
+		{
+		case 0x0000: return INSN_8XY0;
+		case 0x0001: return INSN_8XY1;
+		case 0x0002: return INSN_8XY2;
+		case 0x0003: return INSN_8XY3;
+		case 0x0004: return INSN_8XY4;
+		case 0x0005: return INSN_8XY5;
+		case 0x0006: return INSN_8XY6;
+		case 0x0007: return INSN_8XY7;
+		case 0x000E: return INSN_8XYE;
+		default: return INSN_INVALID;
+		}
+
+	case 0x9000: return INSN_9XY0;
+	case 0xA000: return INSN_ANNN;
+	case 0xB000: return INSN_BNNN;
+	case 0xC000: return INSN_CXNN;
+	case 0xD000: return INSN_DXYN;
+
+	case 0xE000: /* various */
+		switch (opcode & 0x00FF)
+		{
+		case 0x009E: return INSN_EX9E;
+		case 0x00A1: return INSN_EXA1;
+		default: return INSN_INVALID;
+		}
+
+	case 0xF000: /* various */
+		switch (opcode & 0x00FF)
+		{
+		case 0x0007: return INSN_FX07;
+		case 0x000A: return INSN_FX0A;
+		case 0x0015: return INSN_FX15;
+		case 0x0018: return INSN_FX18;
+		case 0x001E: return INSN_FX1E;
+		case 0x0029: return INSN_FX29;
+		case 0x0033: return INSN_FX33;
+		case 0x0055: return INSN_FX55;
+		case 0x0065: return INSN_FX65;
+		default: return INSN_INVALID;
+		}
+
+	default:
+		return INSN_INVALID;
+	}
+}
+
+static void decode(struct chip8_insn_t* insn, uint16_t opcode)
+{
+	insn->handler = decode_handler(opcode);
+	insn->opcode = opcode;
+}
+
+int chip8_exec(struct chip8_t* chip8, uint16_t opcode)
+{
+	struct chip8_insn_t insn;
+	decode(&insn, opcode);
+
+	CHIP8_OPSTATS_DECLARE(opstats_start);
+	CHIP8_OPSTATS_BEGIN(chip8, opcode, opstats_start);
+
+	int rc = g_handlers[insn.handler](chip8, &insn);
+
+	CHIP8_OPSTATS_END(chip8, opcode, opstats_start);
+	return rc == CHIP8_IDLE_JUMP ? 0 : rc;
+}
+
+// Find predecoded instruction at PC, decoding it on first use
+static inline const struct chip8_insn_t* fetch_insn(struct chip8_t* chip8, struct chip8_insn_t* uncached)
+{
+	uint16_t pc = chip8->PC;
+
+	if (pc & 1)
+	{
+		// Odd addresses are never cached, their opcodes straddle two slots
+		decode(uncached, CHIP8_OPCODE_AT(chip8, pc));
+		CHIP8_MARK_CODE(chip8, pc);
+		return uncached;
+	}
+
+	struct chip8_insn_t* slot = &chip8->decode_cache[(pc & CHIP8_MEM_MASK) / CHIP8_OPCODE_SIZE];
+	if (slot->handler == INSN_UNDECODED)
+	{
+		decode(slot, CHIP8_OPCODE_AT(chip8, pc));
+		CHIP8_MARK_CODE(chip8, pc);
+	}
+
+	return slot;
+}
+
+int chip8_tick(struct chip8_t* chip8)
+{
+	if (chip8->key_wait)
+	{
+		chip8_idle(chip8, 1);
+		return 0;
+	}
+
+	struct chip8_insn_t uncached;
+	const struct chip8_insn_t* insn = fetch_insn(chip8, &uncached);
+
+	CHIP8_TRACE_INSN(chip8, chip8->PC, insn->opcode);
+	CHIP8_NEXT(chip8);
+
+	CHIP8_OPSTATS_DECLARE(opstats_start);
+	CHIP8_OPSTATS_BEGIN(chip8, insn->opcode, opstats_start);
+
+	int rc = g_handlers[insn->handler](chip8, insn);
+
+	CHIP8_OPSTATS_END(chip8, insn->opcode, opstats_start);
+	
+	if (rc == CHIP8_IDLE_JUMP)
+	{
+		rc = 0;
+	}
+
+	if (rc == 0)
+	{
+		chip8_step_timers(chip8);
+		++chip8->cycles;
+	}
+
+	return rc;
+}
+
+int chip8_run(struct chip8_t* chip8, unsigned long max_cycles, enum chip8_exit_t* exit_reason)
+{
+	struct chip8_insn_t uncached;
+
+	for (unsigned long cycle = 0; cycle < max_cycles; ++cycle)
+	{
+		if (chip8->key_wait)
+		{
+			chip8_idle(chip8, max_cycles - cycle);
+			*exit_reason = CHIP8_EXIT_KEY_WAIT;
+			return 0;
+		}
+
+		const struct chip8_insn_t* insn = fetch_insn(chip8, &uncached);
+
+		CHIP8_TRACE_INSN(chip8, chip8->PC, insn->opcode);
+		CHIP8_NEXT(chip8);
+
+		CHIP8_OPSTATS_DECLARE(opstats_start);
+		CHIP8_OPSTATS_BEGIN(chip8, insn->opcode, opstats_start);
+
+		int rc = g_handlers[insn->handler](chip8, insn);
+
+		CHIP8_OPSTATS_END(chip8, insn->opcode, opstats_start);
+		if (rc)
+		{
+			if (rc != CHIP8_IDLE_JUMP)
+			{
+				*exit_reason = CHIP8_EXIT_ERROR;
+				return rc;
+			}
+
+			cycle += chip8_skip_idle(chip8, max_cycles - cycle - 1);
+		}
+
+		chip8_step_timers(chip8);
+		++chip8->cycles;
+
+		if (chip8->video_update)
+		{
+			*exit_reason = CHIP8_EXIT_FRAME;
+			return 0;
+		}
+	}
+
+	*exit_reason = chip8->key_wait ? CHIP8_EXIT_KEY_WAIT : CHIP8_EXIT_CYCLES;
+	return 0;
+}
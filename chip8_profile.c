@@ -0,0 +1,299 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  chip8_profile.c
+ *
+ *    Description:  sample points, call stack table and profile reports
+ *
+ *        Version:  1.0
+ *        Created:  10/17/2026 21:27:40
+ *
+ * =====================================================================================
+ */
+
+#include "chip8_profile.h"
+#include "chip8_core.h"
+#include "chip8_disasm.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+
+// Distinct call stacks the table starts with, doubled once half full
+#define CHIP8_PROFILE_INITIAL_STACKS	256
+
+// Largest mean sample interval, gaps have to fit 32 bits
+#define CHIP8_PROFILE_MAX_INTERVAL	(1u << 30)
+
+// Listing shows cold instructions up to this many bytes from a sampled one
+#define CHIP8_PROFILE_LISTING_CONTEXT	8
+
+// Frames naming a return address rather than a subroutine
+#define CHIP8_PROFILE_RETURN_FRAME	0x8000
+
+// Samples taken with one chain of subroutines active
+struct chip8_profile_stack_t
+{
+	uint64_t count;				// 0 marks a free slot
+	uint16_t depth;
+	uint16_t frames[CHIP8_STACK_DEPTH];	// Outermost first
+};
+
+struct chip8_profile_t
+{
+	uint32_t interval;		// Mean gap between samples
+	uint32_t seed;			// xorshift state the gaps are drawn from
+	uint32_t countdown;		// Cycles left until the next sample point
+
+	uint64_t samples;
+	uint64_t hits[CHIP8_MEM_SIZE];	// Samples per PC
+
+	struct chip8_profile_stack_t* stacks;	// Open addressed table of distinct stacks
+	size_t stack_capacity;		// Power of two
+	size_t stack_count;
+};
+
+
+static uint32_t next_gap(struct chip8_profile_t* profile)
+{
+	if (profile->interval == 1)
+		return 1;
+
+	profile->seed ^= profile->seed << 13;
+	profile->seed ^= profile->seed >> 17;
+	profile->seed ^= profile->seed << 5;
+	return 1 + profile->seed % (2 * profile->interval - 1);
+}
+
+static size_t hash_stack(const uint16_t* frames, unsigned depth)
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (unsigned i = 0; i < depth; ++i)
+	{
+		hash = (hash ^ frames[i]) * 0x100000001b3ull;
+	}
+
+	return (size_t)(hash ^ depth);
+}
+
+static struct chip8_profile_stack_t* find_stack(struct chip8_profile_stack_t* stacks, size_t capacity,
+	const uint16_t* frames, unsigned depth)
+{
+	size_t slot = hash_stack(frames, depth) & (capacity - 1);
+
+	while (stacks[slot].count &&
+		(stacks[slot].depth != depth || memcmp(stacks[slot].frames, frames, depth * sizeof(frames[0]))))
+	{
+		slot = (slot + 1) & (capacity - 1);
+	}
+
+	return &stacks[slot];
+}
+
+static int grow_stacks(struct chip8_profile_t* profile)
+{
+	size_t capacity = 2 * profile->stack_capacity;
+	struct chip8_profile_stack_t* stacks = calloc(capacity, sizeof(stacks[0]));
+	if (stacks == NULL)
+	{
+		return ENOMEM;
+	}
+
+	for (size_t i = 0; i < profile->stack_capacity; ++i)
+	{
+		const struct chip8_profile_stack_t* stack = &profile->stacks[i];
+		if (stack->count)
+		{
+			*find_stack(stacks, capacity, stack->frames, stack->depth) = *stack;
+		}
+	}
+
+	free(profile->stacks);
+	profile->stacks = stacks;
+	profile->stack_capacity = capacity;
+	return 0;
+}
+
+// Record PC and the subroutines active in chip8
+static int sample(struct chip8_profile_t* profile, const struct chip8_t* chip8)
+{
+	// Halted machines sit on their FX0A
+	uint16_t pc = chip8->key_wait ? chip8->PC - CHIP8_OPCODE_SIZE : chip8->PC;
+	++profile->hits[pc & CHIP8_MEM_MASK];
+	++profile->samples;
+
+	// SP is always within call_stack. After a stray return wrapped it, the slots above are the frames further returns pop.
+	uint16_t frames[CHIP8_STACK_DEPTH];
+	unsigned depth = chip8->SP;
+
+	for (unsigned level = 0; level < depth; ++level)
+	{
+		uint16_t ret = chip8->call_stack[level + 1] & CHIP8_MEM_MASK;
+		uint16_t call = ret >= CHIP8_OPCODE_SIZE ? CHIP8_OPCODE_AT(chip8, ret - CHIP8_OPCODE_SIZE) : 0;
+
+		frames[level] = (call & 0xF000) == 0x2000 ? CHIP8_ADDR_OPERAND(call) : ret | CHIP8_PROFILE_RETURN_FRAME;
+	}
+
+	if (2 * (profile->stack_count + 1) > profile->stack_capacity)
+	{
+		int error = grow_stacks(profile);
+		if (error)
+		{
+			return error;
+		}
+	}
+
+	struct chip8_profile_stack_t* stack = find_stack(profile->stacks, profile->stack_capacity, frames, depth);
+	if (stack->count == 0)
+	{
+		stack->depth = depth;
+		memcpy(stack->frames, frames, depth * sizeof(frames[0]));
+		++profile->stack_count;
+	}
+
+	++stack->count;
+	return 0;
+}
+
+
+struct chip8_profile_t* chip8_profile_create(uint32_t interval)
+{
+	if (interval == 0 || interval > CHIP8_PROFILE_MAX_INTERVAL)
+	{
+		errno = EINVAL;
+		return NULL;
+	}
+
+	struct chip8_profile_t* profile = calloc(1, sizeof(*profile));
+	if (profile == NULL)
+	{
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	profile->stacks = calloc(CHIP8_PROFILE_INITIAL_STACKS, sizeof(profile->stacks[0]));
+	if (profile->stacks == NULL)
+	{
+		free(profile);
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	profile->stack_capacity = CHIP8_PROFILE_INITIAL_STACKS;
+	profile->interval = interval;
+	profile->seed = 0x2545F491;
+	profile->countdown = next_gap(profile);
+	return profile;
+}
+
+void chip8_profile_destroy(struct chip8_profile_t* profile)
+{
+	free(profile->stacks);
+	free(profile);
+}
+
+unsigned long chip8_profile_budget(const struct chip8_profile_t* profile, unsigned long max_cycles)
+{
+	return max_cycles < profile->countdown ? max_cycles : profile->countdown;
+}
+
+int chip8_profile_advance(struct chip8_profile_t* profile, const struct chip8_t* chip8, uint64_t start_cycles)
+{
+	uint64_t cycles = chip8->cycles - start_cycles;
+	if (cycles < profile->countdown)
+	{
+		profile->countdown -= (uint32_t)cycles;
+		return 0;
+	}
+
+	profile->countdown = next_gap(profile);
+	return sample(profile, chip8);
+}
+
+int chip8_profile_run(struct chip8_profile_t* profile, struct chip8_t* chip8, unsigned long max_cycles,
+	enum chip8_exit_t* exit_reason)
+{
+	uint64_t end = chip8->cycles + max_cycles;
+
+	do
+	{
+		uint64_t start = chip8->cycles;
+
+		int error = chip8_run(chip8, chip8_profile_budget(profile, end - start), exit_reason);
+		if (error)
+		{
+			return error;
+		}
+
+		chip8_profile_advance(profile, chip8, start);
+	}
+	while (*exit_reason == CHIP8_EXIT_CYCLES && chip8->cycles < end);
+
+	return 0;
+}
+
+uint64_t chip8_profile_hits(const struct chip8_profile_t* profile, uint16_t addr)
+{
+	return profile->hits[addr & CHIP8_MEM_MASK];
+}
+
+int chip8_profile_save_folded(const struct chip8_profile_t* profile, FILE* file)
+{
+	for (size_t i = 0; i < profile->stack_capacity; ++i)
+	{
+		const struct chip8_profile_stack_t* stack = &profile->stacks[i];
+		if (stack->count == 0)
+			continue;
+
+		fprintf(file, "main");
+		for (unsigned level = 0; level < stack->depth; ++level)
+		{
+			uint16_t frame = stack->frames[level];
+			fprintf(file, frame & CHIP8_PROFILE_RETURN_FRAME ? ";ret_%03X" : ";sub_%03X", frame & ~CHIP8_PROFILE_RETURN_FRAME);
+		}
+
+		fprintf(file, " %llu\n", (unsigned long long)stack->count);
+	}
+
+	return fflush(file) ? errno : 0;
+}
+
+int chip8_profile_save_listing(const struct chip8_profile_t* profile, const struct chip8_t* chip8, FILE* file)
+{
+	fprintf(file, "# %llu samples, one every %u instructions on average\n",
+		(unsigned long long)profile->samples, profile->interval);
+
+	unsigned next = 0;	// Address following the last one listed
+	for (unsigned addr = 0; addr + 1 < CHIP8_MEM_SIZE; ++addr)
+	{
+		// Cold instructions in line with a sampled one nearby
+		int near = 0;
+		unsigned first = addr >= CHIP8_PROFILE_LISTING_CONTEXT ? addr - CHIP8_PROFILE_LISTING_CONTEXT : addr % CHIP8_OPCODE_SIZE;
+		for (unsigned other = first; other <= addr + CHIP8_PROFILE_LISTING_CONTEXT && other < CHIP8_MEM_SIZE; other += CHIP8_OPCODE_SIZE)
+		{
+			near |= profile->hits[other] != 0;
+		}
+
+		if (!near)
+			continue;
+
+		// Blank line between separate runs
+		if (next && addr != next)
+		{
+			fprintf(file, "\n");
+		}
+
+		next = addr + CHIP8_OPCODE_SIZE;
+
+		char text[CHIP8_DISASM_MAX];
+		uint16_t opcode = CHIP8_OPCODE_AT(chip8, addr);
+		chip8_disasm(opcode, text, sizeof(text));
+
+		uint64_t hits = profile->hits[addr];
+		fprintf(file, "%03X  %04X  %-20s %10llu %6.2f%%\n", addr, opcode, text, (unsigned long long)hits,
+			profile->samples ? 100.0 * hits / profile->samples : 0.0);
+	}
+
+	return fflush(file) ? errno : 0;
+}
@@ -0,0 +1,83 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  chip8_profile.h
+ *
+ *    Description:  guest program sampling profiler.
+ *    				Execution budgets are cut at sample points spaced about every interval
+ *    				instructions, where the PC and the subroutines on call_stack are recorded.
+ *    				The cores carry no profiling code, so it works with any of them and costs
+ *    				one extra chip8_run call per sample.
+ *    				Results come out as folded stacks for flamegraph.pl and as a per address
+ *    				heat listing with disassembly.
+ *
+ *        Version:  1.0
+ *        Created:  10/17/2026 21:27:40
+ *
+ * =====================================================================================
+ */
+
+#ifndef CHIP8_PROFILE_H
+#define CHIP8_PROFILE_H
+
+#include "chip8.h"
+
+#include <stdio.h>
+
+
+struct chip8_profile_t;
+
+
+/**
+ * 	Create empty profile.
+ * 	@param interval			Mean instructions between samples. Gaps are drawn from 1 to 2 * interval - 1
+ * 					so loops with a period dividing interval are not sampled at one spot.
+ * 	@return 			New profile or NULL with errno set
+ */
+struct chip8_profile_t* chip8_profile_create(uint32_t interval);
+
+/**
+ * 	Release profile
+ */
+void chip8_profile_destroy(struct chip8_profile_t* profile);
+
+/**
+ * 	Cut an execution budget at the next sample point
+ */
+unsigned long chip8_profile_budget(const struct chip8_profile_t* profile, unsigned long max_cycles);
+
+/**
+ * 	Account cycles executed since chip8->cycles was start_cycles, under a budget from chip8_profile_budget.
+ * 	Samples the machine when they reach the sample point. Cycles halted in FX0A are sampled at the FX0A.
+ * 	@return 			0 or ENOMEM when a new call stack could not be stored, the PC is counted either way
+ */
+int chip8_profile_advance(struct chip8_profile_t* profile, const struct chip8_t* chip8, uint64_t start_cycles);
+
+/**
+ * 	Execute like chip8_run, sampling along the way
+ */
+int chip8_profile_run(struct chip8_profile_t* profile, struct chip8_t* chip8, unsigned long max_cycles,
+	enum chip8_exit_t* exit_reason);
+
+/**
+ * 	Return samples taken at an address
+ */
+uint64_t chip8_profile_hits(const struct chip8_profile_t* profile, uint16_t addr);
+
+/**
+ * 	Write sampled call stacks in the folded format of flamegraph.pl, one "main;sub_2A4;sub_31C count" line
+ * 	per distinct stack. Subroutines are named after the target of the 2NNN their return address follows,
+ * 	return addresses that do not follow a call come out as ret_XXX.
+ * 	@return 			0 or errno
+ */
+int chip8_profile_save_folded(const struct chip8_profile_t* profile, FILE* file);
+
+/**
+ * 	Write sampled addresses with their share of samples and the instruction disassembled from chip8's memory.
+ * 	Cold instructions close to hot ones are listed too, so loops read as code.
+ * 	@return 			0 or errno
+ */
+int chip8_profile_save_listing(const struct chip8_profile_t* profile, const struct chip8_t* chip8, FILE* file);
+
+
+#endif
@@ -0,0 +1,175 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  chip8_record.c
+ *
+ *    Description:  input recording, file format and replay
+ *
+ *        Version:  1.0
+ *        Created:  10/17/2026 20:14:33
+ *
+ * =====================================================================================
+ */
+
+#include "chip8_record.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+
+// Events allocated with a new recording, doubled as needed
+#define CHIP8_RECORD_INITIAL_CAPACITY	256
+
+// Largest recording chip8_record_load will allocate
+#define CHIP8_RECORD_MAX_EVENTS		(1u << 28)
+
+struct chip8_record_t* chip8_record_create(uint32_t seed, uint32_t ips)
+{
+	struct chip8_record_t* record = malloc(sizeof(*record));
+	if (record == NULL)
+	{
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	record->events = malloc(CHIP8_RECORD_INITIAL_CAPACITY * sizeof(record->events[0]));
+	if (record->events == NULL)
+	{
+		free(record);
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	memset(&record->header, 0, sizeof(record->header));
+	record->header.magic = CHIP8_RECORD_MAGIC;
+	record->header.version = CHIP8_RECORD_VERSION;
+	record->header.event_size = sizeof(struct chip8_record_event_t);
+	record->header.seed = seed;
+	record->header.ips = ips;
+	record->capacity = CHIP8_RECORD_INITIAL_CAPACITY;
+	return record;
+}
+
+void chip8_record_destroy(struct chip8_record_t* record)
+{
+	free(record->events);
+	free(record);
+}
+
+int chip8_record_key(struct chip8_record_t* record, struct chip8_t* chip8, unsigned key, int is_pressed)
+{
+	int was_pressed = chip8_get_key_state(chip8, key);
+	chip8_set_key_state(chip8, key, is_pressed);
+
+	if (!was_pressed == !is_pressed)
+		return 0;
+
+	if (record->header.count == record->capacity)
+	{
+		struct chip8_record_event_t* events = realloc(record->events, 2 * record->capacity * sizeof(events[0]));
+		if (events == NULL)
+		{
+			return ENOMEM;
+		}
+
+		record->events = events;
+		record->capacity *= 2;
+	}
+
+	struct chip8_record_event_t* event = &record->events[record->header.count++];
+	memset(event, 0, sizeof(*event));
+	event->cycle = chip8->cycles;
+	event->key = key;
+	event->is_pressed = is_pressed != 0;
+	return 0;
+}
+
+int chip8_record_save(struct chip8_record_t* record, const struct chip8_t* chip8, FILE* file)
+{
+	record->header.cycles = chip8->cycles;
+
+	if (fwrite(&record->header, sizeof(record->header), 1, file) != 1 ||
+		fwrite(record->events, sizeof(record->events[0]), record->header.count, file) != record->header.count)
+	{
+		return EIO;
+	}
+
+	return fflush(file) ? errno : 0;
+}
+
+int chip8_record_load(FILE* file, struct chip8_record_t** record)
+{
+	struct chip8_record_header_t header;
+	if (fread(&header, sizeof(header), 1, file) != 1)
+	{
+		return ferror(file) ? EIO : EPROTO;
+	}
+
+	if (header.magic != CHIP8_RECORD_MAGIC ||
+		header.version != CHIP8_RECORD_VERSION ||
+		header.event_size != sizeof(struct chip8_record_event_t) ||
+		header.count > CHIP8_RECORD_MAX_EVENTS ||
+		header.ips < CHIP8_TIMER_HZ || header.ips > CHIP8_MAX_IPS)
+	{
+		return EPROTO;
+	}
+
+	*record = chip8_record_create(header.seed, header.ips);
+	if (*record == NULL)
+	{
+		return errno;
+	}
+
+	struct chip8_record_event_t* events = realloc((*record)->events, (header.count + 1) * sizeof(events[0]));
+	if (events == NULL)
+	{
+		chip8_record_destroy(*record);
+		*record = NULL;
+		return ENOMEM;
+	}
+
+	(*record)->events = events;
+	(*record)->capacity = header.count + 1;
+	(*record)->header = header;
+
+	if (fread(events, sizeof(events[0]), header.count, file) != header.count)
+	{
+		chip8_record_destroy(*record);
+		*record = NULL;
+		return ferror(file) ? EIO : EPROTO;
+	}
+
+	// Replay walks events in order
+	for (uint64_t i = 0; i < header.count; ++i)
+	{
+		if (events[i].key >= CHIP8_TOTAL_KEYS || events[i].cycle > header.cycles || (i && events[i].cycle < events[i - 1].cycle))
+		{
+			chip8_record_destroy(*record);
+			*record = NULL;
+			return EPROTO;
+		}
+	}
+
+	return 0;
+}
+
+int chip8_record_replay(const struct chip8_record_t* record, size_t* next, struct chip8_t* chip8,
+	unsigned long max_cycles, enum chip8_exit_t* exit_reason)
+{
+	const struct chip8_record_event_t* events = record->events;
+
+	while (*next < record->header.count && events[*next].cycle <= chip8->cycles)
+	{
+		chip8_set_key_state(chip8, events[*next].key, events[*next].is_pressed);
+		++*next;
+	}
+
+	// Stop at the next edge so it lands on its cycle
+	if (*next < record->header.count && events[*next].cycle - chip8->cycles < max_cycles)
+	{
+		max_cycles = events[*next].cycle - chip8->cycles;
+	}
+
+	return chip8_run(chip8, max_cycles, exit_reason);
+}
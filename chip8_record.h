@@ -0,0 +1,99 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  chip8_record.h
+ *
+ *    Description:  input recordings.
+ *    				Key edges are logged with the cycle they reached the machine at, together with
+ *    				the instruction rate and the seed CXNN draws from, so a session replays exactly.
+ *
+ *        Version:  1.0
+ *        Created:  10/17/2026 20:14:33
+ *
+ * =====================================================================================
+ */
+
+#ifndef CHIP8_RECORD_H
+#define CHIP8_RECORD_H
+
+#include "chip8.h"
+
+#include <stdio.h>
+#include <stddef.h>
+
+
+// Recording file header magic and format version
+#define CHIP8_RECORD_MAGIC	0x52493843 // "C8IR" read as little endian
+#define CHIP8_RECORD_VERSION	2
+
+// One key edge
+struct chip8_record_event_t
+{
+	uint64_t cycle;		// Value of chip8->cycles when the edge was delivered
+	uint8_t key;		// Input key index
+	uint8_t is_pressed;	// New key state
+	uint8_t reserved[6];
+};
+
+// Recording file header, followed by count events in cycle order. All fields are in host byte order.
+struct chip8_record_header_t
+{
+	uint32_t magic;		// CHIP8_RECORD_MAGIC
+	uint16_t version;	// CHIP8_RECORD_VERSION
+	uint16_t event_size;	// sizeof(struct chip8_record_event_t)
+	uint32_t seed;		// Passed to chip8_set_seed before the session started
+	uint32_t ips;		// chip8->ips of the session
+	uint64_t cycles;	// Length of the session
+	uint64_t count;		// Number of events
+};
+
+struct chip8_record_t
+{
+	struct chip8_record_header_t header;
+	size_t capacity;	// Events allocated
+	struct chip8_record_event_t* events;
+};
+
+
+/**
+ * 	Start an empty recording of a session beginning at cycle 0.
+ * 	@param seed			Seed the host passed to chip8_set_seed
+ * 	@param ips			Instruction rate of the session
+ * 	@return 			New recording or NULL with errno set
+ */
+struct chip8_record_t* chip8_record_create(uint32_t seed, uint32_t ips);
+
+/**
+ * 	Release recording
+ */
+void chip8_record_destroy(struct chip8_record_t* record);
+
+/**
+ * 	Set key state through chip8_set_key_state and log it if the state changed
+ * 	@return 			0 or ENOMEM, the key state is set either way
+ */
+int chip8_record_key(struct chip8_record_t* record, struct chip8_t* chip8, unsigned key, int is_pressed);
+
+/**
+ * 	Write recording to a file, the session ends at chip8->cycles
+ * 	@return 			0 or errno
+ */
+int chip8_record_save(struct chip8_record_t* record, const struct chip8_t* chip8, FILE* file);
+
+/**
+ * 	Read recording written by chip8_record_save
+ * 	@param record			Receives the recording, release it with chip8_record_destroy
+ * 	@return 			0, errno or EPROTO for malformed files
+ */
+int chip8_record_load(FILE* file, struct chip8_record_t** record);
+
+/**
+ * 	Execute like chip8_run, delivering recorded key edges once their cycle is reached.
+ * 	Budgets are cut at the next edge, run until chip8->cycles reaches header.cycles to replay the whole session.
+ * 	@param next			Index of the next event to deliver, 0 when starting a replay
+ */
+int chip8_record_replay(const struct chip8_record_t* record, size_t* next, struct chip8_t* chip8,
+	unsigned long max_cycles, enum chip8_exit_t* exit_reason);
+
+
+#endif
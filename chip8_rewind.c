@@ -0,0 +1,266 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  chip8_rewind.c
+ *
+ *    Description:  rewind history ring and frame delta encoding
+ *
+ *        Version:  1.0
+ *        Created:  10/17/2026 19:37:48
+ *
+ * =====================================================================================
+ */
+
+#include "chip8_rewind.h"
+#include "chip8_snapshot.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+
+// Frames are compared as snapshot words, the first one holds the snapshot id
+typedef uint64_t chip8_rewind_word_t __attribute__((__may_alias__));
+
+#define CHIP8_REWIND_WORDS	(sizeof(struct chip8_snapshot_t) / sizeof(uint64_t))
+#define CHIP8_REWIND_FIRST_WORD	1
+
+// Largest encoded delta: every word literal behind two run lengths
+#define CHIP8_REWIND_MAX_DELTA	(CHIP8_REWIND_WORDS * sizeof(uint64_t) + 16)
+
+// Deltas are stored between two copies of their size, so the ring can be walked from both ends
+#define CHIP8_REWIND_ENTRY_OVERHEAD	(2 * sizeof(uint32_t))
+
+struct chip8_rewind_t
+{
+	uint8_t* ring;			// Deltas, oldest at tail
+	size_t capacity;		// Bytes in ring
+	size_t head;			// Offset the next delta is written at
+	size_t tail;			// Offset of the oldest delta
+	size_t used;			// Bytes taken by deltas
+	unsigned frames;		// Deltas in ring
+
+	int recorded;			// newest holds a frame
+	struct chip8_snapshot_t frame[2];	// Newest frame and scratch for the next one
+	unsigned newest;		// Index of the newest frame
+
+	uint8_t delta[CHIP8_REWIND_MAX_DELTA];
+};
+
+
+static uint8_t* put_length(uint8_t* out, size_t length)
+{
+	while (length >= 0x80)
+	{
+		*out++ = (uint8_t)length | 0x80;
+		length >>= 7;
+	}
+
+	*out++ = (uint8_t)length;
+	return out;
+}
+
+static const uint8_t* get_length(const uint8_t* in, size_t* length)
+{
+	*length = 0;
+	for (unsigned shift = 0; ; shift += 7)
+	{
+		*length |= (size_t)(*in & 0x7F) << shift;
+		if (!(*in++ & 0x80))
+			return in;
+	}
+}
+
+// Encode older ^ newer as runs of zero words, each followed by a run of literal words
+static size_t encode(uint8_t* out, const chip8_rewind_word_t* older, const chip8_rewind_word_t* newer)
+{
+	uint8_t* start = out;
+
+	for (size_t word = CHIP8_REWIND_FIRST_WORD; word < CHIP8_REWIND_WORDS; )
+	{
+		size_t zeros = word;
+		while (zeros < CHIP8_REWIND_WORDS && older[zeros] == newer[zeros])
+			++zeros;
+
+		size_t literals = zeros;
+		while (literals < CHIP8_REWIND_WORDS && older[literals] != newer[literals])
+			++literals;
+
+		if (literals == zeros)
+			break;
+
+		out = put_length(out, zeros - word);
+		out = put_length(out, literals - zeros);
+
+		for (size_t i = zeros; i < literals; ++i)
+		{
+			uint64_t diff = older[i] ^ newer[i];
+			memcpy(out, &diff, sizeof(diff));
+			out += sizeof(diff);
+		}
+
+		word = literals;
+	}
+
+	return out - start;
+}
+
+// XOR delta back into frame words
+static void decode(chip8_rewind_word_t* frame, const uint8_t* in, size_t size)
+{
+	const uint8_t* end = in + size;
+	size_t word = CHIP8_REWIND_FIRST_WORD;
+
+	while (in < end)
+	{
+		size_t zeros, literals;
+		in = get_length(in, &zeros);
+		in = get_length(in, &literals);
+		word += zeros;
+
+		for (size_t i = 0; i < literals; ++i, ++word)
+		{
+			uint64_t diff;
+			memcpy(&diff, in, sizeof(diff));
+			frame[word] ^= diff;
+			in += sizeof(diff);
+		}
+	}
+}
+
+static void ring_write(struct chip8_rewind_t* rewind, size_t offset, const void* data, size_t size)
+{
+	size_t first = rewind->capacity - offset < size ? rewind->capacity - offset : size;
+	memcpy(rewind->ring + offset, data, first);
+	memcpy(rewind->ring, (const uint8_t*)data + first, size - first);
+}
+
+static void ring_read(const struct chip8_rewind_t* rewind, size_t offset, void* data, size_t size)
+{
+	size_t first = rewind->capacity - offset < size ? rewind->capacity - offset : size;
+	memcpy(data, rewind->ring + offset, first);
+	memcpy((uint8_t*)data + first, rewind->ring, size - first);
+}
+
+// Offset moved forward or back by size bytes around the ring
+static size_t ring_advance(const struct chip8_rewind_t* rewind, size_t offset, size_t size)
+{
+	return (offset + size) % rewind->capacity;
+}
+
+static size_t ring_retreat(const struct chip8_rewind_t* rewind, size_t offset, size_t size)
+{
+	return (offset + rewind->capacity - size) % rewind->capacity;
+}
+
+static void drop_oldest(struct chip8_rewind_t* rewind)
+{
+	uint32_t size;
+	ring_read(rewind, rewind->tail, &size, sizeof(size));
+
+	rewind->tail = ring_advance(rewind, rewind->tail, size + CHIP8_REWIND_ENTRY_OVERHEAD);
+	rewind->used -= size + CHIP8_REWIND_ENTRY_OVERHEAD;
+	--rewind->frames;
+}
+
+
+struct chip8_rewind_t* chip8_rewind_create(size_t budget)
+{
+	if (budget == 0)
+	{
+		errno = EINVAL;
+		return NULL;
+	}
+
+	// Padding of the frames is compared too, keep it zero
+	struct chip8_rewind_t* rewind = calloc(1, sizeof(*rewind));
+	if (rewind == NULL)
+	{
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	rewind->ring = malloc(budget);
+	if (rewind->ring == NULL)
+	{
+		free(rewind);
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	rewind->capacity = budget;
+	return rewind;
+}
+
+void chip8_rewind_destroy(struct chip8_rewind_t* rewind)
+{
+	free(rewind->ring);
+	free(rewind);
+}
+
+void chip8_rewind_push(struct chip8_rewind_t* rewind, const struct chip8_t* chip8)
+{
+	struct chip8_snapshot_t* older = &rewind->frame[rewind->newest];
+	struct chip8_snapshot_t* newer = &rewind->frame[rewind->newest ^ 1];
+
+	chip8_snapshot_take(newer, chip8);
+	rewind->newest ^= 1;
+
+	if (!rewind->recorded)
+	{
+		rewind->recorded = 1;
+		return;
+	}
+
+	uint32_t size = encode(rewind->delta, (const chip8_rewind_word_t*)older, (const chip8_rewind_word_t*)newer);
+	size_t entry = size + CHIP8_REWIND_ENTRY_OVERHEAD;
+
+	// History restarts from this frame when a single delta does not fit
+	if (entry > rewind->capacity)
+	{
+		rewind->head = rewind->tail = rewind->used = 0;
+		rewind->frames = 0;
+		return;
+	}
+
+	while (rewind->used + entry > rewind->capacity)
+	{
+		drop_oldest(rewind);
+	}
+
+	ring_write(rewind, rewind->head, &size, sizeof(size));
+	ring_write(rewind, ring_advance(rewind, rewind->head, sizeof(size)), rewind->delta, size);
+	ring_write(rewind, ring_advance(rewind, rewind->head, sizeof(size) + size), &size, sizeof(size));
+
+	rewind->head = ring_advance(rewind, rewind->head, entry);
+	rewind->used += entry;
+	++rewind->frames;
+}
+
+int chip8_rewind_step_back(struct chip8_rewind_t* rewind, struct chip8_t* chip8)
+{
+	if (rewind->frames == 0)
+	{
+		return ENOENT;
+	}
+
+	uint32_t size;
+	ring_read(rewind, ring_retreat(rewind, rewind->head, sizeof(size)), &size, sizeof(size));
+
+	size_t entry = size + CHIP8_REWIND_ENTRY_OVERHEAD;
+	rewind->head = ring_retreat(rewind, rewind->head, entry);
+	rewind->used -= entry;
+	--rewind->frames;
+
+	ring_read(rewind, ring_advance(rewind, rewind->head, sizeof(size)), rewind->delta, size);
+
+	struct chip8_snapshot_t* frame = &rewind->frame[rewind->newest];
+	decode((chip8_rewind_word_t*)frame, rewind->delta, size);
+	chip8_snapshot_restore(chip8, frame);
+	return 0;
+}
+
+unsigned chip8_rewind_frames(const struct chip8_rewind_t* rewind)
+{
+	return rewind->frames;
+}
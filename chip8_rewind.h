@@ -0,0 +1,59 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  chip8_rewind.h
+ *
+ *    Description:  rewind history.
+ *    				Frames are kept in a ring of fixed byte size as deltas against the frame after
+ *    				them: the snapshot words that changed, XORed and zero run length encoded.
+ *    				Only the newest frame is kept whole, stepping back undoes one delta at a time
+ *    				and the oldest deltas are dropped once the ring is full.
+ *
+ *        Version:  1.0
+ *        Created:  10/17/2026 19:37:48
+ *
+ * =====================================================================================
+ */
+
+#ifndef CHIP8_REWIND_H
+#define CHIP8_REWIND_H
+
+#include "chip8.h"
+
+#include <stddef.h>
+
+
+struct chip8_rewind_t;
+
+
+/**
+ * 	Create empty history.
+ * 	@param budget			Bytes of delta storage, a few MiB hold minutes of typical games at 60 frames per second
+ * 	@return 			New history or NULL with errno set
+ */
+struct chip8_rewind_t* chip8_rewind_create(size_t budget);
+
+/**
+ * 	Release history
+ */
+void chip8_rewind_destroy(struct chip8_rewind_t* rewind);
+
+/**
+ * 	Record machine state as the newest frame
+ */
+void chip8_rewind_push(struct chip8_rewind_t* rewind, const struct chip8_t* chip8);
+
+/**
+ * 	Drop the newest frame and return machine to the one recorded before it.
+ * 	Restores all of memory and drops predecoded instructions, see chip8_snapshot_restore.
+ * 	@return 			0 or ENOENT when no older frame is left
+ */
+int chip8_rewind_step_back(struct chip8_rewind_t* rewind, struct chip8_t* chip8);
+
+/**
+ * 	Return number of frames that can be stepped back to
+ */
+unsigned chip8_rewind_frames(const struct chip8_rewind_t* rewind);
+
+
+#endif
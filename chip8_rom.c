@@ -0,0 +1,263 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  chip8_rom.c
+ *
+ *    Description:  ROM file mapping and the path and content tables of the ROM cache
+ *
+ *        Version:  1.0
+ *        Created:  10/17/2026 22:03:15
+ *
+ * =====================================================================================
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include "chip8_rom.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+// Chains of both tables, paths and images are few per host
+#define CHIP8_ROM_BUCKETS	256
+
+// Mapped file, shared by every path with the same content
+struct chip8_rom_image_t
+{
+	struct chip8_rom_t rom;
+	struct chip8_rom_image_t* next;		// Chain of images with the same hash bucket
+};
+
+struct chip8_rom_path_t
+{
+	const struct chip8_rom_image_t* image;
+	struct chip8_rom_path_t* next;		// Chain of paths with the same hash bucket
+	char path[];
+};
+
+struct chip8_rom_cache_t
+{
+	int lock;				// Spin lock held while tables are read or changed, never across file I/O
+	unsigned image_count;
+	struct chip8_rom_path_t* paths[CHIP8_ROM_BUCKETS];
+	struct chip8_rom_image_t* images[CHIP8_ROM_BUCKETS];
+};
+
+
+static uint64_t fnv1a(const void* data, size_t size)
+{
+	const uint8_t* bytes = data;
+	uint64_t hash = 0xcbf29ce484222325ull;
+
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+	}
+
+	return hash;
+}
+
+static void lock(struct chip8_rom_cache_t* cache)
+{
+	while (__atomic_test_and_set(&cache->lock, __ATOMIC_ACQUIRE))
+		;
+}
+
+static void unlock(struct chip8_rom_cache_t* cache)
+{
+	__atomic_clear(&cache->lock, __ATOMIC_RELEASE);
+}
+
+static struct chip8_rom_path_t* find_path(const struct chip8_rom_cache_t* cache, const char* path, unsigned bucket)
+{
+	struct chip8_rom_path_t* entry = cache->paths[bucket];
+	while (entry && strcmp(entry->path, path))
+	{
+		entry = entry->next;
+	}
+
+	return entry;
+}
+
+// Map a file read only, empty files take no mapping
+static int map_file(const char* path, struct chip8_rom_t* rom)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+	{
+		return errno;
+	}
+
+	struct stat st;
+	int error = fstat(fd, &st) ? errno : st.st_size > CHIP8_RAM_SIZE ? ENOSPC : 0;
+
+	rom->data = NULL;
+	rom->size = error ? 0 : (size_t)st.st_size;
+
+	if (error == 0 && rom->size)
+	{
+		void* data = mmap(NULL, rom->size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data == MAP_FAILED)
+		{
+			error = errno;
+		}
+		else
+		{
+			rom->data = data;
+		}
+	}
+
+	close(fd);
+	rom->hash = rom->data ? fnv1a(rom->data, rom->size) : fnv1a(NULL, 0);
+	return error;
+}
+
+static void unmap(const struct chip8_rom_t* rom)
+{
+	if (rom->data)
+	{
+		munmap((void*)rom->data, rom->size);
+	}
+}
+
+// Image with the content of rom, taking over its mapping when there is none yet
+static struct chip8_rom_image_t* intern(struct chip8_rom_cache_t* cache, const struct chip8_rom_t* rom)
+{
+	unsigned bucket = rom->hash % CHIP8_ROM_BUCKETS;
+
+	for (struct chip8_rom_image_t* image = cache->images[bucket]; image; image = image->next)
+	{
+		if (image->rom.hash == rom->hash && image->rom.size == rom->size &&
+			(rom->size == 0 || memcmp(image->rom.data, rom->data, rom->size) == 0))
+		{
+			unmap(rom);
+			return image;
+		}
+	}
+
+	struct chip8_rom_image_t* image = malloc(sizeof(*image));
+	if (image == NULL)
+	{
+		return NULL;
+	}
+
+	image->rom = *rom;
+	image->next = cache->images[bucket];
+	cache->images[bucket] = image;
+	++cache->image_count;
+	return image;
+}
+
+
+struct chip8_rom_cache_t* chip8_rom_cache_create(void)
+{
+	struct chip8_rom_cache_t* cache = calloc(1, sizeof(*cache));
+	if (cache == NULL)
+	{
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	return cache;
+}
+
+void chip8_rom_cache_destroy(struct chip8_rom_cache_t* cache)
+{
+	for (unsigned bucket = 0; bucket < CHIP8_ROM_BUCKETS; ++bucket)
+	{
+		for (struct chip8_rom_path_t* entry = cache->paths[bucket]; entry; )
+		{
+			struct chip8_rom_path_t* next = entry->next;
+			free(entry);
+			entry = next;
+		}
+
+		for (struct chip8_rom_image_t* image = cache->images[bucket]; image; )
+		{
+			struct chip8_rom_image_t* next = image->next;
+			unmap(&image->rom);
+			free(image);
+			image = next;
+		}
+	}
+
+	free(cache);
+}
+
+int chip8_rom_cache_load(struct chip8_rom_cache_t* cache, const char* path, const struct chip8_rom_t** rom)
+{
+	unsigned bucket = fnv1a(path, strlen(path)) % CHIP8_ROM_BUCKETS;
+
+	lock(cache);
+
+	struct chip8_rom_path_t* entry = find_path(cache, path, bucket);
+	if (entry)
+	{
+		*rom = &entry->image->rom;
+		unlock(cache);
+		return 0;
+	}
+
+	// Mapping and hashing wait on the disk, other loads go on meanwhile
+	unlock(cache);
+
+	struct chip8_rom_t mapped;
+	int error = map_file(path, &mapped);
+	if (error)
+	{
+		return error;
+	}
+
+	lock(cache);
+
+	// Another load may have added the path in the meantime
+	entry = find_path(cache, path, bucket);
+	if (entry)
+	{
+		unmap(&mapped);
+		*rom = &entry->image->rom;
+		unlock(cache);
+		return 0;
+	}
+
+	entry = malloc(sizeof(*entry) + strlen(path) + 1);
+	const struct chip8_rom_image_t* image = entry ? intern(cache, &mapped) : NULL;
+	if (image == NULL)
+	{
+		free(entry);
+		unmap(&mapped);
+		unlock(cache);
+		return ENOMEM;
+	}
+
+	strcpy(entry->path, path);
+	entry->image = image;
+	entry->next = cache->paths[bucket];
+	cache->paths[bucket] = entry;
+
+	*rom = &image->rom;
+	unlock(cache);
+	return 0;
+}
+
+unsigned chip8_rom_cache_images(const struct chip8_rom_cache_t* cache)
+{
+	return cache->image_count;
+}
+
+int chip8_init_rom(struct chip8_t* chip8, const struct chip8_rom_t* rom)
+{
+	int error = chip8_init(chip8);
+	if (error)
+	{
+		return error;
+	}
+
+	return chip8_load_image(chip8, rom->data, rom->size);
+}
@@ -0,0 +1,67 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  chip8_rom.h
+ *
+ *    Description:  shared read only ROM cache.
+ *    				Each file is mapped once and kept under its path, so loading it again makes
+ *    				no system calls. Files with the same content share one mapping, found by
+ *    				content hash. Instances started from a cached image copy it into their own
+ *    				memory, which leaves the mapping read only.
+ *
+ *        Version:  1.0
+ *        Created:  10/17/2026 22:03:15
+ *
+ * =====================================================================================
+ */
+
+#ifndef CHIP8_ROM_H
+#define CHIP8_ROM_H
+
+#include "chip8.h"
+
+#include <stddef.h>
+
+
+// Cached image, valid until the cache is destroyed
+struct chip8_rom_t
+{
+	const uint8_t* data;	// Image loaded at CHIP8_INIT_PC, NULL when empty
+	size_t size;		// At most CHIP8_RAM_SIZE
+	uint64_t hash;		// FNV-1a of data
+};
+
+struct chip8_rom_cache_t;
+
+
+/**
+ * 	Create empty cache. Loads may come from several threads at once.
+ * 	@return 			New cache or NULL with errno set
+ */
+struct chip8_rom_cache_t* chip8_rom_cache_create(void);
+
+/**
+ * 	Unmap every image. Instances started from them keep running on their own copies.
+ */
+void chip8_rom_cache_destroy(struct chip8_rom_cache_t* cache);
+
+/**
+ * 	Find an image by path, mapping the file on the first load of the path.
+ * 	Files are not checked again once cached, changes to them show up only in a new cache.
+ * 	@param rom			Receives the cached image
+ * 	@return 			0, errno or ENOSPC when the file does not fit in CHIP8_RAM_SIZE
+ */
+int chip8_rom_cache_load(struct chip8_rom_cache_t* cache, const char* path, const struct chip8_rom_t** rom);
+
+/**
+ * 	Return number of distinct images mapped, files with equal content count once
+ */
+unsigned chip8_rom_cache_images(const struct chip8_rom_cache_t* cache);
+
+/**
+ * 	Init chip8 state and load a cached image, see chip8_init and chip8_load_image
+ */
+int chip8_init_rom(struct chip8_t* chip8, const struct chip8_rom_t* rom);
+
+
+#endif
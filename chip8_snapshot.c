@@ -0,0 +1,241 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  chip8_snapshot.c
+ *
+ *    Description:  save state capture, restore and file format
+ *
+ *        Version:  1.0
+ *        Created:  10/17/2026 18:52:10
+ *
+ * =====================================================================================
+ */
+
+#include "chip8_snapshot.h"
+
+#include <string.h>
+#include <errno.h>
+
+
+// File payload: registers, timers, stack, video rows and memory, every field little endian
+#define CHIP8_SNAPSHOT_PAYLOAD_SIZE	(16 + 6 * sizeof(uint16_t) + 2 + sizeof(uint64_t) + 3 * sizeof(uint32_t) + \
+					CHIP8_STACK_DEPTH * sizeof(uint16_t) + CHIP8_VIDEO_HEIGHT * sizeof(uint64_t) + CHIP8_MEM_SIZE)
+
+// magic, version and payload size
+#define CHIP8_SNAPSHOT_HEADER_SIZE	(sizeof(uint32_t) + 2 * sizeof(uint16_t))
+
+// Last capture id handed out, 0 is never used
+static uint64_t g_snapshot_id;
+
+
+static void put(uint8_t** cursor, uint64_t value, unsigned size)
+{
+	for (unsigned i = 0; i < size; ++i)
+	{
+		*(*cursor)++ = (uint8_t)(value >> (i * 8));
+	}
+}
+
+static uint64_t get(const uint8_t** cursor, unsigned size)
+{
+	uint64_t value = 0;
+	for (unsigned i = 0; i < size; ++i)
+	{
+		value |= (uint64_t)*(*cursor)++ << (i * 8);
+	}
+
+	return value;
+}
+
+void chip8_snapshot_take(struct chip8_snapshot_t* snapshot, const struct chip8_t* chip8)
+{
+	snapshot->id = 0;
+	memcpy(snapshot->V, chip8->V, sizeof(snapshot->V));
+	snapshot->I = chip8->I;
+	snapshot->PC = chip8->PC;
+	snapshot->SP = chip8->SP;
+	snapshot->delay_timer = chip8->delay_timer;
+	snapshot->sound_timer = chip8->sound_timer;
+	snapshot->input_state = chip8->input_state;
+	snapshot->key_wait = chip8->key_wait;
+	snapshot->key_wait_reg = chip8->key_wait_reg;
+	snapshot->cycles = chip8->cycles;
+	snapshot->ips = chip8->ips;
+	snapshot->timer_phase = chip8->timer_phase;
+	snapshot->rng_state = chip8->rng_state;
+
+	memcpy(snapshot->call_stack, chip8->call_stack, sizeof(snapshot->call_stack));
+	memcpy(snapshot->video_mem, chip8->video_mem, sizeof(snapshot->video_mem));
+	memcpy(snapshot->mem, chip8->mem, sizeof(snapshot->mem));
+}
+
+// Copy registers, differing video rows and the given memory pages back into chip8
+static void apply(struct chip8_t* chip8, const struct chip8_snapshot_t* snapshot, uint64_t pages)
+{
+	while (pages)
+	{
+		unsigned addr = __builtin_ctzll(pages) << CHIP8_MEM_PAGE_SHIFT;
+		pages &= pages - 1;
+
+		memcpy(chip8->mem + addr, snapshot->mem + addr, CHIP8_MEM_PAGE_SIZE);
+		chip8_invalidate(chip8, addr, CHIP8_MEM_PAGE_SIZE);
+	}
+
+	memcpy(chip8->V, snapshot->V, sizeof(chip8->V));
+	chip8->I = snapshot->I;
+	chip8->PC = snapshot->PC;
+	chip8->SP = snapshot->SP;
+	chip8->delay_timer = snapshot->delay_timer;
+	chip8->sound_timer = snapshot->sound_timer;
+	chip8->input_state = snapshot->input_state;
+	chip8->key_wait = snapshot->key_wait;
+	chip8->key_wait_reg = snapshot->key_wait_reg;
+	chip8->cycles = snapshot->cycles;
+	chip8->ips = snapshot->ips;
+	chip8->timer_phase = snapshot->timer_phase;
+	chip8->rng_state = snapshot->rng_state;
+
+	memcpy(chip8->call_stack, snapshot->call_stack, sizeof(chip8->call_stack));
+
+	uint32_t rows = 0;
+	for (unsigned y = 0; y < CHIP8_VIDEO_HEIGHT; ++y)
+	{
+		if (chip8->video_mem[y] != snapshot->video_mem[y])
+		{
+			chip8->video_mem[y] = snapshot->video_mem[y];
+			rows |= 1u << y;
+		}
+	}
+
+	if (rows)
+	{
+		chip8->video_dirty_rows |= rows;
+		chip8->video_update = 1;
+	}
+}
+
+void chip8_snapshot_capture(struct chip8_snapshot_t* snapshot, struct chip8_t* chip8)
+{
+	chip8_snapshot_take(snapshot, chip8);
+	snapshot->id = __atomic_add_fetch(&g_snapshot_id, 1, __ATOMIC_RELAXED);
+
+	chip8->snapshot_id = snapshot->id;
+	chip8->mem_dirty_pages = 0;
+}
+
+void chip8_snapshot_restore(struct chip8_t* chip8, const struct chip8_snapshot_t* snapshot)
+{
+	uint64_t pages = snapshot->id != 0 && chip8->snapshot_id == snapshot->id ? chip8->mem_dirty_pages : ~0ull;
+	apply(chip8, snapshot, pages);
+
+	chip8->snapshot_id = snapshot->id;
+	chip8->mem_dirty_pages = 0;
+}
+
+int chip8_snapshot_save(const struct chip8_t* chip8, FILE* file)
+{
+	struct chip8_snapshot_t snapshot;
+	chip8_snapshot_take(&snapshot, chip8);
+
+	uint8_t buffer[CHIP8_SNAPSHOT_HEADER_SIZE + CHIP8_SNAPSHOT_PAYLOAD_SIZE];
+	uint8_t* cursor = buffer;
+
+	put(&cursor, CHIP8_SNAPSHOT_MAGIC, sizeof(uint32_t));
+	put(&cursor, CHIP8_SNAPSHOT_VERSION, sizeof(uint16_t));
+	put(&cursor, CHIP8_SNAPSHOT_PAYLOAD_SIZE, sizeof(uint16_t));
+
+	memcpy(cursor, snapshot.V, sizeof(snapshot.V));
+	cursor += sizeof(snapshot.V);
+	put(&cursor, snapshot.I, sizeof(uint16_t));
+	put(&cursor, snapshot.PC, sizeof(uint16_t));
+	put(&cursor, snapshot.SP, sizeof(uint16_t));
+	put(&cursor, snapshot.delay_timer, sizeof(uint16_t));
+	put(&cursor, snapshot.sound_timer, sizeof(uint16_t));
+	put(&cursor, snapshot.input_state, sizeof(uint16_t));
+	put(&cursor, snapshot.key_wait, 1);
+	put(&cursor, snapshot.key_wait_reg, 1);
+	put(&cursor, snapshot.cycles, sizeof(uint64_t));
+	put(&cursor, snapshot.ips, sizeof(uint32_t));
+	put(&cursor, snapshot.timer_phase, sizeof(uint32_t));
+	put(&cursor, snapshot.rng_state, sizeof(uint32_t));
+
+	for (unsigned i = 0; i < CHIP8_STACK_DEPTH; ++i)
+	{
+		put(&cursor, snapshot.call_stack[i], sizeof(uint16_t));
+	}
+
+	for (unsigned y = 0; y < CHIP8_VIDEO_HEIGHT; ++y)
+	{
+		put(&cursor, snapshot.video_mem[y], sizeof(uint64_t));
+	}
+
+	memcpy(cursor, snapshot.mem, sizeof(snapshot.mem));
+
+	if (fwrite(buffer, sizeof(buffer), 1, file) != 1)
+	{
+		return EIO;
+	}
+
+	return fflush(file) ? errno : 0;
+}
+
+int chip8_snapshot_load(struct chip8_t* chip8, FILE* file)
+{
+	uint8_t buffer[CHIP8_SNAPSHOT_HEADER_SIZE + CHIP8_SNAPSHOT_PAYLOAD_SIZE];
+	if (fread(buffer, sizeof(buffer), 1, file) != 1)
+	{
+		return ferror(file) ? EIO : EPROTO;
+	}
+
+	const uint8_t* cursor = buffer;
+	if (get(&cursor, sizeof(uint32_t)) != CHIP8_SNAPSHOT_MAGIC ||
+		get(&cursor, sizeof(uint16_t)) != CHIP8_SNAPSHOT_VERSION ||
+		get(&cursor, sizeof(uint16_t)) != CHIP8_SNAPSHOT_PAYLOAD_SIZE)
+	{
+		return EPROTO;
+	}
+
+	struct chip8_snapshot_t snapshot;
+
+	memcpy(snapshot.V, cursor, sizeof(snapshot.V));
+	cursor += sizeof(snapshot.V);
+	snapshot.I = get(&cursor, sizeof(uint16_t));
+	snapshot.PC = get(&cursor, sizeof(uint16_t));
+	snapshot.SP = get(&cursor, sizeof(uint16_t));
+	snapshot.delay_timer = get(&cursor, sizeof(uint16_t));
+	snapshot.sound_timer = get(&cursor, sizeof(uint16_t));
+	snapshot.input_state = get(&cursor, sizeof(uint16_t));
+	snapshot.key_wait = get(&cursor, 1);
+	snapshot.key_wait_reg = get(&cursor, 1);
+	snapshot.cycles = get(&cursor, sizeof(uint64_t));
+	snapshot.ips = get(&cursor, sizeof(uint32_t));
+	snapshot.timer_phase = get(&cursor, sizeof(uint32_t));
+	snapshot.rng_state = get(&cursor, sizeof(uint32_t));
+
+	for (unsigned i = 0; i < CHIP8_STACK_DEPTH; ++i)
+	{
+		snapshot.call_stack[i] = get(&cursor, sizeof(uint16_t));
+	}
+
+	for (unsigned y = 0; y < CHIP8_VIDEO_HEIGHT; ++y)
+	{
+		snapshot.video_mem[y] = get(&cursor, sizeof(uint64_t));
+	}
+
+	memcpy(snapshot.mem, cursor, sizeof(snapshot.mem));
+
+	// Fields the cores rely on being in range
+	if (snapshot.SP >= CHIP8_STACK_DEPTH || snapshot.key_wait > 1 || snapshot.key_wait_reg >= 16 ||
+		snapshot.ips < CHIP8_TIMER_HZ || snapshot.ips > CHIP8_MAX_IPS || snapshot.timer_phase >= snapshot.ips ||
+		snapshot.rng_state == 0)
+	{
+		return EPROTO;
+	}
+
+	apply(chip8, &snapshot, ~0ull);
+
+	// Memory no longer follows any in memory snapshot
+	chip8->snapshot_id = 0;
+	chip8->mem_dirty_pages = 0;
+	return 0;
+}
@@ -0,0 +1,90 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  chip8_snapshot.h
+ *
+ *    Description:  save states.
+ *    				Files hold the complete machine state in a versioned little endian format.
+ *    				In memory snapshots restore only the memory pages and video rows that changed
+ *    				since the state was last captured or restored, for workloads that return to
+ *    				a checkpoint over and over.
+ *
+ *        Version:  1.0
+ *        Created:  10/17/2026 18:52:10
+ *
+ * =====================================================================================
+ */
+
+#ifndef CHIP8_SNAPSHOT_H
+#define CHIP8_SNAPSHOT_H
+
+#include "chip8.h"
+
+#include <stdio.h>
+
+
+// Snapshot file header magic and format version
+#define CHIP8_SNAPSHOT_MAGIC	0x53533843 // "C8SS" read as little endian
+#define CHIP8_SNAPSHOT_VERSION	3
+
+// Machine state captured by chip8_snapshot_capture
+struct chip8_snapshot_t
+{
+	uint64_t id;		// Unique per capture, matched against chip8->snapshot_id
+
+	uint8_t V[16];
+	uint16_t I;
+	uint16_t PC;
+	uint16_t SP;
+	uint16_t delay_timer;
+	uint16_t sound_timer;
+	uint16_t input_state;
+	uint8_t key_wait;
+	uint8_t key_wait_reg;
+	uint64_t cycles;
+	uint32_t ips;
+	uint32_t timer_phase;
+	uint32_t rng_state;
+
+	uint16_t call_stack[CHIP8_STACK_DEPTH];
+	uint64_t video_mem[CHIP8_VIDEO_HEIGHT];
+	uint8_t mem[CHIP8_MEM_SIZE];
+};
+
+
+/**
+ * 	Capture machine state into an in memory snapshot.
+ * 	Starts tracking memory writes in chip8 against it, so chip8 is modified as well.
+ */
+void chip8_snapshot_capture(struct chip8_snapshot_t* snapshot, struct chip8_t* chip8);
+
+/**
+ * 	Copy machine state into a snapshot without tracking writes against it, restoring it copies all of memory.
+ * 	Only fields are written, padding keeps whatever the snapshot held before.
+ */
+void chip8_snapshot_take(struct chip8_snapshot_t* snapshot, const struct chip8_t* chip8);
+
+/**
+ * 	Return machine to a captured state.
+ * 	When the snapshot was the last one captured into or restored to chip8, only memory pages written since
+ * 	and video rows that differ are copied, anything else restores all of memory.
+ * 	Changed video rows are marked in video_dirty_rows and raise video_update. The trace ring is left attached.
+ * 	Translated code of a chip8_jit_t is not dropped, invalidate it when restoring under a recompiler.
+ */
+void chip8_snapshot_restore(struct chip8_t* chip8, const struct chip8_snapshot_t* snapshot);
+
+/**
+ * 	Write machine state to a file.
+ * 	@return 			0 or errno
+ */
+int chip8_snapshot_save(const struct chip8_t* chip8, FILE* file);
+
+/**
+ * 	Read machine state written by chip8_snapshot_save. chip8 is left untouched on failure.
+ * 	SP must index call_stack, any PC is taken since fetches wrap around memory.
+ * 	@return 			0, errno or EPROTO for malformed files
+ */
+int chip8_snapshot_load(struct chip8_t* chip8, FILE* file);
+
+
+#endif
@@ -0,0 +1,335 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  chip8_threaded.c
+ *
+ *    Description:  chip8 interpreter core using threaded (computed goto) dispatch.
+ *    				Requires GCC labels as values.
+ *
+ *        Version:  1.0
+ *        Created:  10/17/2026 11:40:51
+ *
+ * =====================================================================================
+ */
+
+#include "chip8.h"
+#include "chip8_core.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+
+// Execute instructions through a threaded dispatch loop.
+// When fetch is 0, executes just the given opcode without touching timers (chip8_exec semantics).
+// Otherwise ignores opcode and runs up to cycles instructions starting from PC (chip8_run semantics),
+// exit_reason is only set when execution stops without an error.
+static int threaded_run(struct chip8_t* chip8, uint16_t opcode, int fetch, unsigned long cycles, enum chip8_exit_t* exit_reason)
+{
+
+	// One handler per opcode family, indexed by the high nibble
+	static const void* const dispatch_table[16] =
+	{
+		&&op_0, &&op_1, &&op_2, &&op_3, &&op_4, &&op_5, &&op_6, &&op_7,
+		&&op_8, &&op_9, &&op_A, &&op_B, &&op_C, &&op_D, &&op_E, &&op_F,
+	};
+
+	CHIP8_OPSTATS_DECLARE(opstats_start);
+
+	// Replicated at the tail of every handler so each one gets its own indirect jump
+	#define DISPATCH() 								\
+		do { 									\
+			CHIP8_OPSTATS_END(chip8, opcode, opstats_start);		\
+			if (!fetch) 							\
+				return 0; 						\
+			chip8_step_timers(chip8); 					\
+			++chip8->cycles; 						\
+			if (chip8->video_update) { 					\
+				*exit_reason = CHIP8_EXIT_FRAME; 			\
+				return 0; 						\
+			} 								\
+			if (--cycles == 0) { 						\
+				*exit_reason = CHIP8_EXIT_CYCLES; 			\
+				return 0; 						\
+			} 								\
+			opcode = chip8_fetch(chip8); 					\
+			CHIP8_TRACE_INSN(chip8, chip8->PC - CHIP8_OPCODE_SIZE, opcode);	\
+			CHIP8_OPSTATS_BEGIN(chip8, opcode, opstats_start);		\
+			goto *dispatch_table[opcode >> 12]; 				\
+		} while (0)
+
+	#define VX	chip8->V[CHIP8_REGX_OPERAND(opcode)]
+	#define VY	chip8->V[CHIP8_REGY_OPERAND(opcode)]
+	#define NN	CHIP8_CONST8_OPERAND(opcode)
+	#define NNN	CHIP8_ADDR_OPERAND(opcode)
+
+	if (fetch)
+	{
+		if (chip8->key_wait)
+		{
+			chip8_idle(chip8, cycles);
+			*exit_reason = CHIP8_EXIT_KEY_WAIT;
+			return 0;
+		}
+
+		if (cycles == 0)
+		{
+			*exit_reason = CHIP8_EXIT_CYCLES;
+			return 0;
+		}
+
+		opcode = chip8_fetch(chip8);
+		CHIP8_TRACE_INSN(chip8, chip8->PC - CHIP8_OPCODE_SIZE, opcode);
+	}
+
+	CHIP8_OPSTATS_BEGIN(chip8, opcode, opstats_start);
+	goto *dispatch_table[opcode >> 12];
+
+op_0: /* various */
+	switch (opcode & 0x00FF)
+	{
+	case 0x0000: /* Not used in modern interpreters */
+		return ENOTSUP;
+
+	case 0x00E0: /* clear screen */
+		chip8_clear_screen(chip8);
+		break;
+
+	case 0x00EE: /* return */
+		chip8->PC = chip8->call_stack[chip8->SP & CHIP8_STACK_MASK];
+		chip8->SP = (chip8->SP - 1) & CHIP8_STACK_MASK;
+		break;
+
+	default:
+		return EINVAL;
+	}
+	DISPATCH();
+
+op_1: /* jump to NNN */
+	if (fetch && CHIP8_IS_IDLE_JUMP(chip8->PC, NNN))
+	{
+		// Short jumps back may close an idle loop, its whole iterations are skipped before DISPATCH accounts the jump
+		chip8->PC = NNN;
+		cycles -= chip8_skip_idle(chip8, cycles - 1);
+	}
+	else
+	{
+		chip8->PC = NNN;
+	}
+	DISPATCH();
+
+op_2: /* call to NNN */
+	chip8->SP = (chip8->SP + 1) & CHIP8_STACK_MASK;
+	chip8->call_stack[chip8->SP] = chip8->PC;
+	chip8->PC = NNN;
+	DISPATCH();
+
+op_3: /* skip next insturction if VX == NN */
+	CHIP8_SKIP(chip8, (VX == NN));
+	DISPATCH();
+
+op_4: /* skip next instruction if VX != NN */
+	CHIP8_SKIP(chip8, (VX != NN));
+	DISPATCH();
+
+op_5: /* skip next instruction if VX == VY */
+	CHIP8_SKIP(chip8, (VX == VY));
+	DISPATCH();
+
+op_6: /* VX = NN */
+	VX = NN;
+	DISPATCH();
+
+op_7: /* VX += NN */
+	VX += NN;
+	DISPATCH();
+
+op_8: /* various */
+	switch (opcode & 0x000F)
+	{
+	case 0x0000: /* V[X] = V[Y] */
+		VX = VY;
+		break;
+
+	case 0x0001: /* V[X] |= V[Y] */
+		VX |= VY;
+		break;
+
+	case 0x0002: /* v[x] &= v[y] */
+		VX &= VY;
+		break;
+
+	case 0x0003: /* v[x] ^= v[y] */
+		VX ^= VY;
+		break;
+
+	case 0x0004: /* v[x] += v[y], carry */
+		chip8->V[CHIP8_VF] = VX > (0xFF - VY);
+		VX += VY;
+		break;
+
+	case 0x0005: /* V[X] -= V[Y], borrow */
+		chip8->V[CHIP8_VF] = VX >= VY;
+		VX -= VY;
+		break;
+
+	case 0x0006: /* V[X] >> 1, shifted bit into VF */
+		chip8->V[CHIP8_VF] = VX & 0x1;
+		VX >>= 1;
+		break;
+
+	case 0x0007: /* V[X] = V[Y] - V[X], borrow */
+		chip8->V[CHIP8_VF] = VY >= VX;
+		VX = VY - VX;
+		break;
+
+	case 0x000E: /* V[X] << 1, shifted bit into VF */
+		chip8->V[CHIP8_VF] = (0 != (VX & 0x80));
+		VX <<= 1;
+		break;
+
+	default:
+		return EINVAL;
+	}
+	DISPATCH();
+
+op_9: /* skip next instruction if VX != VY */
+	CHIP8_SKIP(chip8, (VX != VY));
+	DISPATCH();
+
+op_A: /* I = NNN */
+	chip8->I = NNN;
+	DISPATCH();
+
+op_B: /* jmp NNN + V0 */
+	chip8->PC = NNN + chip8->V[0];
+	DISPATCH();
+
+op_C: /* V[X] = rand() & NN */
+	VX = chip8_xorshift32(&chip8->rng_state) & NN;
+	DISPATCH();
+
+op_D: /* draw sprite stored at I as 8 by N pixels at screen coords V[X]:V[Y] */
+	chip8_draw_sprite(chip8, VX, VY, CHIP8_CONST4_OPERAND(opcode), chip8->I);
+	DISPATCH();
+
+op_E: /* various */
+	switch (opcode & 0x00FF)
+	{
+	case 0x009E: /* next if X is pressed */
+		chip8->PC += 2 * CHIP8_IS_KEY_MARKED(chip8->input_state, VX);
+		break;
+
+	case 0x00A1: /* next if X is NOT pressed */
+		chip8->PC += 2 * !CHIP8_IS_KEY_MARKED(chip8->input_state, VX);
+		break;
+
+	default:
+		return EINVAL;
+	}
+	DISPATCH();
+
+op_F: /* various */
+	switch (opcode & 0x00FF)
+	{
+	case 0x0007: /* Sets VX to the value of the delay timer. */
+		VX = chip8->delay_timer;
+		break;
+
+	case 0x000A: /* A key press is awaited, and then stored in VX. chip8_set_key_state delivers it. */
+		chip8->key_wait = 1;
+		chip8->key_wait_reg = CHIP8_REGX_OPERAND(opcode);
+		CHIP8_OPSTATS_END(chip8, opcode, opstats_start);
+		if (!fetch)
+			return 0;
+
+		chip8_step_timers(chip8);
+		++chip8->cycles;
+
+		// A frame still pending is reported like DISPATCH would, the halt idles on the next run
+		if (chip8->video_update)
+		{
+			*exit_reason = CHIP8_EXIT_FRAME;
+			return 0;
+		}
+
+		// Halted for the rest of the budget
+		chip8_idle(chip8, cycles - 1);
+		*exit_reason = CHIP8_EXIT_KEY_WAIT;
+		return 0;
+
+	case 0x0015: /* Sets the delay timer to VX. */
+		chip8->delay_timer = VX;
+		break;
+
+	case 0x0018: /* Sets the sound timer to VX. */
+		chip8->sound_timer = VX;
+		break;
+
+	case 0x001E: /* Adds VX to I. VF if range overflow */
+		chip8->V[CHIP8_VF] = (VX + chip8->I) > 0xFFF;
+		chip8->I += VX;
+		break;
+
+	case 0x0029: /* Sets I to the location of the sprite for the character in VX. */
+		chip8->I = VX * 5;
+		break;
+
+	case 0x0033: /* Stores the Binary-coded decimal representation of VX at I, I + 1 and I + 2 */
+	{
+		uint8_t value = VX;
+		CHIP8_MEM_AT(chip8, chip8->I + 2) 	= value % 10; value /= 10;
+		CHIP8_MEM_AT(chip8, chip8->I + 1) 	= value % 10; value /= 10;
+		CHIP8_MEM_AT(chip8, chip8->I) 		= value % 10;
+		chip8_invalidate(chip8, chip8->I, 3);
+		break;
+	}
+
+	case 0x0055: /* Stores V0 to VX in memory starting at address I. */
+		for (unsigned i = 0; i <= CHIP8_REGX_OPERAND(opcode); ++i)
+		{
+			CHIP8_MEM_AT(chip8, chip8->I + i) = chip8->V[i];
+		}
+		chip8_invalidate(chip8, chip8->I, CHIP8_REGX_OPERAND(opcode) + 1);
+		break;
+
+	case 0x0065: /* Fills V0 to VX with values from memory starting at address I. */
+		for (unsigned i = 0; i <= CHIP8_REGX_OPERAND(opcode); ++i)
+		{
+			chip8->V[i] = CHIP8_MEM_AT(chip8, chip8->I + i);
+		}
+		break;
+
+	default:
+		return EINVAL;
+	}
+	DISPATCH();
+
+	#undef NNN
+	#undef NN
+	#undef VY
+	#undef VX
+	#undef DISPATCH
+}
+
+int chip8_exec(struct chip8_t* chip8, uint16_t opcode)
+{
+	return threaded_run(chip8, opcode, 0, 1, NULL);
+}
+
+int chip8_tick(struct chip8_t* chip8)
+{
+	enum chip8_exit_t exit_reason;
+	return threaded_run(chip8, 0, 1, 1, &exit_reason);
+}
+
+int chip8_run(struct chip8_t* chip8, unsigned long max_cycles, enum chip8_exit_t* exit_reason)
+{
+	int rc = threaded_run(chip8, 0, 1, max_cycles, exit_reason);
+	if (rc)
+	{
+		*exit_reason = CHIP8_EXIT_ERROR;
+	}
+
+	return rc;
+}
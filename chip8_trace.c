@@ -0,0 +1,115 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  chip8_trace.c
+ *
+ *    Description:  execution trace ring allocation and trace file format
+ *
+ *        Version:  1.0
+ *        Created:  10/17/2026 16:41:05
+ *
+ * =====================================================================================
+ */
+
+#include "chip8_trace.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+
+// Largest ring chip8_trace_create will allocate
+#define CHIP8_TRACE_MAX_CAPACITY	(1u << 31)
+
+struct chip8_trace_t* chip8_trace_create(uint32_t capacity)
+{
+	if (capacity == 0 || capacity > CHIP8_TRACE_MAX_CAPACITY)
+	{
+		errno = EINVAL;
+		return NULL;
+	}
+
+	uint32_t size = 1;
+	while (size < capacity)
+	{
+		size <<= 1;
+	}
+
+	struct chip8_trace_t* trace = malloc(sizeof(*trace) + (size_t)size * sizeof(trace->records[0]));
+	if (trace == NULL)
+	{
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	trace->head = 0;
+	trace->mask = size - 1;
+	return trace;
+}
+
+void chip8_trace_destroy(struct chip8_trace_t* trace)
+{
+	free(trace);
+}
+
+int chip8_trace_save(const struct chip8_trace_t* trace, FILE* file)
+{
+	uint64_t capacity = (uint64_t)trace->mask + 1;
+	uint64_t count = trace->head < capacity ? trace->head : capacity;
+
+	struct chip8_trace_header_t header;
+	memset(&header, 0, sizeof(header));
+	header.magic = CHIP8_TRACE_MAGIC;
+	header.version = CHIP8_TRACE_VERSION;
+	header.record_size = sizeof(struct chip8_trace_record_t);
+	header.count = count;
+	header.dropped = trace->head - count;
+
+	if (fwrite(&header, sizeof(header), 1, file) != 1)
+	{
+		return EIO;
+	}
+
+	// Oldest record sits at head once the ring wrapped, split the write there
+	uint64_t first = (trace->head - count) & trace->mask;
+	uint64_t tail = capacity - first < count ? capacity - first : count;
+
+	if (fwrite(&trace->records[first], sizeof(trace->records[0]), tail, file) != tail ||
+		fwrite(&trace->records[0], sizeof(trace->records[0]), count - tail, file) != count - tail)
+	{
+		return EIO;
+	}
+
+	return fflush(file) ? errno : 0;
+}
+
+int chip8_trace_load(FILE* file, struct chip8_trace_header_t* header, struct chip8_trace_record_t** records)
+{
+	if (fread(header, sizeof(*header), 1, file) != 1)
+	{
+		return ferror(file) ? EIO : EPROTO;
+	}
+
+	if (header->magic != CHIP8_TRACE_MAGIC ||
+		header->version != CHIP8_TRACE_VERSION ||
+		header->record_size != sizeof(struct chip8_trace_record_t) ||
+		header->count > CHIP8_TRACE_MAX_CAPACITY)
+	{
+		return EPROTO;
+	}
+
+	*records = malloc((size_t)header->count * sizeof(**records) + 1);
+	if (*records == NULL)
+	{
+		return ENOMEM;
+	}
+
+	if (fread(*records, sizeof(**records), header->count, file) != header->count)
+	{
+		free(*records);
+		*records = NULL;
+		return ferror(file) ? EIO : EPROTO;
+	}
+
+	return 0;
+}
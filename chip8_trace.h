@@ -0,0 +1,85 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  chip8_trace.h
+ *
+ *    Description:  binary execution trace ring buffer.
+ *    				Recording is compiled in only when building with CHIP8_TRACE defined (make TRACE=1),
+ *    				otherwise attached buffers stay empty and the cores carry no tracing code.
+ *
+ *        Version:  1.0
+ *        Created:  10/17/2026 16:41:05
+ *
+ * =====================================================================================
+ */
+
+#ifndef CHIP8_TRACE_H
+#define CHIP8_TRACE_H
+
+#include "chip8.h"
+
+#include <stdio.h>
+
+
+// Trace file header magic and format version
+#define CHIP8_TRACE_MAGIC	0x52543843 // "C8TR" read as little endian
+#define CHIP8_TRACE_VERSION	1
+
+// One executed instruction, state is sampled before it runs
+struct chip8_trace_record_t
+{
+	uint64_t cycle;		// Value of chip8->cycles, index of the instruction since init
+	uint16_t pc;		// Address of the instruction
+	uint16_t opcode;	// Raw opcode
+	uint16_t I;		// Address register
+	uint8_t sp;		// Stack pointer
+	uint8_t vf;		// Carry flag
+};
+
+// Ring of the most recent records, attached to a chip8 state through chip8->trace
+struct chip8_trace_t
+{
+	uint64_t head;		// Total number of records written, next one goes to head & mask
+	uint32_t mask;		// Capacity - 1, capacity is a power of two
+	struct chip8_trace_record_t records[];
+};
+
+// Trace file header, followed by count records oldest first. All fields are in host byte order.
+struct chip8_trace_header_t
+{
+	uint32_t magic;		// CHIP8_TRACE_MAGIC
+	uint16_t version;	// CHIP8_TRACE_VERSION
+	uint16_t record_size;	// sizeof(struct chip8_trace_record_t)
+	uint64_t count;		// Number of records in file
+	uint64_t dropped;	// Records overwritten in the ring before it was saved
+};
+
+
+/**
+ * 	Allocate an empty trace ring.
+ * 	@param capacity			Number of records kept, rounded up to a power of two
+ * 	@return 			New ring or NULL with errno set
+ */
+struct chip8_trace_t* chip8_trace_create(uint32_t capacity);
+
+/**
+ * 	Release trace ring. Detach it from chip8 states first.
+ */
+void chip8_trace_destroy(struct chip8_trace_t* trace);
+
+/**
+ * 	Write recorded instructions to a file, oldest first.
+ * 	@return 			0 or errno
+ */
+int chip8_trace_save(const struct chip8_trace_t* trace, FILE* file);
+
+/**
+ * 	Read trace file written by chip8_trace_save.
+ * 	@param header			Receives file header
+ * 	@param records			Receives malloc'ed array of header->count records, free it when done
+ * 	@return 			0, errno or EPROTO for malformed files
+ */
+int chip8_trace_load(FILE* file, struct chip8_trace_header_t* header, struct chip8_trace_record_t** records);
+
+
+#endif
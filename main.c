@@ -11,19 +11,30 @@
  * =====================================================================================
  */
 
+#define _POSIX_C_SOURCE 200112L
+
 #include "chip8.h"
+#include "chip8_trace.h"
+#include "chip8_rewind.h"
+#include "chip8_record.h"
+#include "chip8_opstats.h"
+#include "chip8_profile.h"
+#include "chip8_rom.h"
 
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
 #include <unistd.h>
-#include <sys/fcntl.h>
+#include <time.h>
 
 #include <GLUT/glut.h> 
 
 static struct chip8_t g_state;
 
+// Session being recorded, key edges go through it
+static struct chip8_record_t* g_record;
+
 
 ////////////////////////////////////////////////////////////////////
 //
@@ -37,49 +48,101 @@ static struct chip8_t g_state;
 #define CHIP8_screen_width CHIP8_VIDEO_WIDTH * CHIP8_PIXEL_SIZE
 #define CHIP8_screen_height CHIP8_VIDEO_HEIGHT * CHIP8_PIXEL_SIZE
 
-// Screen texture data
-static uint8_t g_screen_buffer[CHIP8_VIDEO_HEIGHT][CHIP8_VIDEO_WIDTH][3]; 
+// Palette GL applies while unpacking the 1 bit per pixel framebuffer, index 0 is a disabled pixel
+static const GLfloat g_palette[3][2] =
+{
+	{ 0.0f, 1.0f },	// Red
+	{ 0.0f, 1.0f },	// Green
+	{ 0.0f, 1.0f },	// Blue
+};
+
+// Frames alternate between textures, so an upload never waits for the draw of the previous frame
+#define CHIP8_TEXTURES 2
+
+static GLuint g_textures[CHIP8_TEXTURES];
+static uint32_t g_texture_dirty_rows[CHIP8_TEXTURES];	// Rows changed since each texture was last updated
+static unsigned g_texture;				// Texture drawn last
+
+// Video rows in the byte order GL unpacks bitmaps in, pixel 0 in the most significant bit of the first byte
+static uint64_t g_upload_rows[CHIP8_VIDEO_HEIGHT];
 
 
 // prepare screen
 void setup_texture(void)
 {
-	// Clear screen
-	for(int y = 0; y < CHIP8_VIDEO_HEIGHT; ++y)		
-		for(int x = 0; x < CHIP8_VIDEO_WIDTH; ++x)
-			g_screen_buffer[y][x][0] = g_screen_buffer[y][x][1] = g_screen_buffer[y][x][2] = 0;
+	// Video rows go up as GL_BITMAP color indices and come out as palette colors
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glPixelStorei(GL_UNPACK_LSB_FIRST, GL_FALSE);
+	glPixelMapfv(GL_PIXEL_MAP_I_TO_R, 2, g_palette[0]);
+	glPixelMapfv(GL_PIXEL_MAP_I_TO_G, 2, g_palette[1]);
+	glPixelMapfv(GL_PIXEL_MAP_I_TO_B, 2, g_palette[2]);
+
+	// Create textures, contents are uploaded with the first frames
+	glGenTextures(CHIP8_TEXTURES, g_textures);
 
-	// Create a texture 
-	glTexImage2D(GL_TEXTURE_2D, 0, 3, CHIP8_VIDEO_WIDTH, CHIP8_VIDEO_HEIGHT, 0, GL_RGB, GL_UNSIGNED_BYTE, (GLvoid*)g_screen_buffer);
+	for (unsigned i = 0; i < CHIP8_TEXTURES; ++i)
+	{
+		glBindTexture(GL_TEXTURE_2D, g_textures[i]);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, CHIP8_VIDEO_WIDTH, CHIP8_VIDEO_HEIGHT, 0, GL_COLOR_INDEX, GL_BITMAP, (GLvoid*)g_upload_rows);
+
+		// Set up the texture
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP); 
 
-	// Set up the texture
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP); 
+		g_texture_dirty_rows[i] = CHIP8_ALL_ROWS;
+	}
 
 	// Enable textures
 	glEnable(GL_TEXTURE_2D);
 }
 
+// Video rows keep pixel 0 in the most significant bit of a host word
+static inline uint64_t upload_row(uint64_t row)
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	return __builtin_bswap64(row);
+#else
+	return row;
+#endif
+}
+
 void update_texture(void)
 {	
-	// Update pixels
-	memset(g_screen_buffer, 0, sizeof(g_screen_buffer));
+	const uint64_t* rows = chip8_get_video_rows(&g_state);
+
+	for (unsigned i = 0; i < CHIP8_TEXTURES; ++i)
+	{
+		g_texture_dirty_rows[i] |= g_state.video_dirty_rows;
+	}
+
+	g_state.video_dirty_rows = 0;
+
+	// Bring the other texture up to date and draw it
+	g_texture = (g_texture + 1) % CHIP8_TEXTURES;
+	glBindTexture(GL_TEXTURE_2D, g_textures[g_texture]);
+
+	uint32_t dirty = g_texture_dirty_rows[g_texture];
+	g_texture_dirty_rows[g_texture] = 0;
 
-	for(int y = 0; y < 32; ++y)	
-	{	
-		for(int x = 0; x < 64; ++x)
+	// Upload each run of consecutive dirty rows at once
+	for(int y = 0; y < CHIP8_VIDEO_HEIGHT && (dirty >> y); )
+	{
+		if (!(dirty & (1u << y)))
 		{
-			if (g_state.video_mem[y][x] != 0)
-			{
-				g_screen_buffer[y][x][0] = g_screen_buffer[y][x][1] = g_screen_buffer[y][x][2] = 255;  // Enabled
-			}
+			++y;
+			continue;
 		}
-	}
 
-	// Update Texture
-	glTexSubImage2D(GL_TEXTURE_2D, 0 ,0, 0, CHIP8_VIDEO_WIDTH, CHIP8_VIDEO_HEIGHT, GL_RGB, GL_UNSIGNED_BYTE, (GLvoid*)g_screen_buffer);
+		int first = y;
+		for(; y < CHIP8_VIDEO_HEIGHT && (dirty & (1u << y)); ++y)
+		{
+			g_upload_rows[y] = upload_row(rows[y]);
+		}
+
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, first, CHIP8_VIDEO_WIDTH, y - first, GL_COLOR_INDEX, GL_BITMAP, (GLvoid*)&g_upload_rows[first]);
+	}
 
 	glBegin( GL_QUADS );
 		glTexCoord2d(0.0, 0.0);	glVertex2d(0.0, 0.0);
@@ -99,23 +162,146 @@ void display(void)
 	g_state.video_update = 0;
 }
 
-// 
+////////////////////////////////////////////////////////////////////
+//
+//	Pacing
+//
+////////////////////////////////////////////////////////////////////
+
+
+// Emulated time is paced in host frames of 1 / CHIP8_HOST_HZ seconds
+#define CHIP8_HOST_HZ 60
+
+// Host frames emulation may fall behind before the clock gives up catching up
+#define CHIP8_MAX_LAG_FRAMES 15
+
+// Instructions per idle callback in max speed mode
+#define CHIP8_MAX_SPEED_CYCLES 100000
+
+#define NSEC_PER_SEC 1000000000L
+
+// Emulated time is g_state.cycles / g_state.ips, it was in sync with the host clock at g_epoch
+static struct timespec g_epoch;
+static uint64_t g_epoch_cycles;
+
+// Run emulated time as fast as the host allows
+static int g_max_speed;
+
+// History stepped back through while backspace is held
+static struct chip8_rewind_t* g_rewind;
+static int g_rewinding;
+
+// Guest profile written on exit
+static struct chip8_profile_t* g_profile;
+
+static void sync_clock(void)
+{
+	clock_gettime(CLOCK_MONOTONIC, &g_epoch);
+	g_epoch_cycles = g_state.cycles;
+}
+
+// Host time at which emulated time reaches the current cycle
+static struct timespec get_deadline(void)
+{
+	uint64_t cycles = g_state.cycles - g_epoch_cycles;
+	struct timespec deadline = g_epoch;
+
+	deadline.tv_sec += cycles / g_state.ips;
+	deadline.tv_nsec += (cycles % g_state.ips) * NSEC_PER_SEC / g_state.ips;
+	if (deadline.tv_nsec >= NSEC_PER_SEC)
+	{
+		deadline.tv_nsec -= NSEC_PER_SEC;
+		++deadline.tv_sec;
+	}
+
+	return deadline;
+}
+
+// Sleep until emulated time catches up with the host clock, resync when too far behind
+static void pace(void)
+{
+	struct timespec deadline = get_deadline();
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	double lag = (now.tv_sec - deadline.tv_sec) + (now.tv_nsec - deadline.tv_nsec) / (double)NSEC_PER_SEC;
+	if (lag > (double)CHIP8_MAX_LAG_FRAMES / CHIP8_HOST_HZ)
+	{
+		sync_clock();
+		return;
+	}
+
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR)
+		;
+}
+
+// Step back one recorded frame per host frame, emulation resumes from there once rewinding stops
+static void rewind_frame(void)
+{
+	if (chip8_rewind_step_back(g_rewind, &g_state) == 0)
+	{
+		g_state.video_update = 0;
+		glutPostRedisplay();
+	}
+
+	struct timespec frame = { 0, NSEC_PER_SEC / CHIP8_HOST_HZ };
+	while (nanosleep(&frame, &frame) == -1 && errno == EINTR)
+		;
+
+	sync_clock();
+}
+
+// glut idle handler, runs one host frame of emulated time
 void tick(void)
 {
-	int error = chip8_tick(&g_state);
-	if (error)
+	if (g_rewinding)
+	{
+		rewind_frame();
+		return;
+	}
+
+	uint64_t end = g_state.cycles + (g_max_speed ? CHIP8_MAX_SPEED_CYCLES : g_state.ips / CHIP8_HOST_HZ);
+	int redraw = 0;
+
+	while (g_state.cycles < end)
 	{
-		uint16_t opcode = (uint16_t)(g_state.mem[g_state.PC - 2] << 8) | (g_state.mem[g_state.PC - 1]);
-		printf("Execution exception at 0x%x (0x%x): %s\n", g_state.PC, opcode, strerror(error));
-		exit(error);
+		enum chip8_exit_t exit_reason;
+
+		int error = g_profile ? chip8_profile_run(g_profile, &g_state, end - g_state.cycles, &exit_reason) :
+			chip8_run(&g_state, end - g_state.cycles, &exit_reason);
+		if (error)
+		{
+			uint16_t opcode = (uint16_t)(g_state.mem[g_state.PC - 2] << 8) | (g_state.mem[g_state.PC - 1]);
+			printf("Execution exception at 0x%x (0x%x): %s\n", g_state.PC, opcode, strerror(error));
+			exit(error);
+		}
+
+		if (exit_reason == CHIP8_EXIT_FRAME)
+		{
+			// Frame is presented once per host frame with whatever the last draw left
+			g_state.video_update = 0;
+			redraw = 1;
+		}
 	}
 
-	if(g_state.video_update > 0)
-	{ 
+	if (redraw)
+	{
 		glutPostRedisplay();
 	}
 
-	usleep(2000);
+	if (g_rewind)
+	{
+		chip8_rewind_push(g_rewind, &g_state);
+	}
+
+	if (g_max_speed)
+	{
+		sync_clock();
+	}
+	else
+	{
+		pace();
+	}
 }
 
 void reshape_window(GLsizei w, GLsizei h)
@@ -128,6 +314,25 @@ void reshape_window(GLsizei w, GLsizei h)
     	glViewport(0, 0, w, h);
 }
 
+// Operation counters written on exit and whenever p is pressed
+static struct chip8_opstats_t* g_opstats;
+static const char* g_opstats_path;
+
+static void save_opstats(void)
+{
+	FILE* file = fopen(g_opstats_path, "w");
+	int error = file ? chip8_opstats_dump(g_opstats, file) : errno;
+	if (error)
+	{
+		printf("Failed saving operation counters %s: %s\n", g_opstats_path, strerror(error));
+	}
+
+	if (file)
+	{
+		fclose(file);
+	}
+}
+
 static char g_key_map[CHIP8_TOTAL_KEYS] = 
 {
 	'1', '2', '3', '4',
@@ -136,6 +341,21 @@ static char g_key_map[CHIP8_TOTAL_KEYS] =
 	'z', 'x', 'c', 'v',
 };
 
+static void set_key(unsigned key, int is_pressed)
+{
+	if (g_record == NULL)
+	{
+		chip8_set_key_state(&g_state, key, is_pressed);
+		return;
+	}
+
+	int error = chip8_record_key(g_record, &g_state, key, is_pressed);
+	if (error)
+	{
+		printf("Failed recording key %u: %s\n", key, strerror(error));
+	}
+}
+
 static uint8_t get_mapped_key(char glut_key)
 {
 	for (unsigned i = 0; i < CHIP8_TOTAL_KEYS; ++i)
@@ -154,20 +374,45 @@ void keyboardDown(unsigned char key, int x, int y)
 	if(key == 27)    // esc
 		exit(0);
 
+	if(key == '\t')    // toggle max speed
+	{
+		g_max_speed = !g_max_speed;
+		sync_clock();
+		return;
+	}
+
+	if(key == '\b' || key == 127)    // rewind while held
+	{
+		g_rewinding = g_rewind != NULL;
+		return;
+	}
+
+	if(key == 'p' && g_opstats)    // dump operation counters
+	{
+		save_opstats();
+		return;
+	}
+
 	uint8_t mapped_key = get_mapped_key(key);
 	if (mapped_key < CHIP8_TOTAL_KEYS)
 	{
 		printf("Marking key %d\n", mapped_key);
-		chip8_set_key_state(&g_state, mapped_key, 1);
+		set_key(mapped_key, 1);
 	}
 }
 
 void keyboardUp(unsigned char key, int x, int y)
 {
+	if(key == '\b' || key == 127)
+	{
+		g_rewinding = 0;
+		return;
+	}
+
 	uint8_t mapped_key = get_mapped_key(key);
 	if (mapped_key < CHIP8_TOTAL_KEYS)
 	{
-		chip8_set_key_state(&g_state, mapped_key, 0);
+		set_key(mapped_key, 0);
 	}
 }
 
@@ -179,45 +424,214 @@ void keyboardUp(unsigned char key, int x, int y)
 ////////////////////////////////////////////////////////////////////
 
 
+// Default rewind history size
+#define CHIP8_REWIND_BUDGET_KIB 4096
+
+// Instructions between two timed ones when counting operations
+#define CHIP8_OPSTATS_INTERVAL 64
+
+// Mean instructions between two guest profile samples
+#define CHIP8_PROFILE_INTERVAL 100
+
 static void usage()
 {
-	printf("soft-chip8 image\n");
+	printf("soft-chip8 [-i ips] [-f] [-r kib] [-s seed] [-R recording | -P recording] [-c counters [-C interval]] [-p stacks] [-l listing [-n interval]] image [trace]\n");
+	printf("\t-i\temulated instructions per second, %d by default\n", CHIP8_DEFAULT_IPS);
+	printf("\t-f\tstart in max speed mode, tab toggles it\n");
+	printf("\t-r\trewind history size in KiB, %d by default, 0 disables it. Hold backspace to rewind\n", CHIP8_REWIND_BUDGET_KIB);
+	printf("\t-s\tseed of the CXNN random numbers, %d by default\n", CHIP8_DEFAULT_SEED);
+	printf("\t-R\trecord key presses to a file on exit, disables rewind\n");
+	printf("\t-P\treplay a recording headless at max speed, printing a framebuffer hash per frame\n");
+	printf("\t-c\twrite per operation counts and timings to a file on exit and when p is pressed, needs OPSTATS=1\n");
+	printf("\t-C\ttime every interval-th instruction, %d by default, 0 only counts\n", CHIP8_OPSTATS_INTERVAL);
+	printf("\t-p\tsample the guest program, writing call stacks for flamegraph.pl to a file on exit\n");
+	printf("\t-l\tsample the guest program, writing sampled addresses with disassembly to a file on exit\n");
+	printf("\t-n\tinstructions between guest samples on average, %d by default\n", CHIP8_PROFILE_INTERVAL);
 }
 
-// Load app image
-static int load_image(const char* path)
+static const char* g_record_path;
+
+// Write recording on exit, replay it with -P
+static void save_record(void)
 {
-	int fd = open(path, O_RDONLY);
-	if (fd < 0)
+	FILE* file = fopen(g_record_path, "wb");
+	int error = file ? chip8_record_save(g_record, &g_state, file) : errno;
+	if (error)
 	{
-		return errno;
+		printf("Failed saving recording %s: %s\n", g_record_path, strerror(error));
+	}
+
+	if (file)
+	{
+		fclose(file);
 	}
+}
+
+// FNV-1a over the framebuffer bytes, pixel 0 first, matches chip8-batch
+static uint64_t hash_framebuffer(void)
+{
+	const uint64_t* rows = chip8_get_video_rows(&g_state);
+	uint64_t hash = 0xCBF29CE484222325ULL;
 
-	// check image size
-	off_t fsize = lseek(fd, 0, SEEK_END);
-	if (fsize > CHIP8_RAM_SIZE)
+	for (int y = 0; y < CHIP8_VIDEO_HEIGHT; ++y)
 	{
-		return ENOSPC;
+		for (int shift = CHIP8_VIDEO_WIDTH - 8; shift >= 0; shift -= 8)
+		{
+			hash ^= (rows[y] >> shift) & 0xFF;
+			hash *= 0x100000001B3ULL;
+		}
 	}
 
-	lseek(fd, 0, SEEK_SET);
+	return hash;
+}
 
-	if (fsize != read(fd, g_state.mem + CHIP8_INIT_PC, fsize))
+// Feed a recording back into the loaded image as fast as possible.
+// Prints the framebuffer hash after every host frame of emulated time to stdout and the speed to stderr,
+// so outputs of two builds can be compared directly.
+static int replay(const char* path)
+{
+	FILE* file = fopen(path, "rb");
+	if (file == NULL)
 	{
+		printf("Failed opening recording %s: %s\n", path, strerror(errno));
 		return errno;
 	}
 
+	struct chip8_record_t* record;
+	int error = chip8_record_load(file, &record);
+	fclose(file);
+
+	if (error)
+	{
+		printf("Failed reading recording %s: %s\n", path, strerror(error));
+		return error;
+	}
+
+	chip8_set_seed(&g_state, record->header.seed);
+	chip8_set_ips(&g_state, record->header.ips);
+
+	uint64_t frame_cycles = record->header.ips / CHIP8_HOST_HZ;
+	size_t next = 0;
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (uint64_t frame = 0; g_state.cycles < record->header.cycles; ++frame)
+	{
+		uint64_t frame_end = g_state.cycles + frame_cycles;
+		if (frame_end > record->header.cycles)
+		{
+			frame_end = record->header.cycles;
+		}
+
+		while (g_state.cycles < frame_end)
+		{
+			enum chip8_exit_t exit_reason;
+			unsigned long budget = frame_end - g_state.cycles;
+			uint64_t start = g_state.cycles;
+
+			error = chip8_record_replay(record, &next, &g_state, g_profile ? chip8_profile_budget(g_profile, budget) : budget,
+				&exit_reason);
+			if (error)
+			{
+				printf("Execution exception at 0x%x: %s\n", g_state.PC, strerror(error));
+				chip8_record_destroy(record);
+				return error;
+			}
+
+			if (g_profile)
+			{
+				chip8_profile_advance(g_profile, &g_state, start);
+			}
+
+			g_state.video_update = 0;
+		}
+
+		printf("%llu %016llx\n", (unsigned long long)frame, (unsigned long long)hash_framebuffer());
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / (double)NSEC_PER_SEC;
+
+	fprintf(stderr, "%llu insns %.3f s %.2f Minsn/s\n", (unsigned long long)g_state.cycles, elapsed,
+		g_state.cycles / elapsed * 1e-6);
+
+	chip8_record_destroy(record);
 	return 0;
 }
 
-int main(int argc, char** argv)
+// Number of most recent instructions kept when tracing
+#define CHIP8_TRACE_CAPACITY (1 << 16)
+
+static struct chip8_trace_t* g_trace;
+static const char* g_trace_path;
+
+// Dump trace ring on exit, decode it with chip8-trace
+static void save_trace(void)
 {
-	if (argc != 2)
+	FILE* file = fopen(g_trace_path, "wb");
+	int error = file ? chip8_trace_save(g_trace, file) : errno;
+	if (error)
 	{
-		usage();
-		return EXIT_FAILURE;
+		printf("Failed saving trace %s: %s\n", g_trace_path, strerror(error));
+	}
+
+	if (file)
+	{
+		fclose(file);
+	}
+}
+
+static const char* g_profile_stacks_path;
+static const char* g_profile_listing_path;
+
+// Write profile on exit, render the stacks with flamegraph.pl
+static void save_profile(void)
+{
+	const char* paths[] = { g_profile_stacks_path, g_profile_listing_path };
+
+	for (unsigned i = 0; i < 2; ++i)
+	{
+		if (paths[i] == NULL)
+			continue;
+
+		FILE* file = fopen(paths[i], "w");
+		int error = file == NULL ? errno :
+			i == 0 ? chip8_profile_save_folded(g_profile, file) : chip8_profile_save_listing(g_profile, &g_state, file);
+		if (error)
+		{
+			printf("Failed saving profile %s: %s\n", paths[i], strerror(error));
+		}
+
+		if (file)
+		{
+			fclose(file);
+		}
+	}
+}
+
+// Load app image
+static int load_image(const char* path)
+{
+	struct chip8_rom_cache_t* roms = chip8_rom_cache_create();
+	if (roms == NULL)
+	{
+		return errno;
 	}
 
+	const struct chip8_rom_t* rom;
+	int error = chip8_rom_cache_load(roms, path, &rom);
+	if (error == 0)
+	{
+		error = chip8_load_image(&g_state, rom->data, rom->size);
+	}
+
+	chip8_rom_cache_destroy(roms);
+	return error;
+}
+
+int main(int argc, char** argv)
+{
 	int error = chip8_init(&g_state);
 	if (error)
 	{
@@ -225,15 +639,164 @@ int main(int argc, char** argv)
 		return error;
 	}
 
-	printf("Loading image %s\n", argv[1]);
+	unsigned long rewind_kib = CHIP8_REWIND_BUDGET_KIB;
+	uint32_t seed = CHIP8_DEFAULT_SEED;
+	const char* replay_path = NULL;
+	uint32_t opstats_interval = CHIP8_OPSTATS_INTERVAL;
+	uint32_t profile_interval = CHIP8_PROFILE_INTERVAL;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "i:fr:s:R:P:c:C:p:l:n:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'i':
+			error = chip8_set_ips(&g_state, strtoul(optarg, NULL, 0));
+			if (error)
+			{
+				printf("Instruction rate must be %d to %d\n", CHIP8_TIMER_HZ, CHIP8_MAX_IPS);
+				return error;
+			}
+			break;
+
+		case 'f':
+			g_max_speed = 1;
+			break;
+
+		case 'r':
+			rewind_kib = strtoul(optarg, NULL, 0);
+			break;
+
+		case 's':
+			seed = strtoul(optarg, NULL, 0);
+			break;
+
+		case 'R':
+			g_record_path = optarg;
+			break;
+
+		case 'P':
+			replay_path = optarg;
+			break;
+
+		case 'c':
+			g_opstats_path = optarg;
+			break;
+
+		case 'C':
+			opstats_interval = strtoul(optarg, NULL, 0);
+			break;
+
+		case 'p':
+			g_profile_stacks_path = optarg;
+			break;
+
+		case 'l':
+			g_profile_listing_path = optarg;
+			break;
+
+		case 'n':
+			profile_interval = strtoul(optarg, NULL, 0);
+			break;
+
+		default:
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	if ((argc - optind != 1 && argc - optind != 2) || (g_record_path && replay_path))
+	{
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	const char* image = argv[optind];
+	printf("Loading image %s\n", image);
 
-	error = load_image(argv[1]);
+	error = load_image(image);
 	if (error)
 	{
-		printf("Failed loading image %s: %s\n", argv[1], strerror(error));
+		printf("Failed loading image %s: %s\n", image, strerror(error));
 		return error;
 	}
 
+	if (argc - optind == 2)
+	{
+		g_trace_path = argv[optind + 1];
+#ifndef CHIP8_TRACE
+		printf("Built without TRACE=1, trace %s will be empty\n", g_trace_path);
+#endif
+		g_trace = chip8_trace_create(CHIP8_TRACE_CAPACITY);
+		if (g_trace == NULL)
+		{
+			printf("Failed creating trace: %s\n", strerror(errno));
+			return errno;
+		}
+
+		g_state.trace = g_trace;
+		atexit(save_trace);
+	}
+
+	if (g_opstats_path)
+	{
+#ifndef CHIP8_OPSTATS
+		printf("Built without OPSTATS=1, counters %s will be empty\n", g_opstats_path);
+#endif
+		g_opstats = chip8_opstats_create(opstats_interval);
+		if (g_opstats == NULL)
+		{
+			printf("Failed creating operation counters: %s\n", strerror(errno));
+			return errno;
+		}
+
+		g_state.opstats = g_opstats;
+		atexit(save_opstats);
+	}
+
+	if (g_profile_stacks_path || g_profile_listing_path)
+	{
+		g_profile = chip8_profile_create(profile_interval);
+		if (g_profile == NULL)
+		{
+			printf("Failed creating profile: %s\n", strerror(errno));
+			return errno;
+		}
+
+		atexit(save_profile);
+	}
+
+	if (replay_path)
+	{
+		return replay(replay_path);
+	}
+
+	chip8_set_seed(&g_state, seed);
+
+	// Stepping back would leave edges in the recording that never happened
+	if (g_record_path)
+	{
+		g_record = chip8_record_create(seed, g_state.ips);
+		if (g_record == NULL)
+		{
+			printf("Failed creating recording: %s\n", strerror(errno));
+			return errno;
+		}
+
+		atexit(save_record);
+		rewind_kib = 0;
+	}
+
+	if (rewind_kib)
+	{
+		g_rewind = chip8_rewind_create(rewind_kib * 1024);
+		if (g_rewind == NULL)
+		{
+			printf("Failed creating rewind history: %s\n", strerror(errno));
+			return errno;
+		}
+	}
+
 	// Setup OpenGL
 	glutInit(&argc, argv);          
 	glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGBA);
@@ -249,6 +812,7 @@ int main(int argc, char** argv)
 	glutKeyboardUpFunc(keyboardUp); 
 
 	setup_texture();			
+	sync_clock();
 
 	glutMainLoop(); 
 
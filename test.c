@@ -13,11 +13,19 @@
  */
 
 #include "chip8.h"
+#include "chip8_jit.h"
+#include "chip8_trace.h"
+#include "chip8_batch.h"
+#include "chip8_snapshot.h"
+#include "chip8_rewind.h"
+#include "chip8_record.h"
+#include "chip8_opstats.h"
+#include "chip8_profile.h"
+#include "chip8_rom.h"
+#include "chip8_aot.h"
 
 #include <stdlib.h>
 #include <stdio.h>
-#include <signal.h>
-#include <unistd.h>
 
 #include <CUnit/Basic.h>
 
@@ -50,6 +58,27 @@ static uint8_t read_bcd(struct chip8_t* chip8, uint16_t addr)
 }
 
 
+// aot_test.ch8, linked in translated by chip8-aot
+CHIP8_AOT_DECLARE(chip8_aot_run);
+
+
+// Machine state the translated code and the interpreter have to agree on
+static void assert_same_state(const struct chip8_t* expected, const struct chip8_t* chip8)
+{
+	CU_ASSERT_EQUAL(0, memcmp(expected->V, chip8->V, sizeof(chip8->V)));
+	CU_ASSERT_EQUAL(expected->I, chip8->I);
+	CU_ASSERT_EQUAL(expected->PC, chip8->PC);
+	CU_ASSERT_EQUAL(expected->SP, chip8->SP);
+	CU_ASSERT_EQUAL(0, memcmp(expected->call_stack, chip8->call_stack, sizeof(chip8->call_stack)));
+	CU_ASSERT_EQUAL(expected->delay_timer, chip8->delay_timer);
+	CU_ASSERT_EQUAL(expected->sound_timer, chip8->sound_timer);
+	CU_ASSERT_EQUAL(expected->timer_phase, chip8->timer_phase);
+	CU_ASSERT_EQUAL(expected->cycles, chip8->cycles);
+	CU_ASSERT_EQUAL(0, memcmp(expected->mem, chip8->mem, sizeof(chip8->mem)));
+	CU_ASSERT_EQUAL(0, memcmp(expected->video_mem, chip8->video_mem, sizeof(chip8->video_mem)));
+}
+
+
 static void fill_with_random(struct chip8_t* chip8, unsigned last_v)
 {
 	for (unsigned i = 0; i <= last_v; ++i)
@@ -95,6 +124,1207 @@ static void test_init(void)
 }
 
 
+// tests that stores into already executed code drop stale predecoded instructions
+static void test_decode_cache(void)
+{
+	struct chip8_t chip8;
+	CU_ASSERT_EQUAL(0, chip8_init(&chip8));
+
+	uint8_t program[] = 
+	{
+		0xA2, 0x04, 	// I = 0x204
+		0xF1, 0x55, 	// Store V0, V1 at I
+		0x6A, 0x01, 	// V[A] = 1
+	};
+	memcpy(chip8.mem + CHIP8_INIT_PC, program, sizeof(program));
+
+	// Execute and cache instruction at 0x204
+	chip8.PC = 0x204;
+	CU_ASSERT_EQUAL(0, chip8_tick(&chip8));
+	CU_ASSERT_EQUAL(1, chip8.V[0xA]);
+
+	// Patch it into V[A] = 2 and execute again
+	chip8.PC = CHIP8_INIT_PC;
+	chip8.V[0] = 0x6A;
+	chip8.V[1] = 0x02;
+	CU_ASSERT_EQUAL(0, chip8_tick(&chip8));
+	CU_ASSERT_EQUAL(0, chip8_tick(&chip8));
+	CU_ASSERT_EQUAL(0, chip8_tick(&chip8));
+	CU_ASSERT_EQUAL(2, chip8.V[0xA]);
+
+	chip8_release(&chip8);
+}
+
+
+// tests that recompiled code ends up in the same state as the interpreter
+static void test_jit(void)
+{
+	struct chip8_t expected, chip8;
+	enum chip8_exit_t exit_reason;
+	CU_ASSERT_EQUAL(0, chip8_init(&expected));
+
+	uint8_t program[] = 
+	{
+		0x60, 0x00,	// 200: V[0] = 0
+		0x61, 0x0A,	// 202: V[1] = 10
+		0xA3, 0x00,	// 204: I = 0x300
+		0x22, 0x12,	// 206: call 0x212
+		0x71, 0xFF,	// 208: V[1] -= 1
+		0x31, 0x00,	// 20A: skip if V[1] == 0
+		0x12, 0x06,	// 20C: jump 0x206
+		0xF0, 0x55,	// 20E: store V[0] at I
+		0x12, 0x0E,	// 210: jump 0x20E
+		0x80, 0x14,	// 212: V[0] += V[1]
+		0xF0, 0x1E,	// 214: I += V[0]
+		0x00, 0xEE,	// 216: return
+	};
+	memcpy(expected.mem + CHIP8_INIT_PC, program, sizeof(program));
+	expected.delay_timer = 0xFF;
+	memcpy(&chip8, &expected, sizeof(chip8));
+
+	for (unsigned i = 0; i < 200; ++i)
+	{
+		CU_ASSERT_EQUAL(0, chip8_tick(&expected));
+	}
+
+	struct chip8_jit_t* jit = chip8_jit_create(&chip8);
+	CU_ASSERT_PTR_NOT_NULL(jit);
+	CU_ASSERT_EQUAL(0, chip8_jit_run(jit, 200, &exit_reason));
+	CU_ASSERT_EQUAL(CHIP8_EXIT_CYCLES, exit_reason);
+
+	CU_ASSERT_EQUAL(0, memcmp(expected.V, chip8.V, sizeof(chip8.V)));
+	CU_ASSERT_EQUAL(expected.I, chip8.I);
+	CU_ASSERT_EQUAL(expected.PC, chip8.PC);
+	CU_ASSERT_EQUAL(expected.SP, chip8.SP);
+	CU_ASSERT_EQUAL(expected.delay_timer, chip8.delay_timer);
+	CU_ASSERT_EQUAL(0, memcmp(expected.mem, chip8.mem, sizeof(chip8.mem)));
+
+	// Patch V[1] = 10 into V[1] = 1 with a guest store, block at 0x200 must be retranslated
+	chip8.PC = 0x20E;
+	chip8.I = 0x203;
+	chip8.V[0] = 0x01;
+	CU_ASSERT_EQUAL(0, chip8_jit_run(jit, 1, &exit_reason));
+	chip8.PC = CHIP8_INIT_PC;
+	CU_ASSERT_EQUAL(0, chip8_jit_run(jit, 4, &exit_reason));
+	CU_ASSERT_EQUAL(1, chip8.V[1]);
+
+	// Same for host writes reported through chip8_jit_invalidate
+	chip8.mem[0x203] = 0x07;
+	chip8_jit_invalidate(jit, 0x203, 1);
+	chip8.PC = CHIP8_INIT_PC;
+	CU_ASSERT_EQUAL(0, chip8_jit_run(jit, 4, &exit_reason));
+	CU_ASSERT_EQUAL(7, chip8.V[1]);
+
+	chip8_jit_destroy(jit);
+	chip8_release(&chip8);
+	chip8_release(&expected);
+
+	// Blocks of the largest instructions from every entry point cycle through the whole code arena
+	CU_ASSERT_EQUAL(0, chip8_init(&expected));
+	for (unsigned addr = CHIP8_INIT_PC; addr < CHIP8_MEM_SIZE; addr += CHIP8_OPCODE_SIZE)
+	{
+		expected.mem[addr] = 0xF9;
+		expected.mem[addr + 1] = 0x65;
+	}
+	expected.I = 0x100;
+	memcpy(&chip8, &expected, sizeof(chip8));
+
+	jit = chip8_jit_create(&chip8);
+	CU_ASSERT_PTR_NOT_NULL(jit);
+
+	for (unsigned pass = 0; pass < 4; ++pass)
+	{
+		for (unsigned addr = CHIP8_INIT_PC; addr + 64 * CHIP8_OPCODE_SIZE < CHIP8_MEM_SIZE; addr += CHIP8_OPCODE_SIZE)
+		{
+			++expected.mem[0x100 + pass];
+			++chip8.mem[0x100 + pass];
+			expected.PC = chip8.PC = addr;
+			for (unsigned i = 0; i < 64; ++i)
+			{
+				chip8_tick(&expected);
+			}
+			CU_ASSERT_EQUAL(0, chip8_jit_run(jit, 64, &exit_reason));
+		}
+		// Host writes outside code need no invalidation
+		CU_ASSERT_EQUAL(0, memcmp(expected.V, chip8.V, sizeof(chip8.V)));
+		CU_ASSERT_EQUAL(expected.PC, chip8.PC);
+	}
+
+	chip8_jit_destroy(jit);
+	chip8_release(&chip8);
+	chip8_release(&expected);
+}
+
+// tests code translated by chip8-aot against chip8_tick and chip8_run, from both entries of aot_test.ch8:
+// 200: skip to the store loop at 240 when VF is 1, otherwise
+// 206: main loop calling 230 ten times, then BCD, loads, CXNN, a font sprite, stores, skips and timers
+// 240: store loop writing V0 over its own code at 246
+static void test_aot(void)
+{
+	for (unsigned entry = 0; entry < 2; ++entry)
+	{
+		struct chip8_t expected, chip8, run;
+		CU_ASSERT_EQUAL(0, chip8_init(&expected));
+		CU_ASSERT_EQUAL(0, chip8_load_image(&expected, chip8_aot_run_image, chip8_aot_run_image_size));
+		expected.V[CHIP8_VF] = entry;
+		memcpy(&chip8, &expected, sizeof(chip8));
+		memcpy(&run, &expected, sizeof(run));
+
+		// Uneven slices end blocks part way, leaving the rest to the interpreter fallback
+		for (unsigned slice = 1; slice <= 64; ++slice)
+		{
+			for (unsigned i = 0; i < slice; ++i)
+			{
+				CU_ASSERT_EQUAL(0, chip8_tick(&expected));
+			}
+
+			uint64_t start = chip8.cycles;
+			int error = chip8_aot_run(&chip8, slice);
+			CU_ASSERT_TRUE(error == 0 || error == ESTALE);
+			CU_ASSERT_TRUE(chip8.cycles - start <= slice);
+
+			// Overwritten code continues in the interpreter
+			while (error == ESTALE && chip8.cycles < start + slice)
+			{
+				CU_ASSERT_EQUAL(0, chip8_tick(&chip8));
+			}
+
+			while (run.cycles < expected.cycles)
+			{
+				enum chip8_exit_t exit_reason;
+				if (chip8_run(&run, expected.cycles - run.cycles, &exit_reason) != 0)
+				{
+					CU_FAIL("chip8_run failed");
+					break;
+				}
+				run.video_update = 0;
+			}
+
+			assert_same_state(&expected, &chip8);
+			assert_same_state(&expected, &run);
+		}
+
+		chip8_release(&chip8);
+		chip8_release(&run);
+		chip8_release(&expected);
+	}
+
+	// The store at 244 overwrites the block it runs in, only the three instructions up to it count
+	struct chip8_t chip8;
+	CU_ASSERT_EQUAL(0, chip8_init(&chip8));
+	CU_ASSERT_EQUAL(0, chip8_load_image(&chip8, chip8_aot_run_image, chip8_aot_run_image_size));
+	chip8.PC = 0x240;
+	chip8.V[CHIP8_VF] = 1;
+	CU_ASSERT_EQUAL(ESTALE, chip8_aot_run(&chip8, 6));
+	CU_ASSERT_EQUAL(3, chip8.cycles);
+	CU_ASSERT_EQUAL(0x246, chip8.PC);
+	CU_ASSERT_EQUAL(0x63, chip8.mem[0x246]);
+	chip8_release(&chip8);
+}
+
+// tests that batched execution stops on each exit reason
+static void test_run(void)
+{
+	struct chip8_t chip8;
+	enum chip8_exit_t exit_reason;
+	CU_ASSERT_EQUAL(0, chip8_init(&chip8));
+
+	uint8_t program[] =
+	{
+		0x60, 0x05,	// 200: V[0] = 5
+		0xA0, 0x00,	// 202: I = 0
+		0xD0, 0x05,	// 204: Draw 8x5 sprite at V[0]:V[0]
+		0x61, 0x01,	// 206: V[1] = 1
+		0xF2, 0x0A,	// 208: Wait for key press into V[2]
+		0xFF, 0xFF,	// 20A: Invalid
+	};
+	memcpy(chip8.mem + CHIP8_INIT_PC, program, sizeof(program));
+
+	// Empty budget
+	CU_ASSERT_EQUAL(0, chip8_run(&chip8, 0, &exit_reason));
+	CU_ASSERT_EQUAL(CHIP8_EXIT_CYCLES, exit_reason);
+	CU_ASSERT_EQUAL(0, chip8.cycles);
+
+	// Stops right after drawing
+	CU_ASSERT_EQUAL(0, chip8_run(&chip8, 100, &exit_reason));
+	CU_ASSERT_EQUAL(CHIP8_EXIT_FRAME, exit_reason);
+	CU_ASSERT_EQUAL(0x206, chip8.PC);
+	CU_ASSERT_EQUAL(3, chip8.cycles);
+
+	// Budget runs out
+	chip8.video_update = 0;
+	CU_ASSERT_EQUAL(0, chip8_run(&chip8, 1, &exit_reason));
+	CU_ASSERT_EQUAL(CHIP8_EXIT_CYCLES, exit_reason);
+	CU_ASSERT_EQUAL(0x208, chip8.PC);
+	CU_ASSERT_EQUAL(1, chip8.V[1]);
+
+	// Halts waiting for input, the rest of the budget passes with timers running
+	chip8.PC = 0x206;
+	chip8.delay_timer = 50;
+	CU_ASSERT_EQUAL(0, chip8_run(&chip8, 100, &exit_reason));
+	CU_ASSERT_EQUAL(CHIP8_EXIT_KEY_WAIT, exit_reason);
+	CU_ASSERT_EQUAL(0x20A, chip8.PC);
+	CU_ASSERT_EQUAL(104, chip8.cycles);
+	CU_ASSERT_EQUAL(38, chip8.delay_timer);
+	CU_ASSERT_EQUAL(1, chip8.key_wait);
+
+	// Stays halted without a key press
+	CU_ASSERT_EQUAL(0, chip8_run(&chip8, 10, &exit_reason));
+	CU_ASSERT_EQUAL(CHIP8_EXIT_KEY_WAIT, exit_reason);
+	CU_ASSERT_EQUAL(0x20A, chip8.PC);
+	CU_ASSERT_EQUAL(114, chip8.cycles);
+	CU_ASSERT_EQUAL(0, chip8_tick(&chip8));
+	CU_ASSERT_EQUAL(0x20A, chip8.PC);
+	CU_ASSERT_EQUAL(115, chip8.cycles);
+
+	// Key press resumes
+	chip8_set_key_state(&chip8, 3, 1);
+	CU_ASSERT_EQUAL(0, chip8.key_wait);
+	CU_ASSERT_EQUAL(3, chip8.V[2]);
+
+	// Failed instruction
+	CU_ASSERT_EQUAL(EINVAL, chip8_run(&chip8, 100, &exit_reason));
+	CU_ASSERT_EQUAL(CHIP8_EXIT_ERROR, exit_reason);
+	CU_ASSERT_EQUAL(115, chip8.cycles);
+
+	// A frame the host has not presented yet is reported before halting
+	chip8_set_key_state(&chip8, 3, 0);
+	chip8.PC = 0x208;
+	chip8.video_update = 1;
+	CU_ASSERT_EQUAL(0, chip8_run(&chip8, 100, &exit_reason));
+	CU_ASSERT_EQUAL(CHIP8_EXIT_FRAME, exit_reason);
+	CU_ASSERT_EQUAL(116, chip8.cycles);
+	CU_ASSERT_EQUAL(1, chip8.key_wait);
+
+	chip8.video_update = 0;
+	CU_ASSERT_EQUAL(0, chip8_run(&chip8, 10, &exit_reason));
+	CU_ASSERT_EQUAL(CHIP8_EXIT_KEY_WAIT, exit_reason);
+	CU_ASSERT_EQUAL(126, chip8.cycles);
+
+	chip8_release(&chip8);
+}
+
+// tests that timers tick at 60hz of emulated time whatever the instruction rate
+static void test_timers(void)
+{
+	struct chip8_t chip8;
+	enum chip8_exit_t exit_reason;
+	CU_ASSERT_EQUAL(0, chip8_init(&chip8));
+	CU_ASSERT_EQUAL(CHIP8_DEFAULT_IPS, chip8.ips);
+
+	CU_ASSERT_EQUAL(EINVAL, chip8_set_ips(&chip8, CHIP8_TIMER_HZ - 1));
+	CU_ASSERT_EQUAL(EINVAL, chip8_set_ips(&chip8, CHIP8_MAX_IPS + 1));
+
+	chip8.mem[CHIP8_INIT_PC] = 0x12;	// 200: jump 0x200
+	chip8.mem[CHIP8_INIT_PC + 1] = 0x00;
+	chip8.delay_timer = 200;
+	chip8.sound_timer = 1;
+
+	// One emulated second
+	CU_ASSERT_EQUAL(0, chip8_set_ips(&chip8, 700));
+	CU_ASSERT_EQUAL(0, chip8_run(&chip8, 700, &exit_reason));
+	CU_ASSERT_EQUAL(200 - CHIP8_TIMER_HZ, chip8.delay_timer);
+	CU_ASSERT_EQUAL(0, chip8.sound_timer);
+	CU_ASSERT_EQUAL(0, chip8.timer_phase);
+
+	// First tick of a period lands on its last instruction
+	CU_ASSERT_EQUAL(0, chip8_run(&chip8, 11, &exit_reason));
+	CU_ASSERT_EQUAL(140, chip8.delay_timer);
+	CU_ASSERT_EQUAL(0, chip8_tick(&chip8));
+	CU_ASSERT_EQUAL(139, chip8.delay_timer);
+
+	// Rate changes keep the fraction of the period, another emulated second at 60 ticks
+	CU_ASSERT_EQUAL(0, chip8_set_ips(&chip8, CHIP8_TIMER_HZ));
+	CU_ASSERT_EQUAL(0, chip8_run(&chip8, CHIP8_TIMER_HZ, &exit_reason));
+	CU_ASSERT_EQUAL(139 - CHIP8_TIMER_HZ, chip8.delay_timer);
+
+	chip8_release(&chip8);
+}
+
+// tests that traced instructions survive a save/load round trip
+static void test_trace(void)
+{
+	struct chip8_t chip8;
+	enum chip8_exit_t exit_reason;
+	CU_ASSERT_EQUAL(0, chip8_init(&chip8));
+
+	uint8_t program[] =
+	{
+		0x60, 0x01,	// 200: V[0] = 1
+		0x70, 0x01,	// 202: V[0] += 1
+		0x12, 0x02,	// 204: jump 0x202
+	};
+	memcpy(chip8.mem + CHIP8_INIT_PC, program, sizeof(program));
+
+	// Capacity is rounded up to 4 records
+	chip8.trace = chip8_trace_create(3);
+	CU_ASSERT_PTR_NOT_NULL(chip8.trace);
+	if (chip8.trace == NULL)
+		return;
+
+	CU_ASSERT_EQUAL(0, chip8_run(&chip8, 6, &exit_reason));
+
+	FILE* file = tmpfile();
+	CU_ASSERT_EQUAL(0, chip8_trace_save(chip8.trace, file));
+	rewind(file);
+
+	struct chip8_trace_header_t header;
+	struct chip8_trace_record_t* records = NULL;
+	CU_ASSERT_EQUAL(0, chip8_trace_load(file, &header, &records));
+	fclose(file);
+
+#ifdef CHIP8_TRACE
+	// Last 4 of 6 executed instructions, oldest first
+	CU_ASSERT_EQUAL(4, header.count);
+	CU_ASSERT_EQUAL(2, header.dropped);
+	CU_ASSERT_EQUAL(2, records[0].cycle);
+	CU_ASSERT_EQUAL(0x204, records[0].pc);
+	CU_ASSERT_EQUAL(0x1202, records[0].opcode);
+	CU_ASSERT_EQUAL(5, records[3].cycle);
+	CU_ASSERT_EQUAL(0x202, records[3].pc);
+	CU_ASSERT_EQUAL(0x7001, records[3].opcode);
+#else
+	CU_ASSERT_EQUAL(0, header.count);
+	CU_ASSERT_EQUAL(0, header.dropped);
+#endif
+
+	free(records);
+	chip8_trace_destroy(chip8.trace);
+	chip8_release(&chip8);
+}
+
+// tests that restored and loaded snapshots continue exactly like the captured state
+static void test_snapshot(void)
+{
+	static struct chip8_t chip8, expected, after;
+	static struct chip8_snapshot_t snapshot, other;
+	CU_ASSERT_EQUAL(0, chip8_init(&chip8));
+
+	uint8_t program[] =
+	{
+		0xA3, 0x00,	// 200: I = 0x300
+		0xF3, 0x55,	// 202: store V0 to V3 at I
+		0x70, 0x01,	// 204: V[0] += 1
+		0xD0, 0x15,	// 206: draw 8x5 sprite at V0:V1
+		0x12, 0x02,	// 208: jump 0x202
+	};
+	memcpy(chip8.mem + CHIP8_INIT_PC, program, sizeof(program));
+	chip8.V[1] = 3;
+	chip8.V[2] = 0xFF;
+	chip8.delay_timer = 9;
+	chip8.mem[CHIP8_MEM_MASK] = 0xA5;
+
+	chip8_snapshot_capture(&snapshot, &chip8);
+	CU_ASSERT_NOT_EQUAL(0, snapshot.id);
+	CU_ASSERT_EQUAL(snapshot.id, chip8.snapshot_id);
+	CU_ASSERT_EQUAL(0, chip8.mem_dirty_pages);
+	memcpy(&expected, &chip8, sizeof(expected));
+
+	for (unsigned i = 0; i < 40; ++i)
+	{
+		CU_ASSERT_EQUAL(0, chip8_tick(&chip8));
+	}
+	memcpy(&after, &chip8, sizeof(after));
+
+	// Only the page holding 0x300 was stored to
+	CU_ASSERT_EQUAL(1ull << (0x300 >> CHIP8_MEM_PAGE_SHIFT), chip8.mem_dirty_pages);
+
+	chip8.video_update = 0;
+	chip8.video_dirty_rows = 0;
+	chip8_snapshot_restore(&chip8, &snapshot);
+	CU_ASSERT_EQUAL(0, memcmp(expected.V, chip8.V, sizeof(chip8.V)));
+	CU_ASSERT_EQUAL(expected.I, chip8.I);
+	CU_ASSERT_EQUAL(expected.PC, chip8.PC);
+	CU_ASSERT_EQUAL(expected.delay_timer, chip8.delay_timer);
+	CU_ASSERT_EQUAL(expected.timer_phase, chip8.timer_phase);
+	CU_ASSERT_EQUAL(expected.cycles, chip8.cycles);
+	CU_ASSERT_EQUAL(0, memcmp(expected.mem, chip8.mem, sizeof(chip8.mem)));
+	CU_ASSERT_EQUAL(0, memcmp(expected.video_mem, chip8.video_mem, sizeof(chip8.video_mem)));
+	CU_ASSERT_EQUAL(0, chip8.mem_dirty_pages);
+
+	// Exactly the rows that differ are marked
+	uint32_t rows = 0;
+	for (unsigned y = 0; y < CHIP8_VIDEO_HEIGHT; ++y)
+	{
+		if (after.video_mem[y] != expected.video_mem[y])
+			rows |= 1u << y;
+	}
+	CU_ASSERT_NOT_EQUAL(0, rows);
+	CU_ASSERT_EQUAL(rows, chip8.video_dirty_rows);
+	CU_ASSERT_EQUAL(1, chip8.video_update);
+
+	// Patched code is restored and predecoded again
+	chip8.mem[0x204] = 0x71;
+	chip8_invalidate(&chip8, 0x204, 1);
+	chip8_snapshot_restore(&chip8, &snapshot);
+	CU_ASSERT_EQUAL(0x70, chip8.mem[0x204]);
+
+	// Last byte of memory is captured like any other
+	chip8.mem[CHIP8_MEM_MASK] = 0x5A;
+	chip8_invalidate(&chip8, CHIP8_MEM_MASK, 1);
+	chip8_snapshot_restore(&chip8, &snapshot);
+	CU_ASSERT_EQUAL(0xA5, chip8.mem[CHIP8_MEM_MASK]);
+
+	for (unsigned i = 0; i < 40; ++i)
+	{
+		CU_ASSERT_EQUAL(0, chip8_tick(&chip8));
+	}
+	CU_ASSERT_EQUAL(0, memcmp(after.V, chip8.V, sizeof(chip8.V)));
+	CU_ASSERT_EQUAL(0, memcmp(after.mem, chip8.mem, sizeof(chip8.mem)));
+	CU_ASSERT_EQUAL(0, memcmp(after.video_mem, chip8.video_mem, sizeof(chip8.video_mem)));
+	CU_ASSERT_EQUAL(after.cycles, chip8.cycles);
+
+	// Going back to an older snapshot than the last one restores all of memory
+	chip8_snapshot_capture(&other, &chip8);
+	chip8_snapshot_restore(&chip8, &snapshot);
+	CU_ASSERT_EQUAL(0, memcmp(expected.mem, chip8.mem, sizeof(chip8.mem)));
+	chip8_snapshot_restore(&chip8, &other);
+	CU_ASSERT_EQUAL(0, memcmp(after.mem, chip8.mem, sizeof(chip8.mem)));
+
+	// File round trip
+	FILE* file = tmpfile();
+	CU_ASSERT_EQUAL(0, chip8_snapshot_save(&expected, file));
+	rewind(file);
+
+	CU_ASSERT_EQUAL(0, chip8_snapshot_load(&chip8, file));
+	CU_ASSERT_EQUAL(0, memcmp(expected.V, chip8.V, sizeof(chip8.V)));
+	CU_ASSERT_EQUAL(expected.PC, chip8.PC);
+	CU_ASSERT_EQUAL(expected.delay_timer, chip8.delay_timer);
+	CU_ASSERT_EQUAL(expected.ips, chip8.ips);
+	CU_ASSERT_EQUAL(expected.cycles, chip8.cycles);
+	CU_ASSERT_EQUAL(0, memcmp(expected.mem, chip8.mem, sizeof(chip8.mem)));
+	CU_ASSERT_EQUAL(0, memcmp(expected.video_mem, chip8.video_mem, sizeof(chip8.video_mem)));
+	CU_ASSERT_EQUAL(0, chip8.snapshot_id);
+
+	// Malformed files leave the state alone
+	rewind(file);
+	fputc(0, file);
+	rewind(file);
+	chip8.V[0] = 0x42;
+	CU_ASSERT_EQUAL(EPROTO, chip8_snapshot_load(&chip8, file));
+	CU_ASSERT_EQUAL(0x42, chip8.V[0]);
+
+	fclose(file);
+
+	// Odd PCs and PCs past memory are left by BNNN and wrap on fetch, SP past call_stack is corrupted
+	const struct { uint16_t PC, SP; int error; } states[] = 
+	{
+		{ CHIP8_INIT_PC + 1, 0, 0 }, { CHIP8_MEM_SIZE, 0, 0 }, { 0xFFFF, 0, 0 }, { CHIP8_INIT_PC, CHIP8_STACK_DEPTH, EPROTO },
+	};
+
+	for (unsigned i = 0; i < sizeof(states) / sizeof(states[0]); ++i)
+	{
+		struct chip8_t saved;
+		memcpy(&saved, &expected, sizeof(saved));
+		saved.PC = states[i].PC;
+		saved.SP = states[i].SP;
+		chip8.PC = CHIP8_INIT_PC;
+
+		file = tmpfile();
+		CU_ASSERT_EQUAL(0, chip8_snapshot_save(&saved, file));
+		rewind(file);
+		CU_ASSERT_EQUAL(states[i].error, chip8_snapshot_load(&chip8, file));
+		CU_ASSERT_EQUAL(states[i].error ? CHIP8_INIT_PC : states[i].PC, chip8.PC);
+		fclose(file);
+	}
+
+	// Running from a PC BNNN left odd round trips
+	struct chip8_t odd;
+	CU_ASSERT_EQUAL(0, chip8_init(&odd));
+	CU_ASSERT_EQUAL(0, chip8_exec(&odd, 0x6001));
+	CU_ASSERT_EQUAL(0, chip8_exec(&odd, 0xB206));
+	CU_ASSERT_EQUAL(0x207, odd.PC);
+	file = tmpfile();
+	CU_ASSERT_EQUAL(0, chip8_snapshot_save(&odd, file));
+	rewind(file);
+	CU_ASSERT_EQUAL(0, chip8_snapshot_load(&chip8, file));
+	CU_ASSERT_EQUAL(0x207, chip8.PC);
+	fclose(file);
+	chip8_release(&odd);
+
+	// Truncated
+	file = tmpfile();
+	fwrite("C8SS", 4, 1, file);
+	rewind(file);
+	CU_ASSERT_EQUAL(EPROTO, chip8_snapshot_load(&chip8, file));
+	fclose(file);
+
+	chip8_release(&chip8);
+}
+
+// tests that stepping back through rewind history returns to each recorded frame
+static void test_rewind(void)
+{
+	#define TEST_REWIND_FRAMES 20
+	static struct chip8_t chip8, frames[TEST_REWIND_FRAMES];
+	CU_ASSERT_EQUAL(0, chip8_init(&chip8));
+
+	uint8_t program[] =
+	{
+		0xA3, 0x00,	// 200: I = 0x300
+		0xF3, 0x55,	// 202: store V0 to V3 at I
+		0x70, 0x01,	// 204: V[0] += 1
+		0xD0, 0x15,	// 206: draw 8x5 sprite at V0:V1
+		0x12, 0x02,	// 208: jump 0x202
+	};
+	memcpy(chip8.mem + CHIP8_INIT_PC, program, sizeof(program));
+	chip8.delay_timer = 200;
+
+	struct chip8_rewind_t* rewind = chip8_rewind_create(64 * 1024);
+	CU_ASSERT_PTR_NOT_NULL(rewind);
+	if (rewind == NULL)
+		return;
+
+	for (unsigned frame = 0; frame < TEST_REWIND_FRAMES; ++frame)
+	{
+		for (unsigned i = 0; i < 9; ++i)
+		{
+			CU_ASSERT_EQUAL(0, chip8_tick(&chip8));
+		}
+
+		chip8_rewind_push(rewind, &chip8);
+		memcpy(&frames[frame], &chip8, sizeof(chip8));
+	}
+
+	CU_ASSERT_EQUAL(TEST_REWIND_FRAMES - 1, chip8_rewind_frames(rewind));
+
+	for (int frame = TEST_REWIND_FRAMES - 2; frame >= 0; --frame)
+	{
+		CU_ASSERT_EQUAL(0, chip8_rewind_step_back(rewind, &chip8));
+		CU_ASSERT_EQUAL(0, memcmp(frames[frame].V, chip8.V, sizeof(chip8.V)));
+		CU_ASSERT_EQUAL(frames[frame].PC, chip8.PC);
+		CU_ASSERT_EQUAL(frames[frame].delay_timer, chip8.delay_timer);
+		CU_ASSERT_EQUAL(frames[frame].cycles, chip8.cycles);
+		CU_ASSERT_EQUAL(0, memcmp(frames[frame].mem, chip8.mem, sizeof(chip8.mem)));
+		CU_ASSERT_EQUAL(0, memcmp(frames[frame].video_mem, chip8.video_mem, sizeof(chip8.video_mem)));
+	}
+
+	CU_ASSERT_EQUAL(ENOENT, chip8_rewind_step_back(rewind, &chip8));
+
+	// Recording continues from the frame stepped back to
+	for (unsigned i = 0; i < 9; ++i)
+	{
+		CU_ASSERT_EQUAL(0, chip8_tick(&chip8));
+	}
+	chip8_rewind_push(rewind, &chip8);
+	CU_ASSERT_EQUAL(0, chip8_rewind_step_back(rewind, &chip8));
+	CU_ASSERT_EQUAL(frames[0].cycles, chip8.cycles);
+	chip8_rewind_destroy(rewind);
+
+	// A small ring keeps the newest frames only, deltas wrap around its end
+	rewind = chip8_rewind_create(256);
+	CU_ASSERT_PTR_NOT_NULL(rewind);
+	if (rewind == NULL)
+		return;
+
+	for (unsigned frame = 0; frame < TEST_REWIND_FRAMES; ++frame)
+	{
+		memcpy(&chip8, &frames[frame], sizeof(chip8));
+		chip8_rewind_push(rewind, &chip8);
+	}
+
+	unsigned kept = chip8_rewind_frames(rewind);
+	CU_ASSERT(kept > 0 && kept < TEST_REWIND_FRAMES - 1);
+
+	for (unsigned frame = TEST_REWIND_FRAMES - 2; frame >= TEST_REWIND_FRAMES - 1 - kept; --frame)
+	{
+		CU_ASSERT_EQUAL(0, chip8_rewind_step_back(rewind, &chip8));
+		CU_ASSERT_EQUAL(frames[frame].cycles, chip8.cycles);
+		CU_ASSERT_EQUAL(0, memcmp(frames[frame].mem, chip8.mem, sizeof(chip8.mem)));
+		CU_ASSERT_EQUAL(0, memcmp(frames[frame].video_mem, chip8.video_mem, sizeof(chip8.video_mem)));
+	}
+
+	CU_ASSERT_EQUAL(ENOENT, chip8_rewind_step_back(rewind, &chip8));
+	chip8_rewind_destroy(rewind);
+
+	// Deltas larger than the ring drop history
+	rewind = chip8_rewind_create(8);
+	chip8_rewind_push(rewind, &frames[0]);
+	chip8_rewind_push(rewind, &frames[1]);
+	CU_ASSERT_EQUAL(0, chip8_rewind_frames(rewind));
+	chip8_rewind_destroy(rewind);
+
+	chip8_release(&chip8);
+}
+
+// tests that a replayed recording ends in the state of the recorded session
+static void test_record(void)
+{
+	static struct chip8_t chip8, replayed;
+	enum chip8_exit_t exit_reason;
+	CU_ASSERT_EQUAL(0, chip8_init(&chip8));
+
+	uint8_t program[] =
+	{
+		0xC0, 0xFF,	// 200: V[0] = rand()
+		0xF1, 0x0A,	// 202: Wait for key press into V[1]
+		0x80, 0x14,	// 204: V[0] += V[1]
+		0xE1, 0xA1,	// 206: skip if key V[1] is not pressed
+		0x72, 0x01,	// 208: V[2] += 1
+		0x12, 0x00,	// 20A: jump 0x200
+	};
+	memcpy(chip8.mem + CHIP8_INIT_PC, program, sizeof(program));
+	memcpy(&replayed, &chip8, sizeof(replayed));
+
+	struct chip8_record_t* record = chip8_record_create(1234, chip8.ips);
+	CU_ASSERT_PTR_NOT_NULL(record);
+	if (record == NULL)
+		return;
+
+	// Session with key edges between runs of odd lengths, repeated presses are not edges
+	chip8_set_seed(&chip8, 1234);
+	const unsigned keys[][3] = { { 7, 5, 1 }, { 30, 5, 1 }, { 11, 5, 0 }, { 50, 9, 1 }, { 3, 9, 0 }, { 100, 2, 1 } };
+	for (unsigned i = 0; i < sizeof(keys) / sizeof(keys[0]); ++i)
+	{
+		CU_ASSERT_EQUAL(0, chip8_run(&chip8, keys[i][0], &exit_reason));
+		CU_ASSERT_EQUAL(0, chip8_record_key(record, &chip8, keys[i][1], keys[i][2]));
+	}
+	CU_ASSERT_EQUAL(0, chip8_run(&chip8, 77, &exit_reason));
+	CU_ASSERT_EQUAL(5, record->header.count);
+
+	FILE* file = tmpfile();
+	CU_ASSERT_EQUAL(0, chip8_record_save(record, &chip8, file));
+	chip8_record_destroy(record);
+	rewind(file);
+
+	CU_ASSERT_EQUAL(0, chip8_record_load(file, &record));
+	fclose(file);
+	if (record == NULL)
+		return;
+
+	CU_ASSERT_EQUAL(1234, record->header.seed);
+	CU_ASSERT_EQUAL(chip8.cycles, record->header.cycles);
+	CU_ASSERT_EQUAL(5, record->header.count);
+
+	// Replay in differently sized slices
+	chip8_set_seed(&replayed, record->header.seed);
+	size_t next = 0;
+	while (replayed.cycles < record->header.cycles)
+	{
+		uint64_t left = record->header.cycles - replayed.cycles;
+		CU_ASSERT_EQUAL(0, chip8_record_replay(record, &next, &replayed, left < 13 ? left : 13, &exit_reason));
+	}
+
+	CU_ASSERT_EQUAL(record->header.count, next);
+	CU_ASSERT_EQUAL(0, memcmp(chip8.V, replayed.V, sizeof(chip8.V)));
+	CU_ASSERT_EQUAL(chip8.PC, replayed.PC);
+	CU_ASSERT_EQUAL(chip8.cycles, replayed.cycles);
+	CU_ASSERT_EQUAL(chip8.input_state, replayed.input_state);
+	CU_ASSERT_EQUAL(chip8.key_wait, replayed.key_wait);
+	CU_ASSERT_EQUAL(chip8.delay_timer, replayed.delay_timer);
+
+	chip8_record_destroy(record);
+
+	// Malformed files
+	file = tmpfile();
+	fwrite("C8IR", 4, 1, file);
+	rewind(file);
+	CU_ASSERT_EQUAL(EPROTO, chip8_record_load(file, &record));
+	fclose(file);
+
+	chip8_release(&chip8);
+	chip8_release(&replayed);
+}
+
+// tests that executed instructions are counted by operation and every timed one lands in a histogram
+static void test_opstats(void)
+{
+	struct chip8_t chip8;
+	enum chip8_exit_t exit_reason;
+	CU_ASSERT_EQUAL(0, chip8_init(&chip8));
+
+	CU_ASSERT_EQUAL(CHIP8_OP_00EE, chip8_op_classify(0x00EE));
+	CU_ASSERT_EQUAL(CHIP8_OP_8XY4, chip8_op_classify(0x8124));
+	CU_ASSERT_EQUAL(CHIP8_OP_8XYE, chip8_op_classify(0x812E));
+	CU_ASSERT_EQUAL(CHIP8_OP_FX33, chip8_op_classify(0xF133));
+	CU_ASSERT_EQUAL(CHIP8_OP_DXYN, chip8_op_classify(0xD125));
+	CU_ASSERT_EQUAL(CHIP8_OP_INVALID, chip8_op_classify(0x8128));
+	CU_ASSERT_EQUAL(CHIP8_OP_INVALID, chip8_op_classify(0xE100));
+	CU_ASSERT_EQUAL(0, strcmp("8XY4", chip8_op_name(CHIP8_OP_8XY4)));
+
+	uint8_t program[] =
+	{
+		0x60, 0x01,	// 200: V[0] = 1
+		0x80, 0x04,	// 202: V[0] += V[0]
+		0x12, 0x02,	// 204: jump 0x202
+	};
+	memcpy(chip8.mem + CHIP8_INIT_PC, program, sizeof(program));
+
+	chip8.opstats = chip8_opstats_create(2);
+	CU_ASSERT_PTR_NOT_NULL(chip8.opstats);
+	if (chip8.opstats == NULL)
+		return;
+
+	CU_ASSERT_EQUAL(0, chip8_run(&chip8, 9, &exit_reason));
+	CU_ASSERT_EQUAL(0, chip8_exec(&chip8, 0x8014));
+
+#ifdef CHIP8_OPSTATS
+	CU_ASSERT_EQUAL(1, chip8.opstats->counts[CHIP8_OP_6XNN]);
+	CU_ASSERT_EQUAL(5, chip8.opstats->counts[CHIP8_OP_8XY4]);
+	CU_ASSERT_EQUAL(4, chip8.opstats->counts[CHIP8_OP_1NNN]);
+
+	// Every second instruction is timed
+	uint64_t samples = 0, bucketed = 0;
+	for (unsigned op = 0; op < CHIP8_OP_COUNT; ++op)
+	{
+		samples += chip8.opstats->samples[op];
+		for (unsigned bucket = 0; bucket < CHIP8_OPSTATS_BUCKETS; ++bucket)
+		{
+			bucketed += chip8.opstats->histogram[op][bucket];
+		}
+	}
+	CU_ASSERT_EQUAL(5, samples);
+	CU_ASSERT_EQUAL(5, bucketed);
+#else
+	CU_ASSERT_EQUAL(0, chip8.opstats->counts[CHIP8_OP_8XY4]);
+#endif
+
+	FILE* file = tmpfile();
+	CU_ASSERT_EQUAL(0, chip8_opstats_dump(chip8.opstats, file));
+	fclose(file);
+
+	chip8_opstats_reset(chip8.opstats);
+	CU_ASSERT_EQUAL(0, chip8.opstats->counts[CHIP8_OP_8XY4]);
+
+	chip8_opstats_destroy(chip8.opstats);
+	chip8_release(&chip8);
+}
+
+// tests that samples are attributed to the PC and to the subroutine the call stack leads to
+static void test_profile(void)
+{
+	struct chip8_t chip8;
+	enum chip8_exit_t exit_reason;
+	CU_ASSERT_EQUAL(0, chip8_init(&chip8));
+
+	uint8_t program[] =
+	{
+		0x22, 0x06,	// 200: call 0x206
+		0x12, 0x00,	// 202: jump 0x200
+		0x00, 0x00,	// 204:
+		0x70, 0x01,	// 206: V[0] += 1
+		0x00, 0xEE,	// 208: return
+	};
+	memcpy(chip8.mem + CHIP8_INIT_PC, program, sizeof(program));
+
+	CU_ASSERT_PTR_NULL(chip8_profile_create(0));
+
+	// Every instruction is sampled
+	struct chip8_profile_t* profile = chip8_profile_create(1);
+	CU_ASSERT_PTR_NOT_NULL(profile);
+	if (profile == NULL)
+		return;
+
+	CU_ASSERT_EQUAL(0, chip8_profile_run(profile, &chip8, 40, &exit_reason));
+	CU_ASSERT_EQUAL(CHIP8_EXIT_CYCLES, exit_reason);
+	CU_ASSERT_EQUAL(40, chip8.cycles);
+	CU_ASSERT_EQUAL(10, chip8_profile_hits(profile, 0x200));
+	CU_ASSERT_EQUAL(10, chip8_profile_hits(profile, 0x206));
+	CU_ASSERT_EQUAL(0, chip8_profile_hits(profile, 0x204));
+
+	// Budgets cut short still land on the sample points
+	uint64_t start = chip8.cycles;
+	CU_ASSERT_EQUAL(1, chip8_profile_budget(profile, 100));
+	CU_ASSERT_EQUAL(0, chip8_run(&chip8, chip8_profile_budget(profile, 100), &exit_reason));
+	CU_ASSERT_EQUAL(0, chip8_profile_advance(profile, &chip8, start));
+	CU_ASSERT_EQUAL(11, chip8_profile_hits(profile, 0x206));
+
+	FILE* file = tmpfile();
+	CU_ASSERT_EQUAL(0, chip8_profile_save_folded(profile, file));
+	rewind(file);
+
+	char line[64];
+	unsigned long main_count = 0, sub_count = 0;
+	while (fgets(line, sizeof(line), file))
+	{
+		if (strncmp(line, "main;sub_206 ", 13) == 0)
+			sub_count = strtoul(line + 13, NULL, 10);
+		else if (strncmp(line, "main ", 5) == 0)
+			main_count = strtoul(line + 5, NULL, 10);
+	}
+	fclose(file);
+
+	CU_ASSERT_EQUAL(20, main_count);
+	CU_ASSERT_EQUAL(21, sub_count);
+
+	file = tmpfile();
+	CU_ASSERT_EQUAL(0, chip8_profile_save_listing(profile, &chip8, file));
+	fclose(file);
+
+	chip8_profile_destroy(profile);
+	chip8_release(&chip8);
+}
+
+// tests that ROM files are mapped once per path and once per distinct content
+static void test_rom(void)
+{
+	const char* paths[] = { "test_rom_a.ch8", "test_rom_b.ch8", "test_rom_big.ch8" };
+	uint8_t program[] = { 0x60, 0x2A, 0x12, 0x02 };	// V[0] = 0x2A, loop
+
+	for (unsigned i = 0; i < 3; ++i)
+	{
+		FILE* file = fopen(paths[i], "wb");
+		CU_ASSERT_PTR_NOT_NULL(file);
+		if (file == NULL)
+			return;
+
+		fwrite(program, 1, sizeof(program), file);
+		for (unsigned size = sizeof(program); i == 2 && size <= CHIP8_RAM_SIZE; ++size)
+		{
+			fputc(0, file);
+		}
+
+		fclose(file);
+	}
+
+	struct chip8_rom_cache_t* cache = chip8_rom_cache_create();
+	CU_ASSERT_PTR_NOT_NULL(cache);
+	if (cache == NULL)
+		return;
+
+	const struct chip8_rom_t* a;
+	const struct chip8_rom_t* again;
+	const struct chip8_rom_t* b;
+	const struct chip8_rom_t* big;
+	CU_ASSERT_EQUAL(0, chip8_rom_cache_load(cache, paths[0], &a));
+	CU_ASSERT_EQUAL(sizeof(program), a->size);
+	CU_ASSERT_EQUAL(0, memcmp(program, a->data, sizeof(program)));
+
+	// Repeat loads hit the path table, equal content shares the image
+	CU_ASSERT_EQUAL(0, chip8_rom_cache_load(cache, paths[0], &again));
+	CU_ASSERT_EQUAL(a, again);
+	CU_ASSERT_EQUAL(0, chip8_rom_cache_load(cache, paths[1], &b));
+	CU_ASSERT_EQUAL(a, b);
+	CU_ASSERT_EQUAL(1, chip8_rom_cache_images(cache));
+
+	CU_ASSERT_EQUAL(ENOSPC, chip8_rom_cache_load(cache, paths[2], &big));
+	CU_ASSERT_EQUAL(ENOENT, chip8_rom_cache_load(cache, "test_rom_missing.ch8", &big));
+	CU_ASSERT_EQUAL(1, chip8_rom_cache_images(cache));
+
+	// Instances get private copies
+	struct chip8_t chip8;
+	enum chip8_exit_t exit_reason;
+	CU_ASSERT_EQUAL(0, chip8_init_rom(&chip8, a));
+	CU_ASSERT_EQUAL(0, chip8_run(&chip8, 2, &exit_reason));
+	CU_ASSERT_EQUAL(0x2A, chip8.V[0]);
+
+	chip8.mem[CHIP8_INIT_PC + 1] = 0x55;
+	CU_ASSERT_EQUAL(0x2A, a->data[1]);
+
+	CU_ASSERT_EQUAL(ENOSPC, chip8_load_image(&chip8, a->data, CHIP8_RAM_SIZE + 1));
+
+	chip8_release(&chip8);
+	chip8_rom_cache_destroy(cache);
+
+	for (unsigned i = 0; i < 3; ++i)
+	{
+		remove(paths[i]);
+	}
+}
+
+
+// tests that stores into executed code are reported and seen by the decode cache
+static void test_stale_code(void)
+{
+	struct chip8_t chip8;
+	struct chip8_range_t ranges[CHIP8_MEM_PAGES / 2];
+	CU_ASSERT_EQUAL(0, chip8_init(&chip8));
+
+	uint8_t program[] =
+	{
+		0xA2, 0x0A,	// 200: I = 0x20A
+		0x60, 0x73,	// 202: V[0] = 0x73
+		0x61, 0x05,	// 204: V[1] = 0x05
+		0x12, 0x0A,	// 206: jump 0x20A
+		0xF1, 0x55,	// 208: patch 0x20A into V[3] += 5
+		0x73, 0x01,	// 20A: V[3] += 1
+		0x33, 0x06,	// 20C: skip if V[3] == 6
+		0x12, 0x08,	// 20E: jump 0x208
+		0x12, 0x10,	// 210: loop
+	};
+	CU_ASSERT_EQUAL(0, chip8_load_image(&chip8, program, sizeof(program)));
+	CU_ASSERT_EQUAL(0, chip8_take_stale_code(&chip8, ranges, CHIP8_MEM_PAGES / 2));
+
+	for (unsigned i = 0; i < 10; ++i)
+	{
+		CU_ASSERT_EQUAL(0, chip8_tick(&chip8));
+	}
+
+	CU_ASSERT_EQUAL(6, chip8.V[3]);
+	CU_ASSERT_EQUAL(0x210, chip8.PC);
+
+	CU_ASSERT_EQUAL(1, chip8_take_stale_code(&chip8, ranges, CHIP8_MEM_PAGES / 2));
+	CU_ASSERT_EQUAL(0x200, ranges[0].addr);
+	CU_ASSERT_EQUAL(CHIP8_MEM_PAGE_SIZE, ranges[0].size);
+	CU_ASSERT_EQUAL(0, chip8_take_stale_code(&chip8, ranges, CHIP8_MEM_PAGES / 2));
+
+	// Data pages are not code
+	CU_ASSERT_EQUAL(0, chip8_exec(&chip8, 0xA300));
+	CU_ASSERT_EQUAL(0, chip8_exec(&chip8, 0xF155));
+	CU_ASSERT_EQUAL(0, chip8_take_stale_code(&chip8, ranges, CHIP8_MEM_PAGES / 2));
+
+	// Adjacent pages merge, ranges that do not fit wait
+	chip8.stale_pages = (3ull << (0x200 / CHIP8_MEM_PAGE_SIZE)) | (1ull << (0x300 / CHIP8_MEM_PAGE_SIZE)) | (1ull << 63);
+	CU_ASSERT_EQUAL(1, chip8_take_stale_code(&chip8, ranges, 1));
+	CU_ASSERT_EQUAL(0x200, ranges[0].addr);
+	CU_ASSERT_EQUAL(2 * CHIP8_MEM_PAGE_SIZE, ranges[0].size);
+	CU_ASSERT_EQUAL(2, chip8_take_stale_code(&chip8, ranges, CHIP8_MEM_PAGES / 2));
+	CU_ASSERT_EQUAL(0x300, ranges[0].addr);
+	CU_ASSERT_EQUAL(CHIP8_MEM_SIZE - CHIP8_MEM_PAGE_SIZE, ranges[1].addr);
+	CU_ASSERT_EQUAL(CHIP8_MEM_PAGE_SIZE, ranges[1].size);
+
+	chip8.stale_pages = ~0ull;
+	CU_ASSERT_EQUAL(1, chip8_take_stale_code(&chip8, ranges, CHIP8_MEM_PAGES / 2));
+	CU_ASSERT_EQUAL(0, ranges[0].addr);
+	CU_ASSERT_EQUAL(CHIP8_MEM_SIZE, ranges[0].size);
+
+	chip8_release(&chip8);
+}
+
+// tests that idle loops skipped by chip8_run end in the state stepping them one by one does
+static void test_idle(void)
+{
+	struct chip8_t chip8, expected;
+	enum chip8_exit_t exit_reason;
+
+	uint8_t program[] =
+	{
+		0x60, 0x1E,	// 200: V[0] = 30
+		0xF0, 0x15,	// 202: delay timer = V[0]
+		0xF1, 0x07,	// 204: V[1] = delay timer
+		0x31, 0x00,	// 206: skip if V[1] == 0
+		0x12, 0x04,	// 208: jump 0x204
+		0x62, 0x05,	// 20A: V[2] = 5
+		0xE2, 0x9E,	// 20C: skip if key V[2] is pressed
+		0x12, 0x0C,	// 20E: jump 0x20C
+		0x72, 0x01,	// 210: V[2] += 1
+		0x12, 0x12,	// 212: loop
+	};
+
+	static const uint32_t ips[] = { CHIP8_TIMER_HZ, CHIP8_DEFAULT_IPS, 733, 20000 };
+	for (unsigned i = 0; i < sizeof(ips) / sizeof(ips[0]); ++i)
+	{
+		CU_ASSERT_EQUAL(0, chip8_init(&chip8));
+		CU_ASSERT_EQUAL(0, chip8_set_ips(&chip8, ips[i]));
+		CU_ASSERT_EQUAL(0, chip8_load_image(&chip8, program, sizeof(program)));
+		memcpy(&expected, &chip8, sizeof(chip8));
+
+		// Budgets of every length end inside and outside of the loops
+		unsigned long budget = 1;
+		while (expected.PC != 0x212 && expected.cycles < 10 * ips[i])
+		{
+			if (expected.PC == 0x20C && expected.cycles > 2 * ips[i])
+			{
+				chip8_set_key_state(&chip8, 5, 1);
+				chip8_set_key_state(&expected, 5, 1);
+			}
+
+			budget = budget % 97 + 1;
+			CU_ASSERT_EQUAL(0, chip8_run(&chip8, budget, &exit_reason));
+			CU_ASSERT_EQUAL(CHIP8_EXIT_CYCLES, exit_reason);
+
+			int error = 0;
+			for (unsigned long cycle = 0; cycle < budget; ++cycle)
+			{
+				error |= chip8_tick(&expected);
+			}
+
+			CU_ASSERT_EQUAL(0, error);
+
+			CU_ASSERT_EQUAL(0, memcmp(expected.V, chip8.V, sizeof(chip8.V)));
+			CU_ASSERT_EQUAL(expected.PC, chip8.PC);
+			CU_ASSERT_EQUAL(expected.delay_timer, chip8.delay_timer);
+			CU_ASSERT_EQUAL(expected.timer_phase, chip8.timer_phase);
+			CU_ASSERT_EQUAL(expected.cycles, chip8.cycles);
+		}
+
+		CU_ASSERT_EQUAL(0x212, chip8.PC);
+		CU_ASSERT_EQUAL(6, chip8.V[2]);
+
+		// Jumps to themselves take any budget at once
+		CU_ASSERT_EQUAL(0, chip8_run(&chip8, 1ul << 40, &exit_reason));
+		CU_ASSERT_EQUAL(CHIP8_EXIT_CYCLES, exit_reason);
+		CU_ASSERT_EQUAL(expected.cycles + (1ull << 40), chip8.cycles);
+		CU_ASSERT_EQUAL(0x212, chip8.PC);
+
+		chip8_release(&chip8);
+		chip8_release(&expected);
+	}
+}
+
+// tests that lockstep lanes end up in the same state as separately interpreted instances
+static void test_batch(void)
+{
+	struct chip8_t base, expected, chip8;
+	CU_ASSERT_EQUAL(0, chip8_init(&base));
+
+	uint8_t program[] =
+	{
+		0xA3, 0x00,	// 200: I = 0x300
+		0x70, 0x01,	// 202: V[0] += 1
+		0x81, 0x04,	// 204: V[1] += V[0]
+		0x40, 0x03,	// 206: skip if V[0] != 3
+		0x22, 0x20,	// 208: call 0x220
+		0x82, 0x16,	// 20A: V[2] >>= 1
+		0xF1, 0x55,	// 20C: store V[0], V[1] at I
+		0xD0, 0x15,	// 20E: draw 8x5 sprite from I at V[0]:V[1]
+		0x90, 0x10,	// 210: skip if V[0] != V[1]
+		0x60, 0x00,	// 212: V[0] = 0
+		0x64, 0x0F,	// 214: V[4] = 0xF
+		0x84, 0x02,	// 216: V[4] &= V[0]
+		0xE4, 0x9E,	// 218: skip if key V[4] is pressed
+		0x12, 0x02,	// 21A: jump 0x202
+		0x7B, 0x01,	// 21C: V[B] += 1
+		0x12, 0x02,	// 21E: jump 0x202
+		0x72, 0x05,	// 220: V[2] += 5
+		0xF2, 0x1E,	// 222: I += V[2]
+		0xF2, 0x15,	// 224: delay timer = V[2]
+		0xF3, 0x07,	// 226: V[3] = delay timer
+		0xA3, 0x00,	// 228: I = 0x300
+		0x00, 0xEE,	// 22A: return
+		0x00, 0x00,	// 22C:
+		0x00, 0x00,	// 22E:
+		0xF5, 0x0A,	// 230: wait for key press into V[5]
+		0x66, 0x01,	// 232: V[6] = 1
+		0xFF, 0xFF,	// 234: Invalid
+	};
+	memcpy(base.mem + CHIP8_INIT_PC, program, sizeof(program));
+
+	// Lanes diverge on V[0] and pressed keys, spanning more than one group
+	const unsigned lanes = CHIP8_BATCH_WIDTH + 3;
+	struct chip8_batch_t* batch = chip8_batch_create(lanes);
+	CU_ASSERT_PTR_NOT_NULL(batch);
+	if (batch == NULL)
+		return;
+
+	CU_ASSERT_EQUAL(lanes, chip8_batch_count(batch));
+
+	for (unsigned lane = 0; lane < lanes; ++lane)
+	{
+		memcpy(&chip8, &base, sizeof(chip8));
+		chip8.V[0] = lane * 3;
+		chip8.input_state = (uint16_t)(lane * 0x1234);
+		chip8_set_ips(&chip8, CHIP8_TIMER_HZ + lane * 37);
+		chip8_batch_set(batch, lane, &chip8);
+	}
+
+	enum chip8_exit_t exit_reasons[lanes];
+	int errors[lanes];
+	CU_ASSERT_EQUAL(0, chip8_batch_run(batch, 1000, exit_reasons, errors));
+
+	for (unsigned lane = 0; lane < lanes; ++lane)
+	{
+		memcpy(&expected, &base, sizeof(expected));
+		expected.V[0] = lane * 3;
+		expected.input_state = (uint16_t)(lane * 0x1234);
+		chip8_set_ips(&expected, CHIP8_TIMER_HZ + lane * 37);
+
+		for (unsigned i = 0; i < 1000; ++i)
+		{
+			CU_ASSERT_EQUAL(0, chip8_tick(&expected));
+		}
+
+		chip8_batch_get(batch, lane, &chip8);
+		CU_ASSERT_EQUAL(CHIP8_EXIT_CYCLES, exit_reasons[lane]);
+		CU_ASSERT_EQUAL(0, errors[lane]);
+		CU_ASSERT_EQUAL(0, memcmp(expected.V, chip8.V, sizeof(chip8.V)));
+		CU_ASSERT_EQUAL(expected.I, chip8.I);
+		CU_ASSERT_EQUAL(expected.PC, chip8.PC);
+		CU_ASSERT_EQUAL(expected.SP, chip8.SP);
+		CU_ASSERT_EQUAL(expected.delay_timer, chip8.delay_timer);
+		CU_ASSERT_EQUAL(expected.timer_phase, chip8.timer_phase);
+		CU_ASSERT_EQUAL(expected.cycles, chip8.cycles);
+		CU_ASSERT_EQUAL(0, memcmp(expected.mem, chip8.mem, sizeof(chip8.mem)));
+		CU_ASSERT_EQUAL(0, memcmp(expected.video_mem, chip8.video_mem, sizeof(chip8.video_mem)));
+	}
+
+	// Lane 0 halts waiting for a key, lane 1 fails
+	memcpy(&chip8, &base, sizeof(chip8));
+	chip8.PC = 0x234;
+	chip8_batch_set(batch, 1, &chip8);
+	chip8.PC = 0x230;
+	chip8.delay_timer = 100;
+	chip8_set_ips(&chip8, CHIP8_TIMER_HZ);
+	chip8_batch_set(batch, 0, &chip8);
+
+	CU_ASSERT_EQUAL(0, chip8_batch_run(batch, 10, exit_reasons, errors));
+	CU_ASSERT_EQUAL(CHIP8_EXIT_KEY_WAIT, exit_reasons[0]);
+	CU_ASSERT_EQUAL(CHIP8_EXIT_ERROR, exit_reasons[1]);
+	CU_ASSERT_EQUAL(EINVAL, errors[1]);
+	CU_ASSERT_EQUAL(CHIP8_EXIT_CYCLES, exit_reasons[2]);
+
+	// Still halted without a key press, timers keep running
+	CU_ASSERT_EQUAL(0, chip8_batch_run(batch, 10, exit_reasons, NULL));
+	CU_ASSERT_EQUAL(CHIP8_EXIT_KEY_WAIT, exit_reasons[0]);
+	chip8_batch_get(batch, 0, &chip8);
+	CU_ASSERT_EQUAL(0x232, chip8.PC);
+	CU_ASSERT_EQUAL(base.cycles + 20, chip8.cycles);
+	CU_ASSERT_EQUAL(80, chip8.delay_timer);
+	CU_ASSERT_EQUAL(1, chip8.key_wait);
+
+	chip8_batch_set_key_state(batch, 0, 7, 1);
+	CU_ASSERT_EQUAL(0, chip8_batch_run(batch, 1, exit_reasons, NULL));
+	CU_ASSERT_EQUAL(CHIP8_EXIT_CYCLES, exit_reasons[0]);
+	chip8_batch_get(batch, 0, &chip8);
+	CU_ASSERT_EQUAL(7, chip8.V[5]);
+	CU_ASSERT_EQUAL(1, chip8.V[6]);
+	CU_ASSERT_EQUAL(0x234, chip8.PC);
+	CU_ASSERT_EQUAL(0, chip8.key_wait);
+
+	chip8_batch_destroy(batch);
+	chip8_release(&chip8);
+	chip8_release(&expected);
+	chip8_release(&base);
+}
+
+// tests that lanes own only the memory pages they store to
+static void test_batch_pages(void)
+{
+	struct chip8_t chip8;
+	enum chip8_exit_t exit_reasons[2];
+	CU_ASSERT_EQUAL(0, chip8_init(&chip8));
+
+	uint8_t program[] =
+	{
+		0xA3, 0xFF,	// 200: I = 0x3FF
+		0x60, 0x11,	// 202: V[0] = 0x11
+		0x61, 0x22,	// 204: V[1] = 0x22
+		0xF1, 0x55,	// 206: store V[0] and V[1] at 0x3FF, straddling two pages
+		0x12, 0x08,	// 208: loop
+	};
+	memcpy(chip8.mem + CHIP8_INIT_PC, program, sizeof(program));
+
+	struct chip8_batch_t* batch = chip8_batch_create(2);
+	CU_ASSERT_PTR_NOT_NULL(batch);
+	if (batch == NULL)
+		return;
+
+	CU_ASSERT_EQUAL(0, chip8_batch_set(batch, 0, &chip8));
+	chip8.PC = 0x208;
+	CU_ASSERT_EQUAL(0, chip8_batch_set(batch, 1, &chip8));
+	CU_ASSERT_EQUAL(0, chip8_batch_private_pages(batch, 0));
+
+	CU_ASSERT_EQUAL(0, chip8_batch_run(batch, 10, exit_reasons, NULL));
+	CU_ASSERT_EQUAL(2, chip8_batch_private_pages(batch, 0));
+	CU_ASSERT_EQUAL(0, chip8_batch_private_pages(batch, 1));
+
+	// Stores landed in the copies, the other lane still reads the shared pages
+	chip8_batch_get(batch, 0, &chip8);
+	CU_ASSERT_EQUAL(0x11, chip8.mem[0x3FF]);
+	CU_ASSERT_EQUAL(0x22, chip8.mem[0x400]);
+	chip8_batch_get(batch, 1, &chip8);
+	CU_ASSERT_EQUAL(0, chip8.mem[0x3FF]);
+	CU_ASSERT_EQUAL(0, chip8.mem[0x400]);
+
+	// Setting a lane shares its pages again
+	CU_ASSERT_EQUAL(0, chip8_batch_set(batch, 0, &chip8));
+	CU_ASSERT_EQUAL(0, chip8_batch_private_pages(batch, 0));
+
+	chip8_batch_destroy(batch);
+	chip8_release(&chip8);
+}
+
+
 //////////////////////////////////////////////////////////////
 //
 //	chip8 opcode tests
@@ -114,6 +1344,59 @@ static void test_invalid_opcode(void)
 	chip8_release(&chip8);
 }
 
+// Guest addresses past the end of memory wrap around to 0
+static void test_mem_wrap(void)
+{
+	struct chip8_t chip8;
+	CU_ASSERT_EQUAL(0, chip8_init(&chip8));
+
+	// Predecode an instruction at 0
+	chip8.mem[0] = 0x60;
+	chip8.mem[1] = 0x12;
+	chip8.PC = 0;
+	CU_ASSERT_EQUAL(0, chip8_tick(&chip8));
+	CU_ASSERT_EQUAL(0x12, chip8.V[0]);
+
+	// FX55 running off the end rewrites it
+	chip8.V[0] = 0xAA;
+	chip8.V[1] = 0xBB;
+	chip8.V[2] = 0x61;
+	chip8.V[3] = 0x34;
+	chip8.I = 0xFFFE;
+	CU_ASSERT_EQUAL(0, chip8_exec(&chip8, 0xF355));
+	CU_ASSERT_EQUAL(0xAA, chip8.mem[CHIP8_MEM_MASK - 1]);
+	CU_ASSERT_EQUAL(0xBB, chip8.mem[CHIP8_MEM_MASK]);
+	CU_ASSERT_EQUAL(0x61, chip8.mem[0]);
+	CU_ASSERT_EQUAL(0x34, chip8.mem[1]);
+
+	chip8.PC = 0;
+	CU_ASSERT_EQUAL(0, chip8_tick(&chip8));
+	CU_ASSERT_EQUAL(0x34, chip8.V[1]);
+
+	// FX65 and FX33 wrap the same way
+	memset(chip8.V, 0, sizeof(chip8.V));
+	CU_ASSERT_EQUAL(0, chip8_exec(&chip8, 0xF365));
+	CU_ASSERT_EQUAL(0xAA, chip8.V[0]);
+	CU_ASSERT_EQUAL(0xBB, chip8.V[1]);
+	CU_ASSERT_EQUAL(0x61, chip8.V[2]);
+	CU_ASSERT_EQUAL(0x34, chip8.V[3]);
+
+	chip8.V[0] = 123;
+	chip8.I = 0xFFFF;
+	CU_ASSERT_EQUAL(0, chip8_exec(&chip8, 0xF033));
+	CU_ASSERT_EQUAL(1, chip8.mem[CHIP8_MEM_MASK]);
+	CU_ASSERT_EQUAL(2, chip8.mem[0]);
+	CU_ASSERT_EQUAL(3, chip8.mem[1]);
+
+	// Calls past the stack depth wrap SP around call_stack
+	chip8.SP = CHIP8_STACK_MASK;
+	CU_ASSERT_EQUAL(0, chip8_exec(&chip8, 0x2ABC));
+	CU_ASSERT_EQUAL(0, chip8.SP);
+	CU_ASSERT_EQUAL(0, chip8_exec(&chip8, 0x00EE));
+	CU_ASSERT_EQUAL(CHIP8_STACK_MASK, chip8.SP);
+
+	chip8_release(&chip8);
+}
 
 // Not supported by modern interpreters
 static void test_0000(void)
@@ -616,13 +1899,121 @@ static void test_CXXX(void)
 	opcode = 0xCA0F;
 	CU_ASSERT_EQUAL(0, chip8_exec(&chip8, opcode));
 	CU_ASSERT_TRUE(chip8.V[0xA] <= 0xF);
-	
+
+	// NN masks the random byte
+	uint8_t seen = 0;
+	for (unsigned i = 0; i < 64; ++i)
+	{
+		CU_ASSERT_EQUAL(0, chip8_exec(&chip8, 0xCAA5));
+		CU_ASSERT_EQUAL(0, chip8.V[0xA] & ~0xA5);
+		seen |= chip8.V[0xA];
+	}
+	CU_ASSERT_EQUAL(0xA5, seen);
+
+	// Same seed draws the same numbers in every instance, through snapshots and batch lanes
+	static struct chip8_t other;
+	static struct chip8_snapshot_t snapshot;
+	CU_ASSERT_EQUAL(0, chip8_init(&other));
+	chip8_set_seed(&chip8, 42);
+	chip8_set_seed(&other, 42);
+
+	uint8_t program[] =
+	{
+		0xC0, 0xFF,	// 200: V[0] = rand()
+		0xC1, 0x0F,	// 202: V[1] = rand() & 0x0F
+		0x12, 0x00,	// 204: jump 0x200
+	};
+	memcpy(chip8.mem + CHIP8_INIT_PC, program, sizeof(program));
+	memcpy(other.mem + CHIP8_INIT_PC, program, sizeof(program));
+	chip8.PC = CHIP8_INIT_PC;
+
+	struct chip8_batch_t* batch = chip8_batch_create(1);
+	CU_ASSERT_PTR_NOT_NULL(batch);
+	if (batch == NULL)
+		return;
+	chip8_batch_set(batch, 0, &chip8);
+
+	enum chip8_exit_t exit_reason;
+	CU_ASSERT_EQUAL(0, chip8_run(&chip8, 5, &exit_reason));
+	chip8_snapshot_capture(&snapshot, &chip8);
+	CU_ASSERT_EQUAL(0, chip8_run(&chip8, 7, &exit_reason));
+	uint8_t v0 = chip8.V[0], v1 = chip8.V[1];
+
+	chip8_snapshot_restore(&chip8, &snapshot);
+	CU_ASSERT_EQUAL(0, chip8_run(&chip8, 7, &exit_reason));
+	CU_ASSERT_EQUAL(v0, chip8.V[0]);
+	CU_ASSERT_EQUAL(v1, chip8.V[1]);
+
+	CU_ASSERT_EQUAL(0, chip8_run(&other, 12, &exit_reason));
+	CU_ASSERT_EQUAL(v0, other.V[0]);
+	CU_ASSERT_EQUAL(v1, other.V[1]);
+
+	int errors[1];
+	enum chip8_exit_t exit_reasons[1];
+	CU_ASSERT_EQUAL(0, chip8_batch_run(batch, 12, exit_reasons, errors));
+	chip8_batch_get(batch, 0, &other);
+	CU_ASSERT_EQUAL(v0, other.V[0]);
+	CU_ASSERT_EQUAL(v1, other.V[1]);
+	CU_ASSERT_EQUAL(chip8.rng_state, other.rng_state);
+
+	chip8_batch_destroy(batch);
+	chip8_release(&other);
 	chip8_release(&chip8);
 }
 
 static void test_DXYN(void)
 {
+	struct chip8_t chip8;
+	CU_ASSERT_EQUAL(0, chip8_init(&chip8));
+
+	const uint64_t* rows = chip8_get_video_rows(&chip8);
+
+	// Font glyph "0" at 0:0
+	chip8.I = 0;
+	chip8.V[0] = 0;
+	chip8.V[1] = 0;
+	CU_ASSERT_EQUAL(0, chip8_exec(&chip8, 0xD015));
+	CU_ASSERT_EQUAL(0xF000000000000000ull, rows[0]);
+	CU_ASSERT_EQUAL(0x9000000000000000ull, rows[1]);
+	CU_ASSERT_EQUAL(0xF000000000000000ull, rows[4]);
+	CU_ASSERT_EQUAL(1, CHIP8_VIDEO_PIXEL(rows[1], 3));
+	CU_ASSERT_EQUAL(0, CHIP8_VIDEO_PIXEL(rows[1], 4));
+	CU_ASSERT_EQUAL(0, chip8.V[CHIP8_VF]);
+	CU_ASSERT_TRUE(chip8.video_update);
+	CU_ASSERT_EQUAL(0x1F, chip8.video_dirty_rows);
+
+	// Drawing it again erases it and reports collision
+	CU_ASSERT_EQUAL(0, chip8_exec(&chip8, 0xD015));
+	CU_ASSERT_TRUE(memisset(chip8.video_mem, 0, sizeof(chip8.video_mem)));
+	CU_ASSERT_EQUAL(1, chip8.V[CHIP8_VF]);
+
+	// Wraps around right and bottom edges
+	chip8.video_dirty_rows = 0;
+	chip8.V[0] = 62;
+	chip8.V[1] = 30;
+	CU_ASSERT_EQUAL(0, chip8_exec(&chip8, 0xD015));
+	CU_ASSERT_EQUAL(0xC0000007, chip8.video_dirty_rows);
+	CU_ASSERT_EQUAL(0xC000000000000003ull, rows[30]);
+	CU_ASSERT_EQUAL(0x4000000000000002ull, rows[31]);
+	CU_ASSERT_EQUAL(0x4000000000000002ull, rows[0]);
+	CU_ASSERT_EQUAL(0xC000000000000003ull, rows[2]);
+	CU_ASSERT_EQUAL(0, rows[3]);
+	CU_ASSERT_EQUAL(0, chip8.V[CHIP8_VF]);
+
+	// Blank sprite lines leave their rows clean
+	chip8.video_dirty_rows = 0;
+	chip8.I = 0x300;
+	chip8.mem[0x301] = 0x81;
+	chip8.V[1] = 31;
+	CU_ASSERT_EQUAL(0, chip8_exec(&chip8, 0xD013));
+	CU_ASSERT_EQUAL(1, chip8.video_dirty_rows);
+
+	// Clearing marks every row
+	chip8.video_dirty_rows = 0;
+	CU_ASSERT_EQUAL(0, chip8_exec(&chip8, 0x00E0));
+	CU_ASSERT_EQUAL(CHIP8_ALL_ROWS, chip8.video_dirty_rows);
 
+	chip8_release(&chip8);
 }
 
 static void test_EX9E(void)
@@ -682,27 +2073,32 @@ static void test_FX07(void)
 	chip8_release(&chip8);
 }
 
-static struct chip8_t* g_FX0A_chip8;
-static void alarm_handler(int signo)
-{
-	chip8_set_key_state(g_FX0A_chip8, 0xA, 1);
-}
-
 // FX0A - wait for a key press and register it in VX
 static void test_FX0A(void)
 {
 	struct chip8_t chip8;
 	CU_ASSERT_EQUAL(0, chip8_init(&chip8));
 	
-	// Instruction will block for a key press event, use alarm signal to actually send it
-	g_FX0A_chip8 = &chip8;
-	signal(SIGALRM, alarm_handler);
-	alarm(1);
+	// Instruction halts the CPU, the next key press completes it
+	chip8_set_key_state(&chip8, 0x3, 1);
 
 	uint16_t opcode = 0xFA0A;
 	CU_ASSERT_EQUAL(0, chip8_exec(&chip8, opcode));
+	CU_ASSERT_EQUAL(1, chip8.key_wait);
+
+	// Keys held already or released do not count
+	chip8_set_key_state(&chip8, 0x3, 1);
+	chip8_set_key_state(&chip8, 0x3, 0);
+	CU_ASSERT_EQUAL(1, chip8.key_wait);
+
+	chip8_set_key_state(&chip8, 0xA, 1);
+	CU_ASSERT_EQUAL(0, chip8.key_wait);
 	CU_ASSERT_EQUAL(chip8.V[0xA], 0xA);	
 
+	// Later presses leave VX alone
+	chip8_set_key_state(&chip8, 0x5, 1);
+	CU_ASSERT_EQUAL(chip8.V[0xA], 0xA);
+
 	chip8_release(&chip8);
 }
 
@@ -883,7 +2279,24 @@ int main(void)
    	/* add the tests to the suite */
    	/* NOTE - ORDER IS IMPORTANT - MUST TEST fread() AFTER fprintf() */
    	(void)CU_add_test(pSuite, "chip8_init", test_init);
+   	(void)CU_add_test(pSuite, "chip8_decode_cache", test_decode_cache);
+   	(void)CU_add_test(pSuite, "chip8_stale_code", test_stale_code);
+   	(void)CU_add_test(pSuite, "chip8_idle", test_idle);
+   	(void)CU_add_test(pSuite, "chip8_jit", test_jit);
+   	(void)CU_add_test(pSuite, "chip8_aot", test_aot);
+   	(void)CU_add_test(pSuite, "chip8_run", test_run);
+   	(void)CU_add_test(pSuite, "chip8_timers", test_timers);
+   	(void)CU_add_test(pSuite, "chip8_trace", test_trace);
+   	(void)CU_add_test(pSuite, "chip8_snapshot", test_snapshot);
+   	(void)CU_add_test(pSuite, "chip8_rewind", test_rewind);
+   	(void)CU_add_test(pSuite, "chip8_record", test_record);
+   	(void)CU_add_test(pSuite, "chip8_opstats", test_opstats);
+   	(void)CU_add_test(pSuite, "chip8_profile", test_profile);
+   	(void)CU_add_test(pSuite, "chip8_rom", test_rom);
+   	(void)CU_add_test(pSuite, "chip8_batch", test_batch);
+   	(void)CU_add_test(pSuite, "chip8_batch_pages", test_batch_pages);
    	(void)CU_add_test(pSuite, "chip8_invalid_opcode", test_invalid_opcode);
+   	(void)CU_add_test(pSuite, "chip8_mem_wrap", test_mem_wrap);
 
 	(void)CU_add_test(pSuite, "chip8_0000", test_0000);
 	(void)CU_add_test(pSuite, "chip8_00E0", test_00E0);
@@ -908,6 +2321,7 @@ int main(void)
 	(void)CU_add_test(pSuite, "chip8_AXXX", test_AXXX);
 	(void)CU_add_test(pSuite, "chip8_BXXX", test_BXXX);
 	(void)CU_add_test(pSuite, "chip8_CXXX", test_CXXX);
+	(void)CU_add_test(pSuite, "chip8_DXYN", test_DXYN);
 	(void)CU_add_test(pSuite, "chip8_EX9E", test_EX9E);
 	(void)CU_add_test(pSuite, "chip8_EXA1", test_EXA1);
 	(void)CU_add_test(pSuite, "chip8_FX07", test_FX07);
@@ -0,0 +1,70 @@
+/*
+ * =====================================================================================
+ *
+ *       Filename:  trace.c
+ *
+ *    Description:  chip8-trace, prints execution trace files written by chip8_trace_save
+ *
+ *        Version:  1.0
+ *        Created:  10/17/2026 16:41:05
+ *
+ * =====================================================================================
+ */
+
+#include "chip8_trace.h"
+#include "chip8_disasm.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+
+static void usage()
+{
+	printf("chip8-trace trace\n");
+}
+
+int main(int argc, char** argv)
+{
+	if (argc != 2)
+	{
+		usage();
+		return EXIT_FAILURE;
+	}
+
+	FILE* file = fopen(argv[1], "rb");
+	if (file == NULL)
+	{
+		fprintf(stderr, "Failed opening %s: %s\n", argv[1], strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	struct chip8_trace_header_t header;
+	struct chip8_trace_record_t* records;
+
+	int error = chip8_trace_load(file, &header, &records);
+	fclose(file);
+
+	if (error)
+	{
+		fprintf(stderr, "Failed reading %s: %s\n", argv[1], strerror(error));
+		return EXIT_FAILURE;
+	}
+
+	printf("# %llu records, %llu dropped\n", (unsigned long long)header.count, (unsigned long long)header.dropped);
+	printf("# %-14s %-5s %-6s %-5s %-3s %-4s %s\n", "cycle", "pc", "opcode", "I", "sp", "vf", "insn");
+
+	for (uint64_t i = 0; i < header.count; ++i)
+	{
+		const struct chip8_trace_record_t* record = &records[i];
+		char insn[CHIP8_DISASM_MAX];
+
+		chip8_disasm(record->opcode, insn, sizeof(insn));
+		printf("%16llu 0x%03X 0x%04X 0x%03X %3u 0x%02X %s\n",
+			(unsigned long long)record->cycle, record->pc, record->opcode, record->I, record->sp, record->vf, insn);
+	}
+
+	free(records);
+	return 0;
+}